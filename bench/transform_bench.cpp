@@ -0,0 +1,302 @@
+#include "../include/math/vector3.h"
+#include "../include/math/matrix4.h"
+#include "../include/math/bounds.h"
+#include "../include/math/kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Compares the batched Matrix4 transforms against the per-point loop that
+// Renderer::draw_mesh runs per index, once for every kernel tier this host
+// supports, then measures every kernel tier side by side on a cache-resident
+// working set. Usage: transform_bench [point_count] [iterations]
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+template <typename Fn>
+double best_time_ms(int iterations, Fn&& fn) {
+    double best = 1e30;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        fn();
+        auto end = Clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+float max_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    float diff = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff = std::max(diff, std::abs(a[i] - b[i]));
+    }
+    return diff;
+}
+
+void report(const char* name, size_t count, double per_point_ms, double batch_ms, float error) {
+    std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << count / per_point_ms / 1000.0 << " Mpts/s"
+              << std::setw(10) << count / batch_ms / 1000.0 << " Mpts/s"
+              << std::setw(8) << per_point_ms / batch_ms << "x"
+              << "   max err " << std::scientific << std::setprecision(1) << error << std::endl;
+}
+
+// Throughput of each kernel per tier on data that fits in L1/L2, so the
+// numbers reflect instruction throughput rather than memory bandwidth
+void compare_tiers(int iterations) {
+    const size_t count = 1021; // odd on purpose: exercises the tails
+    const size_t matrix_count = 251;
+    const size_t light_count = 8;
+    const size_t ranged_light_count = 32;
+    const int repeats = 200;
+    
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    auto random_vector = [&](size_t n) {
+        std::vector<float> v(n);
+        for (auto& f : v) {
+            f = dist(rng);
+        }
+        return v;
+    };
+    
+    std::vector<float> packed = random_vector(count * 3);
+    std::vector<float> packed_out(count * 3);
+    std::vector<float> px = random_vector(count), py = random_vector(count), pz = random_vector(count);
+    std::vector<float> nx = random_vector(count), ny = random_vector(count), nz = random_vector(count);
+    std::vector<float> cr(count, 0.8f), cg(count, 0.5f), cb(count, 0.3f);
+    std::vector<float> ox(count), oy(count), oz(count);
+    std::vector<float> matrices = random_vector(matrix_count * 16);
+    std::vector<float> matrices_out(matrix_count * 16);
+    std::vector<float> affines = random_vector(matrix_count * 12);
+    std::vector<float> affines_out(matrix_count * 12);
+    std::vector<float> lhs = random_vector(16);
+    std::vector<float> quats_a = random_vector(count * 4), quats_b = random_vector(count * 4);
+    std::vector<float> quats_out(count * 4), weights(count, 0.3f);
+    
+    std::vector<float> lx = random_vector(light_count), ly = random_vector(light_count), lz = random_vector(light_count);
+    std::vector<float> lr(light_count, 1.0f), lg(light_count, 0.9f), lb(light_count, 0.8f), li(light_count, 0.5f);
+    std::vector<float> unlimited(light_count, 0.0f);
+    kernels::LightArray lights = { lx.data(), ly.data(), lz.data(), lr.data(), lg.data(), lb.data(), li.data(),
+                                   unlimited.data(), light_count };
+    
+    // Dozens of short-range lights: most of them miss most vertex blocks
+    std::vector<float> rx = random_vector(ranged_light_count), ry = random_vector(ranged_light_count), rz = random_vector(ranged_light_count);
+    std::vector<float> rr(ranged_light_count, 1.0f), rg(ranged_light_count, 0.9f), rb(ranged_light_count, 0.8f);
+    std::vector<float> ri(ranged_light_count, 0.5f), inv_range_sq(ranged_light_count, 1.0f / 16.0f);
+    kernels::LightArray ranged_lights = { rx.data(), ry.data(), rz.data(), rr.data(), rg.data(), rb.data(), ri.data(),
+                                          inv_range_sq.data(), ranged_light_count };
+    
+    // Camera at the origin looking down -z; about a sixth of the points land inside
+    Frustum frustum(Matrix4::perspective(1.0f, 1.5f, 0.1f, 20.0f));
+    std::vector<uint8_t> visible(count);
+    std::vector<uint32_t> hashes(count);
+    
+    std::vector<int> indices(count * 3);
+    std::uniform_int_distribution<int> index_dist(0, static_cast<int>(count) - 1);
+    for (auto& i : indices) {
+        i = index_dist(rng);
+    }
+    
+    // Corners of the random triangles by vertex, for gathering face normals
+    std::vector<uint32_t> corner_offsets(count + 1, 0), vertex_corners(count * 3);
+    for (int i : indices) {
+        ++corner_offsets[i + 1];
+    }
+    for (size_t v = 0; v < count; ++v) {
+        corner_offsets[v + 1] += corner_offsets[v];
+    }
+    {
+        std::vector<uint32_t> fill(corner_offsets.begin(), corner_offsets.end() - 1);
+        for (size_t c = 0; c < indices.size(); ++c) {
+            vertex_corners[fill[indices[c]]++] = static_cast<uint32_t>(c);
+        }
+    }
+    std::vector<float> fx(count), fy(count), fz(count), corner_angles(count * 3);
+    
+    kernels::Streams positions = { px.data(), py.data(), pz.data() };
+    kernels::Streams normals = { nx.data(), ny.data(), nz.data() };
+    kernels::Streams colors = { cr.data(), cg.data(), cb.data() };
+    kernels::MutableStreams out = { ox.data(), oy.data(), oz.data() };
+    kernels::Streams faces = { fx.data(), fy.data(), fz.data() };
+    kernels::MutableStreams faces_out = { fx.data(), fy.data(), fz.data() };
+    
+    struct Case {
+        const char* name;
+        size_t elements;
+        double melems[4];
+    };
+    Case cases[] = {
+        { "transform_points", count, {} },
+        { "transform_normals SoA", count, {} },
+        { "multiply_matrices", matrix_count, {} },
+        { "multiply_affines", matrix_count, {} },
+        { "light_vertices x8", count, {} },
+        { "face normals", count, {} },
+        { "multiply_quaternions", count, {} },
+        { "slerp_quaternions", count, {} },
+        { "sincos", count, {} },
+        { "light_vertices x32 r4", count, {} },
+        { "cull_spheres", count, {} },
+        { "transform_spheres", matrix_count, {} },
+        { "face_orientation", count, {} },
+        { "hash_vertices", count, {} },
+        { "cull_meshlets", count, {} },
+        { "face normals angle", count, {} },
+    };
+    
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512 };
+    bool available[4] = {};
+    for (int l = 0; l < 4; ++l) {
+        if (!kernels::set_level(levels[l])) {
+            continue;
+        }
+        available[l] = true;
+        const kernels::KernelTable& k = kernels::active();
+        auto measure = [&](Case& c, auto&& fn) {
+            double ms = best_time_ms(iterations, [&] {
+                for (int r = 0; r < repeats; ++r) {
+                    fn();
+                }
+            });
+            c.melems[l] = c.elements * repeats / ms / 1000.0;
+        };
+        measure(cases[0], [&] { k.transform_points(lhs.data(), packed.data(), packed_out.data(), count); });
+        measure(cases[1], [&] { k.transform_normals_soa(lhs.data(), normals, out, count); });
+        measure(cases[2], [&] { k.multiply_matrices(lhs.data(), matrices.data(), matrices_out.data(), matrix_count); });
+        measure(cases[3], [&] { k.multiply_affines(lhs.data(), 0, affines.data(), affines_out.data(), matrix_count); });
+        measure(cases[4], [&] { k.light_vertices(positions, normals, colors, count, lights, 0.1f, out); });
+        measure(cases[5], [&] {
+            k.face_normals(positions, indices.data(), count, true, faces_out, nullptr);
+            k.gather_vertex_normals(faces, nullptr, corner_offsets.data(), vertex_corners.data(), count, out);
+        });
+        measure(cases[6], [&] { k.multiply_quaternions(quats_a.data(), quats_b.data(), quats_out.data(), count); });
+        measure(cases[7], [&] { k.slerp_quaternions(quats_a.data(), quats_b.data(), weights.data(), quats_out.data(), count); });
+        measure(cases[8], [&] { k.sincos(px.data(), ox.data(), oy.data(), count); });
+        measure(cases[9], [&] { k.light_vertices(positions, normals, colors, count, ranged_lights, 0.1f, out); });
+        measure(cases[10], [&] { k.cull_spheres(frustum.planes(), positions, cr.data(), count, visible.data()); });
+        measure(cases[11], [&] { k.transform_spheres(matrices.data(), matrix_count, lhs.data(), out, cg.data()); });
+        measure(cases[12], [&] { k.face_orientation(normals, cr.data(), count, lhs.data(), visible.data()); });
+        measure(cases[13], [&] { k.hash_vertices(positions, normals, colors, count, lhs.data(), hashes.data()); });
+        measure(cases[15], [&] {
+            k.face_normals(positions, indices.data(), count, true, faces_out, corner_angles.data());
+            k.gather_vertex_normals(faces, corner_angles.data(), corner_offsets.data(), vertex_corners.data(), count, out);
+        });
+        measure(cases[14], [&] {
+            k.cull_meshlets(frustum.planes(), positions, cr.data(), normals, cg.data(), cb.data(), cr.data(), count,
+                            lhs.data(), visible.data());
+        });
+    }
+    
+    std::cout << std::endl << "Kernel throughput per tier (M elements/s, cache-resident)" << std::endl;
+    std::cout << std::left << std::setw(24) << "kernel" << std::right;
+    for (int l = 0; l < 4; ++l) {
+        if (available[l]) {
+            std::cout << std::setw(10) << simd_level_name(levels[l]);
+        }
+    }
+    if (available[3]) {
+        std::cout << std::setw(14) << "avx512/avx2";
+    }
+    std::cout << std::endl;
+    for (const Case& c : cases) {
+        std::cout << std::left << std::setw(24) << c.name << std::right << std::fixed << std::setprecision(1);
+        for (int l = 0; l < 4; ++l) {
+            if (available[l]) {
+                std::cout << std::setw(10) << c.melems[l];
+            }
+        }
+        if (available[3]) {
+            std::cout << std::setw(13) << std::setprecision(2) << c.melems[3] / c.melems[2] << "x";
+        }
+        std::cout << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000003;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+    
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    std::vector<float> input(count * 3);
+    for (auto& v : input) {
+        v = dist(rng);
+    }
+    
+    Matrix4 m = Matrix4::translation(Vector3(1.0f, -2.0f, 3.0f)) *
+                Matrix4::rotation(Vector3(0.3f, 1.0f, -0.2f), 0.7f) *
+                Matrix4::scale(Vector3(1.5f, 0.5f, 2.0f));
+    
+    std::vector<float> reference(count * 3);
+    std::vector<float> batched(count * 3);
+    
+    Vector3Stream soa_input;
+    Vector3Stream soa_output;
+    soa_input.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        soa_input.push_back(Vector3(input[3 * i], input[3 * i + 1], input[3 * i + 2]));
+    }
+    auto soa_error = [&] {
+        for (size_t i = 0; i < count; ++i) {
+            Vector3 v = soa_output.get(i);
+            batched[3 * i] = v.x();
+            batched[3 * i + 1] = v.y();
+            batched[3 * i + 2] = v.z();
+        }
+        return max_abs_diff(reference, batched);
+    };
+    
+    auto per_point = [&](auto&& transform) {
+        return best_time_ms(iterations, [&] {
+            for (size_t i = 0; i < count; ++i) {
+                Vector3 r = transform(Vector3(input[3 * i], input[3 * i + 1], input[3 * i + 2]));
+                reference[3 * i] = r.x();
+                reference[3 * i + 1] = r.y();
+                reference[3 * i + 2] = r.z();
+            }
+        });
+    };
+    
+    std::cout << "Transforming " << count << " points, best of " << iterations << " runs" << std::endl;
+    
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel level : levels) {
+        if (!kernels::set_level(level)) {
+            continue;
+        }
+        
+        std::cout << std::endl << "[" << simd_level_name(level) << " kernels]" << std::endl;
+        std::cout << std::left << std::setw(20) << "kernel" << std::right
+                  << std::setw(17) << "per-point" << std::setw(17) << "batch" << std::setw(9) << "speedup" << std::endl;
+        
+        double scalar_ms = per_point([&](const Vector3& p) { return m.transform_point(p); });
+        double batch_ms = best_time_ms(iterations, [&] { m.transform_points(input.data(), batched.data(), count); });
+        report("transform_points", count, scalar_ms, batch_ms, max_abs_diff(reference, batched));
+        
+        batch_ms = best_time_ms(iterations, [&] { m.transform_points(soa_input, soa_output); });
+        report("transform_points SoA", count, scalar_ms, batch_ms, soa_error());
+        
+        scalar_ms = per_point([&](const Vector3& v) { return m.transform_vector(v); });
+        batch_ms = best_time_ms(iterations, [&] { m.transform_vectors(input.data(), batched.data(), count); });
+        report("transform_vectors", count, scalar_ms, batch_ms, max_abs_diff(reference, batched));
+        
+        scalar_ms = per_point([&](const Vector3& v) { return m.transform_vector(v).normalized(); });
+        batch_ms = best_time_ms(iterations, [&] { m.transform_normals(input.data(), batched.data(), count); });
+        report("transform_normals", count, scalar_ms, batch_ms, max_abs_diff(reference, batched));
+    }
+    
+    compare_tiers(iterations);
+    
+    kernels::set_level(kernels::supported_level());
+    return 0;
+}
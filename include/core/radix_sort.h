@@ -0,0 +1,36 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Stable LSD radix sort of 64-bit keys, each carrying a 32-bit value, one
+// byte per pass. Bytes that every key shares are skipped, so keys that only
+// use a few of their bits cost a few passes. Inputs of PARALLEL_MIN keys or
+// more are histogrammed and scattered in parallel, one contiguous chunk per
+// thread, on a pool of the sorter's own or one borrowed from the caller; the
+// scratch buffers and the pool are kept for the next call.
+class RadixSorter {
+public:
+    static const size_t PARALLEL_MIN = 1 << 16;
+    
+    explicit RadixSorter(unsigned threads = 0); // 0 = hardware concurrency, started on first large sort
+    explicit RadixSorter(ThreadPool& pool, unsigned threads = 0); // Up to threads (0 = all) of pool, which must outlive it
+    
+    void sort(uint64_t* keys, uint32_t* values, size_t count);
+    
+private:
+    // Per-chunk counts of byte `shift / 8` of keys
+    void histogram(const uint64_t* keys, size_t count, unsigned shift);
+    
+    unsigned _threads;
+    std::unique_ptr<ThreadPool> _owned_pool;
+    ThreadPool* _pool;
+    size_t _chunks;
+    size_t _chunk_size;
+    std::vector<size_t> _counts; // 256 per chunk, turned into scatter offsets in place
+    std::vector<uint64_t> _keys;
+    std::vector<uint32_t> _values;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Indices only ever grow; the producer publishes a slot with a
+// release store of _tail that the consumer's acquire load pairs with, and the
+// reverse for _head, so neither side ever takes a lock. Blocking on an empty
+// or full ring is left to the caller.
+template <class T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : _slots(round_up(capacity))
+        , _mask(_slots.size() - 1)
+        , _head(0)
+        , _tail(0) {
+    }
+    
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    
+    size_t capacity() const { return _slots.size(); }
+    
+    // Producer only; false if the ring is full
+    bool try_push(const T& value) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size()) return false;
+        _slots[tail & _mask] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer only; false if the ring is empty
+    bool try_pop(T& value) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) return false;
+        value = _slots[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Either side; exact only while the other side is idle
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+    
+private:
+    static size_t round_up(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+    
+    std::vector<T> _slots;
+    const size_t _mask;
+    // Separate cache lines so the two threads do not false-share
+    alignas(64) std::atomic<size_t> _head; // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> _tail; // Next slot to push, written by the producer
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of persistent worker threads for data-parallel loops. The calling
+// thread takes part in every loop, so size() threads run each parallel_for.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = 0); // 0 = hardware concurrency
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    unsigned size() const { return static_cast<unsigned>(_workers.size()) + 1; }
+    
+    // Calls fn(i) for every i in [0, count) and returns when all calls have
+    // finished. Indices are handed out one at a time, so uneven items balance
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+    
+private:
+    void worker_loop();
+    void run_items();
+    
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _work_ready;
+    std::condition_variable _work_done;
+    
+    const std::function<void(size_t)>* _task;
+    size_t _count;
+    std::atomic<size_t> _next;
+    unsigned _active; // Workers still inside the current loop
+    unsigned long _generation;
+    bool _stopping;
+};
+
+// Holds the process-wide pool kept for one-off parallel passes (mesh
+// processing and the like), started with hardware concurrency on first use.
+// One holder at a time: pool() is null if the lease was not wanted or
+// another thread holds the pool, and the caller then runs serially
+class SharedPoolLease {
+public:
+    explicit SharedPoolLease(bool wanted = true);
+    
+    SharedPoolLease(const SharedPoolLease&) = delete;
+    SharedPoolLease& operator=(const SharedPoolLease&) = delete;
+    
+    ThreadPool* pool() const { return _pool; }
+    
+private:
+    std::unique_lock<std::mutex> _lock;
+    ThreadPool* _pool;
+};
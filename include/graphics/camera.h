@@ -2,6 +2,7 @@
 
 #include "../math/vector3.h"
 #include "../math/matrix4.h"
+#include "../math/bounds.h"
 
 class Camera {
 public:
@@ -15,6 +16,7 @@ public:
     Matrix4 view_matrix() const;
     Matrix4 projection_matrix() const;
     Matrix4 view_projection_matrix() const;
+    Frustum frustum() const { return Frustum(view_projection_matrix()); }
     
     void set_position(const Vector3& position) { _position = position; _view_dirty = true; }
     void set_target(const Vector3& target) { _target = target; _view_dirty = true; }
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../math/vector3.h"
+
+struct Light {
+    Vector3 position;
+    Vector3 color;
+    float intensity;
+    float range; // Contribution fades to zero at this distance; 0 = unlimited
+    
+    Light(const Vector3& pos = Vector3(0, 10, 0), 
+          const Vector3& col = Vector3(1, 1, 1), 
+          float intens = 1.0f,
+          float rng = 0.0f)
+        : position(pos), color(col), intensity(intens), range(rng) {}
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../math/matrix4.h"
+#include "../math/kernels.h"
+#include "../core/thread_pool.h"
+#include "camera.h"
+#include "light.h"
+#include <cstdint>
+#include <vector>
+
+// Clustered light culling: the camera frustum is split into TILES_X x TILES_Y
+// screen tiles and SLICES exponentially spaced depth slices (froxels), and each
+// ranged light is binned into every froxel its bounding sphere can touch.
+// Lighting a vertex then only visits the lights of its own froxel, so cost
+// follows the local light density instead of the scene's total light count.
+//
+// Lights without a range reach everything and are part of every froxel.
+// Vertices outside the frustum (behind the camera, past the far plane or off
+// screen) fall back to the full light list.
+class LightClusters {
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    
+    explicit LightClusters(unsigned threads = 0);
+    
+    // Rebinds the lights for the camera's perspective frustum (fov, aspect,
+    // near and far planes); depth slices are binned in parallel
+    void build(const Camera& camera, const std::vector<Light>& lights);
+    
+    // kernels::light_vertices, with each vertex lit only by its froxel's lights
+    void light_vertices(kernels::Streams positions, kernels::Streams normals, kernels::Streams colors,
+                        size_t count, float ambient, kernels::MutableStreams out);
+    
+    // Froxel of a world-space point, or -1 outside the frustum
+    int cluster_of(const Vector3& point) const;
+    size_t cluster_light_count(int cluster) const { return _counts[cluster]; }
+    size_t total_references() const { return _offsets[CLUSTER_COUNT]; } // Sum of per-froxel light counts
+    
+private:
+    // Per-light view-space bounds, computed once per build
+    struct LightBounds {
+        float x_min, x_max, y_min, y_max; // View-space box of the sphere
+        float depth_min, depth_max;       // Distance along the view direction
+        int slice_min, slice_max;         // -1 / -1 when the light misses the frustum
+    };
+    
+    void bin_slice(int slice, std::vector<uint32_t>& cells) const;
+    int slice_of(float depth) const;
+    kernels::LightArray light_array(size_t offset, size_t count) const;
+    
+    Matrix4 _view;
+    float _tan_half_x, _tan_half_y;
+    float _near, _far;
+    float _slice_scale; // SLICES / log(far / near)
+    
+    std::vector<Light> _lights;
+    std::vector<LightBounds> _bounds;
+    std::vector<uint32_t> _global_lights; // Unlimited range
+    
+    // Per slice: (cell, light) pairs found by bin_slice
+    std::vector<std::vector<uint32_t>> _slice_pairs;
+    
+    // CSR light lists: froxel c owns lights [_offsets[c], _offsets[c] + _counts[c])
+    // of _light_data, stored as 8 SoA blocks (x, y, z, r, g, b, intensity,
+    // 1 / range^2) of _capacity floats each. Froxel CLUSTER_COUNT is the full list
+    std::vector<uint32_t> _offsets;
+    std::vector<uint32_t> _counts;
+    std::vector<float> _light_data;
+    size_t _capacity;
+    
+    // light_vertices scratch: vertices regrouped by froxel
+    std::vector<int> _vertex_cluster;
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _bucket_offsets;
+    std::vector<float> _gathered;
+    
+    ThreadPool _pool;
+};
@@ -1,8 +1,15 @@
 #pragma once
 
 #include "../math/vector3.h"
+#include "../math/vector3_stream.h"
+#include "../math/bounds.h"
+#include "mesh_optimizer.h"
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+// Interchange format for building and reading single vertices; Mesh itself
+// stores its attributes as separate SoA streams
 struct Vertex {
     Vector3 position;
     Vector3 normal;
@@ -14,6 +21,74 @@ struct Vertex {
         : position(pos), normal(norm), color(col) {}
 };
 
+// Unique edges of a mesh and the faces either side of them. Vertices at the
+// same position count as one, so edges split only by per-face attributes (a
+// cube's corners) are still shared
+struct EdgeAdjacency {
+    std::vector<int> vertices;       // Two vertex indices per edge
+    std::vector<int> faces;          // Two triangles per edge; the second is -1 on open boundaries
+    std::vector<int> feature_edges;  // Vertex pairs of the edges not between two coplanar faces
+    Vector3Stream face_normals;      // Per triangle, oriented to agree with its vertex normals
+    std::vector<float> face_offsets; // n . p + offset = 0 on the triangle's plane
+    
+    size_t edge_count() const { return faces.size() / 2; }
+};
+
+// Vertex cache efficiency of a mesh's indices either side of Mesh::optimize()
+struct MeshOptimization {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// One simplified level of detail: an index buffer over the mesh's own
+// vertices and how far (object-space units) its surface may stray from the
+// full-resolution one
+struct MeshLod {
+    std::vector<int> indices;
+    float error = 0.0f;
+};
+
+// Goal for one level: stop at triangle_ratio of the full mesh's triangles or
+// before the error would exceed max_error, whichever comes first
+struct LodTarget {
+    float triangle_ratio = 0.5f;
+    float max_error = 1e30f;
+};
+
+// Clusters of the full-resolution triangles (see build_meshlets()) with
+// bounds for rejecting whole groups. Meshlet i is triangles
+// [first_triangle[i], first_triangle[i + 1]) of Mesh::indices(); its sphere
+// holds every vertex, and its cone every unit face normal n = (p1 - p0) x (p2 - p0)
+// within acos of the axis. Every triangle turns away from an eye e with
+//   dot(normalize(c - axis * front_apex - e), axis) > cutoff
+// for the sphere's centre c, and towards it with
+//   dot(normalize(c - axis * back_apex - e), -axis) > cutoff.
+// Meshlets whose normals spread too far have a cutoff above 1
+struct Meshlets {
+    std::vector<uint32_t> first_triangle;
+    Vector3Stream centers;
+    std::vector<float> radii;
+    Vector3Stream cone_axes;
+    std::vector<float> cone_cutoffs;
+    std::vector<float> front_apexes; // Apex distances behind the centre along the axis
+    std::vector<float> back_apexes;
+    
+    size_t size() const { return radii.size(); }
+};
+
+// How much each face adds to the normals of its three vertices
+enum class NormalWeighting {
+    Uniform, // The same for every face
+    Area,    // In proportion to the face's area
+    Angle    // In proportion to the face's interior angle at the vertex
+};
+
+// Meshes with at least this many triangles compute normals on threads
+const size_t NORMALS_PARALLEL_MIN = 1 << 15;
+
+// Buffer objects a renderer keeps for a mesh; defined by the renderer
+struct MeshBuffers;
+
 class Mesh {
 public:
     Mesh();
@@ -22,7 +97,20 @@ public:
     void add_vertex(const Vertex& vertex);
     void add_triangle(int v1, int v2, int v3);
     
-    const std::vector<Vertex>& vertices() const { return _vertices; }
+    // Per-vertex accessors over the SoA streams
+    Vertex vertex(size_t index) const { return Vertex(position(index), normal(index), color(index)); }
+    Vector3 position(size_t index) const { return _positions.get(index); }
+    Vector3 normal(size_t index) const { return _normals.get(index); }
+    Vector3 color(size_t index) const { return _colors.get(index); }
+    
+    void set_position(size_t index, const Vector3& position) { _positions.set(index, position); touch_positions(); }
+    void set_normal(size_t index, const Vector3& normal) { _normals.set(index, normal); touch(); }
+    void set_color(size_t index, const Vector3& color) { _colors.set(index, color); touch(); }
+    
+    // Whole-attribute streams for batch passes that only need one attribute
+    const Vector3Stream& positions() const { return _positions; }
+    const Vector3Stream& normals() const { return _normals; }
+    const Vector3Stream& colors() const { return _colors; }
     const std::vector<int>& indices() const { return _indices; }
     
     static Mesh create_cube(float size = 1.0f);
@@ -30,12 +118,88 @@ public:
     static Mesh create_plane(float width = 1.0f, float height = 1.0f);
     static Mesh create_triangle(float size = 1.0f);
     
-    void calculate_normals();
+    // Sets every vertex normal to the normalized, weighted sum of the normals
+    // of the faces using it. Face normals are computed a register of triangles
+    // at a time, then each vertex gathers its own faces through a
+    // vertex-to-corner table kept until the indices change, so nothing is
+    // scattered. Meshes of NORMALS_PARALLEL_MIN triangles or more split both
+    // passes across up to threads (0 = all) workers of the shared pool (see
+    // SharedPoolLease), or run serially while another thread holds it; the
+    // result does not depend on the thread count
+    void calculate_normals(NormalWeighting weighting = NormalWeighting::Uniform, unsigned threads = 0);
+    // Reorders the triangles for the post-transform vertex cache and then for
+    // overdraw, and renumbers the vertices in the order the new indices fetch
+    // them (unreferenced ones last). The geometry drawn is unchanged
+    MeshOptimization optimize();
+    // Merges vertices that duplicate an earlier one within the tolerance (see
+    // weld_remap), keeping the first of each, and remaps the indices. Returns
+    // the number of vertices removed
+    size_t weld(const WeldTolerance& tolerance = WeldTolerance(), unsigned threads = 0);
+    
+    // Replaces the levels of detail with one per target, each simplified from
+    // the full mesh (see simplify()) on up to threads (0 = all) workers of the
+    // shared pool; the result does not depend on the thread count. Levels
+    // that remove no triangles over the previous one are dropped. Normals and
+    // colors may change afterwards; any later change to the positions or
+    // indices drops them all
+    void generate_lods(const std::vector<LodTarget>& targets, unsigned threads = 0);
+    // levels targets, each with ratio times the triangles of the one before
+    void generate_lods(size_t levels = 4, float ratio = 0.5f, unsigned threads = 0);
+    // Level 0 is the full mesh; lod(i) for i > 0 is lods()[i - 1]
+    const std::vector<MeshLod>& lods() const { return _lods; }
+    size_t lod_count() const { return _lods.size() + 1; }
+    const std::vector<int>& lod_indices(size_t level) const { return level == 0 ? _indices : _lods[level - 1].indices; }
+    
+    // Reorders the triangles into meshlets and bounds each one; the geometry
+    // drawn and any levels of detail are unchanged. Normals and colors may
+    // change afterwards; any later change to the positions or indices drops them
+    void build_meshlets(size_t max_vertices = MESHLET_MAX_VERTICES, size_t max_triangles = MESHLET_MAX_TRIANGLES);
+    const Meshlets& meshlets() const { return _meshlets; }
     void clear();
-    size_t vertex_count() const { return _vertices.size(); }
+    size_t vertex_count() const { return _positions.size(); }
     size_t triangle_count() const { return _indices.size() / 3; }
     
+    // Object-space bounds of the positions, recomputed on first use after a
+    // change. The sphere is centred on the box and just encloses every vertex
+    const Aabb& bounds() const;
+    const BoundingSphere& bounding_sphere() const;
+    
+    // Edge adjacency, rebuilt on first use after a change
+    const EdgeAdjacency& adjacency() const;
+    
+    // Changes whenever any attribute or index does; unique across all meshes
+    uint64_t revision() const { return _revision; }
+    
+    // Renderer-side GPU copy, uploaded on first draw and again once revision()
+    // moves past the uploaded one. Copies of a mesh share it until either changes.
+    // Only the thread recording draws touches the handle itself
+    std::shared_ptr<MeshBuffers>& gpu_buffers() const { return _gpu_buffers; }
+    
 private:
-    std::vector<Vertex> _vertices;
+    void touch();
+    void touch_positions(); // Also drops the levels of detail and meshlets, built from the positions
+    void touch_topology(); // Also for changes to the indices or the vertex count
+    void update_bounds() const;
+    void update_adjacency() const;
+    
+    Vector3Stream _positions;
+    Vector3Stream _normals;
+    Vector3Stream _colors;
     std::vector<int> _indices;
+    std::vector<MeshLod> _lods;
+    Meshlets _meshlets;
+    
+    uint64_t _revision;
+    uint64_t _topology_revision;
+    
+    // Corners (3 * triangle + k) using each vertex, in CSR form, as of _corners_revision
+    uint64_t _corners_revision;
+    std::vector<uint32_t> _corner_offsets;
+    std::vector<uint32_t> _vertex_corners;
+    mutable uint64_t _bounds_revision;
+    mutable Aabb _bounds;
+    mutable BoundingSphere _bounding_sphere;
+    mutable uint64_t _adjacency_revision;
+    mutable EdgeAdjacency _adjacency;
+    mutable std::shared_ptr<MeshBuffers> _gpu_buffers;
 }; 
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../math/vector3_stream.h"
+#include <cstddef>
+#include <cstdint>
+
+// Passes over triangle-list meshes. Those reordering an index buffer write
+// the copy to out (which must not alias the input); those renumbering
+// vertices return a remap table and leave applying it to the caller
+
+// Post-transform vertex cache behaviour of an index buffer, simulated as a
+// FIFO of cache_size vertices. ACMR is misses per triangle (3 at worst, about
+// 0.5 for large regular grids); ATVR is misses per referenced vertex (1 at best)
+const unsigned VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+VertexCacheStats analyze_vertex_cache(const int* indices, size_t index_count, size_t vertex_count,
+                                      unsigned cache_size = VERTEX_CACHE_SIZE);
+
+// Triangle order for vertex cache locality, after Forsyth's linear-speed
+// optimizer: every step emits the triangle whose vertices score highest from
+// their position in a simulated LRU cache and how many triangles still use them
+void optimize_vertex_cache(const int* indices, size_t index_count, size_t vertex_count, int* out);
+
+// Reorders a cache-optimized triangle order for less overdraw. The order is
+// cut into clusters wherever the simulated cache starts over, or where a cut
+// raises the cluster's ACMR by no more than threshold; the clusters facing
+// most directly away from the mesh's centre are drawn first so that depth
+// testing rejects more of the rest. Faces are oriented to agree with normals
+void optimize_overdraw(const int* indices, size_t index_count, const Vector3Stream& positions,
+                       const Vector3Stream& normals, int* out, float threshold = 1.05f,
+                       unsigned cache_size = VERTEX_CACHE_SIZE);
+
+// Vertex order that fetches vertices in the order the indices first use them,
+// followed by any they never reference: remap[old] = new. Returns how many are referenced
+size_t vertex_fetch_remap(const int* indices, size_t index_count, size_t vertex_count, int* remap);
+
+// Largest per-component difference at which vertex attributes may still be
+// merged by weld_remap; 0 only merges exact duplicates
+struct WeldTolerance {
+    float position = 0.0f;
+    float normal = 0.0f;
+    float color = 0.0f;
+};
+
+// Maps every vertex to a representative of the vertices it duplicates:
+// remap[old] = new, numbered in order of each representative's first
+// occurrence. Returns the number of unique vertices.
+// Positions are hashed by the cell of a grid WELD_CELL_SCALE tolerances wide
+// that they round to (the hash_vertices kernel) and grouped by a radix sort of the
+// hashes; a vertex joins the first earlier representative within tolerance
+// in its own cell or in the neighbouring cells it lies within tolerance of,
+// so near-duplicates either side of a cell boundary merge too. Inputs of
+// WELD_PARALLEL_MIN vertices or more are hashed, sorted and searched on up
+// to threads (0 = all) workers of the shared pool (see SharedPoolLease), or
+// serially while another thread holds it; the result does not depend on the
+// thread count
+const size_t WELD_PARALLEL_MIN = 1 << 16;
+const float WELD_CELL_SCALE = 8.0f;
+
+size_t weld_remap(const Vector3Stream& positions, const Vector3Stream& normals, const Vector3Stream& colors,
+                  const WeldTolerance& tolerance, int* remap, unsigned threads = 0);
+
+// Quadric error simplification by half-edge collapses: each step moves a
+// vertex onto a neighbour, choosing the collapse that least increases the
+// area-weighted squared distance to the planes of the triangles merged so
+// far, and never one that flips a triangle. Collapses run in passes of
+// independent edges in cost order (ties by vertex index), so the result is
+// deterministic. Vertices on open borders and attribute seams (several
+// vertices at one position) never move. Stops at target_index_count
+// indices or before the first collapse costing more than max_error
+// (object-space distance). out indexes the same vertices and needs
+// index_count entries; returns the number written and, in error, the
+// largest deviation reached
+size_t simplify(const int* indices, size_t index_count, const Vector3Stream& positions, size_t target_index_count,
+                float max_error, int* out, float* error = nullptr);
+
+// Splits the triangles into meshlets of at most max_vertices distinct
+// vertices and max_triangles triangles, grown greedily from a seed: each
+// step adds the neighbouring triangle that brings the fewest new vertices,
+// then the one whose vertices have the fewest triangles left (so none are
+// stranded), then the one nearest the meshlet's centroid; the next meshlet
+// starts beside the last. out receives the triangles meshlet by meshlet;
+// first_triangle (triangle count + 1 entries) where each begins, closed by
+// the triangle count. Returns the number of meshlets
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+size_t build_meshlets(const int* indices, size_t index_count, const Vector3Stream& positions, size_t max_vertices,
+                      size_t max_triangles, int* out, uint32_t* first_triangle);
@@ -2,63 +2,240 @@
 
 #include "../math/vector3.h"
 #include "../math/matrix4.h"
+#include "../math/affine3.h"
 #include "mesh.h"
 #include "camera.h"
+#include "light.h"
+#include "light_clusters.h"
+#include "software_rasterizer.h"
+#include "../core/radix_sort.h"
+#include "../core/spsc_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 // Linux/WSL includes
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#define GL_GLEXT_PROTOTYPES // Buffer objects (GL 1.5); exported directly by Mesa and vendor libGL
 #include <GL/gl.h>
 #include <GL/glx.h>
 
-struct Light {
-    Vector3 position;
-    Vector3 color;
-    float intensity;
-    
-    Light(const Vector3& pos = Vector3(0, 10, 0), 
-          const Vector3& col = Vector3(1, 1, 1), 
-          float intens = 1.0f)
-        : position(pos), color(col), intensity(intens) {}
-};
+struct GpuContext;
 
 class Renderer {
 public:
     Renderer();
     ~Renderer();
     
-    bool initialize(int width, int height, const char* title);
+    // frames_in_flight > 0 moves the GL context to a render thread owned by the
+    // renderer: end_frame hands the recorded frame over and returns, and
+    // begin_frame only blocks while that many frames are still queued or being
+    // drawn. 0 draws on the calling thread inside end_frame
+    bool initialize(int width, int height, const char* title, unsigned frames_in_flight = 2);
+    // No window or GL context: every draw goes to a SoftwareRasterizer
+    // (threads = 0 uses every hardware thread)
+    bool initialize_headless(int width, int height, unsigned threads = 0, unsigned frames_in_flight = 0);
     void shutdown();
     
     void begin_frame();
     void end_frame();
+    // Blocks until every submitted frame has been drawn and presented
+    void finish();
+    unsigned frames_in_flight() const { return _frames_in_flight; }
+    
+    // Clears the frame before any of its draws
     void clear(const Vector3& color = Vector3(0.2f, 0.3f, 0.4f));
     
-    void draw_mesh(const Mesh& mesh, const Matrix4& transform);
-    void draw_wireframe_mesh(const Mesh& mesh, const Matrix4& model_matrix);
+    // Draws are recorded and run once the frame ends, sorted by pass, cull
+    // mode, mesh and depth (front to back) so that runs sharing GL state are
+    // issued together. Meshes must stay alive and unchanged until the frames
+    // drawing them are done (see finish()), though they may be copied while
+    // frames are in flight; the camera and lights set at end_frame draw the
+    // whole frame.
+    // Model transforms are affine; the Matrix4 overloads drop the bottom row
+    void draw_mesh(const Mesh& mesh, const Affine3& transform);
+    void draw_mesh(const Mesh& mesh, const Matrix4& transform) { draw_mesh(mesh, Affine3(transform)); }
+    // count copies of the mesh, one model transform and optionally one color
+    // (multiplied into the vertex colors) per instance; both arrays are copied.
+    // Instances are culled in one batch, then transformed and lit into
+    // world-space vertex streams a bounded batch of instances at a time, each
+    // batch drawn with a single indexed draw per pass
+    void draw_mesh_instanced(const Mesh& mesh, const Matrix4* transforms, size_t count, const Vector3* colors = nullptr);
+    void draw_wireframe_mesh(const Mesh& mesh, const Affine3& model_matrix);
+    void draw_wireframe_mesh(const Mesh& mesh, const Matrix4& model_matrix) { draw_wireframe_mesh(mesh, Affine3(model_matrix)); }
     void draw_line(const Vector3& start, const Vector3& end, const Vector3& color = Vector3(1, 1, 1));
-    void draw_mesh_outline(const Mesh& mesh, const Matrix4& transform, const Vector3& color);
+    // Edges draws every edge of Mesh::adjacency() once, except those between
+    // coplanar faces; Silhouette only the edges between a face turned towards
+    // the camera and one turned away, plus open boundaries
+    enum class Outline { Edges, Silhouette };
+    void draw_mesh_outline(const Mesh& mesh, const Affine3& transform, const Vector3& color,
+                           Outline mode = Outline::Edges);
+    void draw_mesh_outline(const Mesh& mesh, const Matrix4& transform, const Vector3& color,
+                           Outline mode = Outline::Edges) {
+        draw_mesh_outline(mesh, Affine3(transform), color, mode);
+    }
+    
+    // Faces of meshes with meshlets (Mesh::build_meshlets) are drawn only
+    // from the meshlets whose bounds reach into the frustum and whose normal
+    // cones allow a face to turn the pass's way; at coarser levels of detail
+    // the whole level is drawn.
+    // Meshes with levels of detail (Mesh::generate_lods) are drawn at the
+    // coarsest level whose error projects to at most this many pixels at the
+    // nearest point of their bounds. Instanced, wireframe and outline draws
+    // always use the full mesh
+    void set_lod_error(float pixels) { _lod_error_pixels = pixels; }
     
-    void set_camera(const Camera& camera) { _camera = camera; }
-    void add_light(const Light& light) { _lights.push_back(light); }
-    void clear_lights() { _lights.clear(); }
+    void set_camera(const Camera& camera) { _camera = camera; _frustum = camera.frustum(); }
+    const Frustum& frustum() const { return _frustum; }
+    
+    // False when the mesh's world-space bounds lie entirely outside the camera
+    // frustum; the draw_* calls skip such meshes themselves
+    bool is_visible(const Mesh& mesh, const Affine3& transform) const;
+    void add_light(const Light& light) { _lights.push_back(light); ++_lights_revision; }
+    void clear_lights() { _lights.clear(); ++_lights_revision; }
     
     bool should_close() const;
     void poll_events();
-    void swap_buffers();
     
     int width() const { return _width; }
     int height() const { return _height; }
     
+    bool headless() const { return _software != nullptr; }
+    // nullptr unless headless; call finish() first while frames are in flight
+    const SoftwareRasterizer* software_target() const { return _software.get(); }
+    
 private:
+    // One deferred draw. Faces draws either the dimmed back faces or the lit
+    // front faces; Instanced covers both passes of instance_count transforms
+    // (and colors, if tinted) starting at first_instance in the frame's arrays
+    struct DrawCommand {
+        enum Kind { Faces, Instanced, Wireframe, Outline, Line };
+        Kind kind = Faces;
+        bool lit = false;
+        bool tinted = false;
+        bool silhouette = false;
+        uint32_t lod = 0; // Faces: level of detail drawn
+        const Mesh* mesh = nullptr;
+        MeshBuffers* buffers = nullptr; // The mesh's, held by the frame
+        Affine3 transform;
+        Vector3 color;
+        Vector3 start, end; // Line, world space
+        size_t first_instance = 0;
+        size_t instance_count = 0;
+    };
+    
+    // Everything drawing one frame reads, recorded on the calling thread.
+    // Packets circulate between the free and submitted rings, so their vectors
+    // keep their capacity and no more than frames_in_flight exist.
+    // order is sorted along with keys; instanced commands index transforms
+    // and colors. buffers holds the GPU buffers of each mesh drawn (by
+    // frame_mesh index), so the drawing thread never touches Mesh::gpu_buffers()
+    struct FramePacket {
+        Camera camera;
+        Frustum frustum;
+        std::vector<Light> lights;
+        uint64_t lights_revision = 0;
+        int width = 0, height = 0;
+        bool cleared = false;
+        Vector3 clear_color;
+        std::vector<DrawCommand> commands;
+        std::vector<uint64_t> keys;
+        std::vector<uint32_t> order;
+        std::vector<Matrix4> transforms;
+        std::vector<Vector3> colors;
+        std::vector<std::shared_ptr<MeshBuffers>> buffers;
+    };
+    
+    void start_frames(unsigned frames_in_flight);
+    void stop_render_thread();
+    FramePacket& recording(); // Waits for a free packet if none is being recorded
+    // Blocks until the ring yields a packet; nullptr once stopping and drained
+    FramePacket* wait_pop(SpscRing<FramePacket*>& ring);
+    void push_and_wake(SpscRing<FramePacket*>& ring, FramePacket* packet);
+    void render_thread_main();
+    
+    void record(const DrawCommand& command, uint64_t key);
+    // Index of the mesh among the recording frame's; the first draw of a mesh
+    // takes its buffer handle into the frame
+    uint32_t frame_mesh(const Mesh& mesh);
+    uint32_t mesh_key(const Mesh& mesh);
+    uint32_t depth_key(const Mesh& mesh, const Affine3& transform) const;
+    uint32_t select_lod(const Mesh& mesh, const Affine3& transform) const;
+    // Faces at level 0 of a mesh with meshlets: fills _meshlet_ranges with
+    // (first index, index count) runs of the meshlets that may draw in the
+    // command's pass and returns true. False draws the whole level
+    bool visible_meshlets(const DrawCommand& command, const Matrix4& view_projection);
+    // Draws and presents a frame on the thread that owns the output, then resets it
+    void execute_frame(FramePacket& frame);
+    void execute_software();
+    void execute_opengl();
+    void execute_instanced(const DrawCommand& command);
+    void release_buffers(); // Deletes the buffer objects of destroyed meshes
+    
     void setup_matrices();
-    Vector3 calculate_lighting(const Vector3& position, const Vector3& normal, const Vector3& color);
+    void swap_buffers();
     bool setup_opengl();
+    void draw_edges_software(const Mesh& mesh, const Affine3& model_matrix, const std::vector<int>& edges,
+                             const Vector3& color);
+    // Vertex pairs of the mesh's silhouette as seen from the frame's camera
+    void silhouette_edges(const Mesh& mesh, const Affine3& model_matrix, std::vector<int>& out);
+    MeshBuffers& mesh_buffers(const DrawCommand& command); // Uploads on first use or after a change
+    // Transforms and lights each unique vertex into buffers.lit_colors unless
+    // nothing it depends on changed since the last call; true if it did.
+    // Ranged lights that cannot reach the mesh's world bounds are left out
+    bool update_lighting(const Mesh& mesh, const Affine3& model_matrix, MeshBuffers& buffers);
+    // World-space vertex lighting through the light clusters or light_in_range
+    void light_world_vertices(const Vector3Stream& positions, const Vector3Stream& normals, const Vector3Stream& colors,
+                              size_t count, Vector3Stream& out);
+    // Lights against every light that can reach the vertices' bounds
+    void light_in_range(const Vector3Stream& positions, const Vector3Stream& normals, const Vector3Stream& colors,
+                        size_t count, Vector3Stream& out);
+    void bind_vertex_arrays(const MeshBuffers& buffers);
+    void unbind_vertex_arrays();
     
+    // Calling (game) thread state: frames record against it
     int _width, _height;
     Camera _camera;
+    Frustum _frustum;
     std::vector<Light> _lights;
+    uint64_t _lights_revision;
+    std::unordered_map<const Mesh*, uint32_t> _frame_meshes;
+    float _lod_error_pixels;
+    
+    // Frame hand-off. The calling thread pops free packets and pushes recorded
+    // ones; the render thread (if any) does the reverse. Rings never lock; the
+    // mutex and condition only put an idle side to sleep
+    unsigned _frames_in_flight;
+    std::vector<std::unique_ptr<FramePacket>> _packets;
+    std::unique_ptr<SpscRing<FramePacket*>> _free;
+    std::unique_ptr<SpscRing<FramePacket*>> _submitted;
+    FramePacket* _recording;
+    std::thread _render_thread;
+    std::mutex _wake_mutex;
+    std::condition_variable _wake;
+    std::atomic<unsigned> _frames_pending; // Submitted and not yet presented
+    bool _stopping; // Guarded by _wake_mutex
+    
+    // Everything below belongs to the thread that draws: the render thread if
+    // there is one, the calling thread otherwise
+    const FramePacket* _frame; // Being drawn
+    int _viewport_width, _viewport_height;
+    std::vector<float> _light_soa; // Lights reaching the mesh being lit, SoA
+    
+    // Built lazily once the scene has CLUSTERED_LIGHTS lights, and rebuilt when
+    // the camera or the lights change. Froxels are conservative and
+    // light_vertices lights a vertex the same wherever it falls in a batch, so
+    // clustering leaves the result bit-identical on every kernel tier and does
+    // not invalidate cached lighting
+    std::unique_ptr<LightClusters> _clusters;
+    Matrix4 _clusters_view_projection;
+    uint64_t _clusters_lights_revision;
     
     // X11/Linux specific handles
     Display* _display;
@@ -68,6 +245,31 @@ private:
     Colormap _colormap;
     XSetWindowAttributes _window_attributes;
     
+    std::unique_ptr<SoftwareRasterizer> _software;
+    
+    // Lives as long as the GL context; MeshBuffers hand their buffer objects
+    // to it for deletion while it does (the context takes them down otherwise)
+    std::shared_ptr<GpuContext> _context_token;
+    std::vector<float> _color_scratch;
+    std::vector<uint8_t> _silhouette_facing;
+    std::vector<int> _silhouette_scratch;
+    std::vector<uint8_t> _meshlet_passes;
+    std::vector<uint32_t> _meshlet_ranges;
+    std::vector<GLsizei> _multi_counts;
+    std::vector<const void*> _multi_offsets;
+    RadixSorter _command_sorter;
+    
+    // draw_mesh_instanced working set, reused across calls; the world-space
+    // streams hold one batch of instances
+    Vector3Stream _instance_centers;
+    std::vector<float> _instance_radii;
+    std::vector<uint8_t> _instance_visible;
+    Vector3Stream _instance_positions;
+    Vector3Stream _instance_normals;
+    Vector3Stream _instance_colors;
+    Vector3Stream _instance_dim_colors;
+    Vector3Stream _instance_lit_colors;
+    
     bool _initialized;
     bool _should_close;
 }; 
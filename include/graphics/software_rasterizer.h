@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../math/vector3.h"
+#include "../math/matrix4.h"
+#include "../math/vector3_stream.h"
+#include "../math/aligned_allocator.h"
+#include "../math/kernels.h"
+#include "../core/thread_pool.h"
+#include <cstdint>
+#include <vector>
+
+// CPU rasterizer behind Renderer::initialize_headless(). Draw calls transform,
+// clip and set up triangles immediately but only bin them into 64x64 pixel
+// tiles; flush() then rasterizes the tiles in parallel, each with the
+// kernels::rasterize_triangles SIMD kernel, so no two threads touch the same
+// pixel and draw order within a tile is preserved.
+//
+// Matches the OpenGL path: counter-clockwise front faces, depth range [0, 1]
+// with a less-than test, Gouraud colors interpolated perspective-correctly.
+// Row 0 of the buffers is the top of the image; pixels are RGBA8 with R in
+// the lowest byte.
+class SoftwareRasterizer {
+public:
+    enum class Cull { None, Front, Back };
+    
+    SoftwareRasterizer(int width, int height, unsigned threads = 0);
+    
+    // Flushes pending draws, then fills both buffers
+    void clear(const Vector3& color, float depth = 1.0f);
+    
+    // Indexed triangle list; positions are transformed by mvp into clip space
+    // and clipped against the near plane, colors are per vertex
+    void draw_triangles(const Matrix4& mvp, const Vector3Stream& positions, const Vector3Stream& colors,
+                        const int* indices, size_t index_count, Cull cull);
+    // Only the triangles in ranges (first index, index count pairs), and only
+    // the vertices those reference are transformed
+    void draw_triangle_ranges(const Matrix4& mvp, const Vector3Stream& positions, const Vector3Stream& colors,
+                              const int* indices, const uint32_t* ranges, size_t range_count, Cull cull);
+    void draw_line(const Matrix4& mvp, const Vector3& start, const Vector3& end, const Vector3& color);
+    
+    // Rasterizes everything drawn since the last flush
+    void flush();
+    
+    int width() const { return _width; }
+    int height() const { return _height; }
+    size_t stride() const { return _stride; } // Pixels per buffer row
+    unsigned threads() const { return _pool.size(); }
+    const uint32_t* color_buffer() const { return _color.data(); }
+    const float* depth_buffer() const { return _depth.data(); }
+    
+    // Color as a PAM (RGB_ALPHA) image, depth as a 16-bit PGM; false on I/O error
+    bool save_color(const char* path) const;
+    bool save_depth(const char* path) const;
+    
+private:
+    struct ClipVertex {
+        float x, y, z, w;
+        float r, g, b;
+    };
+    
+    struct RasterLine {
+        float x0, y0, z0;
+        float x1, y1, z1;
+        uint32_t color;
+    };
+    
+    void transform_vertex(const Matrix4& mvp, const Vector3Stream& positions, const Vector3Stream& colors, size_t i);
+    // Clips and sets up triangles over the transformed vertices in _clip
+    void clip_triangles(const int* indices, size_t index_count, Cull cull);
+    void setup_triangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, Cull cull);
+    void bin(uint32_t entry, int min_x, int min_y, int max_x, int max_y);
+    void rasterize_tile(size_t tile_index);
+    void rasterize_line(const RasterLine& line, const kernels::RasterTile& tile);
+    
+    int _width, _height;
+    size_t _stride;
+    int _tiles_x, _tiles_y;
+    
+    std::vector<uint32_t, AlignedAllocator<uint32_t, 64>> _color;
+    std::vector<float, AlignedAllocator<float, 64>> _depth;
+    
+    // Per-flush geometry; bin entries index _triangles, or _lines when LINE_BIT is set
+    static const uint32_t LINE_BIT = 0x80000000u;
+    std::vector<kernels::RasterTriangle> _triangles;
+    std::vector<RasterLine> _lines;
+    std::vector<std::vector<uint32_t>> _bins;
+    
+    // Clip-space scratch reused across draws
+    std::vector<ClipVertex> _clip;
+    std::vector<uint32_t> _clip_stamps; // draw_triangle_ranges: _clip_stamp where _clip is current
+    uint32_t _clip_stamp;
+    
+    ThreadPool _pool;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstddef>
+#include "vector3.h"
+#include "matrix4.h"
+#include "quaternion.h"
+
+// Affine transform stored as the top three rows of a Matrix4 (the bottom row
+// is implicitly (0, 0, 0, 1)): 48 bytes instead of 64, and composing two
+// transforms takes 9 multiply-adds per row pair instead of the full 16.
+// Same column-vector convention as Matrix4: transform_point(p) = A * p.
+class alignas(16) Affine3 {
+public:
+    Affine3(); // Identity
+    Affine3(const float* data); // 12 floats, row-major
+    Affine3(const __m128& row0, const __m128& row1, const __m128& row2);
+    explicit Affine3(const Matrix4& matrix); // Drops the bottom row
+
+    static Affine3 identity() { return Affine3(); }
+    static Affine3 translation(const Vector3& translation);
+    static Affine3 rotation_x(float angle);
+    static Affine3 rotation_y(float angle);
+    static Affine3 rotation_z(float angle);
+    static Affine3 rotation(const Vector3& axis, float angle);
+    static Affine3 rotation(const Quaternion& rotation);
+    static Affine3 scale(const Vector3& scale);
+    static Affine3 scale(float uniform_scale);
+    // translation * rotation * scale, built directly without intermediate products
+    static Affine3 trs(const Vector3& translation, const Quaternion& rotation, const Vector3& scale);
+
+    Affine3 operator*(const Affine3& other) const;
+
+    Vector3 transform_point(const Vector3& point) const;
+    Vector3 transform_vector(const Vector3& vector) const;
+
+    // Batch versions over packed xyz arrays (runtime-dispatched, see kernels.h)
+    void transform_points(const float* in, float* out, size_t count) const;
+    void transform_vectors(const float* in, float* out, size_t count) const;
+    void transform_normals(const float* in, float* out, size_t count) const;
+
+    Affine3 inverse() const; // General 3x3 + translation inverse; identity if singular
+
+    Matrix4 to_matrix() const;
+
+    float& operator()(int row, int col) { return _data[row * 4 + col]; }
+    const float& operator()(int row, int col) const { return _data[row * 4 + col]; }
+
+    const float* data() const { return _data; }
+    const __m128* rows() const { return _rows; }
+
+    // out[i] = lhs * rhs[i], and out[i] = lhs[i] * rhs[i]; out may alias the inputs
+    static void multiply_batch(const Affine3& lhs, const Affine3* rhs, Affine3* out, size_t count);
+    static void multiply_batch(const Affine3* lhs, const Affine3* rhs, Affine3* out, size_t count);
+    // world[i] = world[parents[i]] * local[i], or local[i] for roots (parent < 0).
+    // Parents must precede their children
+    static void compose_hierarchy(const Affine3* local, const int* parents, Affine3* world, size_t count);
+
+    void print() const;
+
+private:
+    union {
+        __m128 _rows[3];
+        float _data[12]; // Row-major, translation in column 3
+    };
+};
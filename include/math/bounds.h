@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include "vector3.h"
+#include "vector3_stream.h"
+#include "matrix4.h"
+#include "affine3.h"
+
+// Axis-aligned box
+struct Aabb {
+    Vector3 min;
+    Vector3 max;
+    
+    Vector3 center() const { return (min + max) * 0.5f; }
+    Vector3 extent() const { return (max - min) * 0.5f; }
+    
+    // Tightest axis-aligned box around this box after the transform
+    Aabb transformed(const Affine3& transform) const;
+};
+
+struct BoundingSphere {
+    Vector3 center;
+    float radius;
+    
+    // Radius grows by the transform's largest axis scale
+    BoundingSphere transformed(const Affine3& transform) const;
+    // Batch version over count instance transforms (kernels::transform_spheres);
+    // centers is resized to count
+    void transformed(const Matrix4* transforms, size_t count, Vector3Stream& centers, float* radii) const;
+};
+
+// Six clip planes extracted from a view-projection matrix (Gribb / Hartmann),
+// normalized with normals pointing into the frustum
+class Frustum {
+public:
+    Frustum(); // Accepts everything
+    explicit Frustum(const Matrix4& view_projection);
+    
+    // Left, right, bottom, top, near, far as (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside
+    const float* planes() const { return _planes; }
+    
+    bool intersects(const BoundingSphere& sphere) const;
+    bool intersects(const Aabb& box) const;
+    
+    // Batch versions (kernels::cull_spheres / cull_aabbs): visible[i] = 1 or 0
+    void cull(const Vector3Stream& centers, const float* radii, uint8_t* visible) const;
+    void cull(const Vector3Stream& mins, const Vector3Stream& maxs, uint8_t* visible) const;
+    
+private:
+    float _planes[24];
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+// Instruction set tiers the hot kernels are built for, in increasing order
+enum class SimdLevel {
+    Scalar, // Plain C++ reference path, used for validation
+    SSE41,
+    AVX2,   // AVX2 + FMA
+    AVX512  // AVX-512 F/VL/DQ/BW
+};
+
+// Highest tier both the CPU and the OS (saved register state) support, via cpuid/xgetbv
+SimdLevel detect_simd_level();
+
+const char* simd_level_name(SimdLevel level);
+
+// Parses "scalar", "sse4.1", "avx2" or "avx512"; returns false for anything else
+bool parse_simd_level(const char* name, SimdLevel& level);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// Batched transcendental functions (runtime-dispatched, see kernels.h; error
+// bounds in simd_math.h). Use these instead of per-value libm calls in loops.
+// Outputs may alias the inputs.
+void sincos_batch(const float* angles, float* sin_out, float* cos_out, size_t count);
+void tan_batch(const float* angles, float* out, size_t count);
+void atan2_batch(const float* y, const float* x, float* out, size_t count);
+void rsqrt_batch(const float* in, float* out, size_t count); // Positive inputs
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "cpu_features.h"
+#include <cstddef>
+#include <cstdint>
+
+// Hot loops built once per SimdLevel in separate translation units
+// (src/math/kernels/) and selected at startup from cpuid. Set ENGINE_SIMD
+// (scalar, sse4.1, avx2, avx512) or call kernels::set_level() to force a
+// lower tier, e.g. the scalar reference path for validation.
+//
+// This header must stay free of inline functions: it is included by
+// translation units compiled for different instruction sets.
+namespace kernels {
+
+// Read-only and writable views of three SoA float streams
+struct Streams {
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+struct MutableStreams {
+    float* x;
+    float* y;
+    float* z;
+};
+
+// Point lights in SoA form. inv_range_sq is 1 / range^2, or 0 for lights
+// without a range
+struct LightArray {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* r;
+    const float* g;
+    const float* b;
+    const float* intensity;
+    const float* inv_range_sq;
+    size_t count;
+};
+
+// Screen-space triangle prepared by the software rasterizer
+// (graphics/software_rasterizer.h). Each quantity is a plane
+// v = a * x + b * y + c over pixel-centre coordinates relative to origin:
+// the three edge functions (a pixel is inside where every edge >= its bias,
+// 0 for top-left edges so shared edges are drawn once), depth in [0, 1],
+// 1 / w and color / w for perspective-correct interpolation
+struct RasterTriangle {
+    float origin_x, origin_y;
+    float edge[3][3];
+    float edge_bias[3];
+    float depth[3];
+    float inv_w[3];
+    float color[3][3];
+    int min_x, min_y, max_x, max_y; // Inclusive pixel bounds
+};
+
+// Rectangle of an RGBA8 + depth framebuffer owned by one thread; x0 and x1
+// are multiples of RASTER_TILE_SIZE so whole-register pixel runs stay inside
+struct RasterTile {
+    uint32_t* color;
+    float* depth;
+    size_t stride; // Pixels per row
+    int x0, y0, x1, y1; // Half-open
+};
+
+const int RASTER_TILE_SIZE = 64;
+
+struct KernelTable {
+    SimdLevel level;
+    
+    // Row-major 4x4 matrix applied as M * (x, y, z, w) with w = 1 for points and
+    // w = 0 for vectors; normals are additionally renormalized. Packed xyz
+    // triplets in and out; in and out may alias.
+    void (*transform_points)(const float* matrix, const float* in, float* out, size_t count);
+    void (*transform_vectors)(const float* matrix, const float* in, float* out, size_t count);
+    void (*transform_normals)(const float* matrix, const float* in, float* out, size_t count);
+    
+    // Same transforms over SoA streams
+    void (*transform_points_soa)(const float* matrix, Streams in, MutableStreams out, size_t count);
+    void (*transform_vectors_soa)(const float* matrix, Streams in, MutableStreams out, size_t count);
+    void (*transform_normals_soa)(const float* matrix, Streams in, MutableStreams out, size_t count);
+    
+    // Diffuse point lighting, clamped to [0, 1]:
+    // out = color * (ambient + sum over lights of max(0, n . l) * light_color * intensity * falloff)
+    // with falloff = max(0, 1 - d^2 / range^2)^2, which reaches zero at the range.
+    // Lights out of range of a whole block of vertices cost one compare. A
+    // vertex's result does not depend on its place in the batch
+    void (*light_vertices)(Streams positions, Streams normals, Streams colors, size_t count,
+                           const LightArray& lights, float ambient, MutableStreams out);
+    
+    // Vertex normals in two scatter-free passes. face_normals writes each
+    // triangle's (p1 - p0) x (p2 - p0), unit length if normalize (twice the
+    // area otherwise), and, if corner_angles is not null, the interior angle at
+    // each of its corners (3 per triangle). gather_vertex_normals then sums, for
+    // each of count vertices, faces[c / 3] times corner_weights[c] (1 if null)
+    // over its corners c = corners[offsets[i]] .. corners[offsets[i + 1] - 1]
+    // in that order, and normalizes; vertices with no corners get zero
+    void (*face_normals)(Streams positions, const int* indices, size_t triangle_count, bool normalize,
+                         MutableStreams faces, float* corner_angles);
+    void (*gather_vertex_normals)(Streams faces, const float* corner_weights, const uint32_t* offsets,
+                                  const uint32_t* corners, size_t count, MutableStreams normals);
+    
+    // Normalizes in place; vectors shorter than 1e-8 become zero
+    void (*normalize)(MutableStreams vectors, size_t count);
+    
+    // out[i] = lhs * rhs[i] for row-major 4x4 matrices stored as 16 floats each;
+    // out may alias rhs
+    void (*multiply_matrices)(const float* lhs, const float* rhs, float* out, size_t count);
+    
+    // out[i] = lhs[i * lhs_stride] * rhs[i] for affine transforms stored as the
+    // top three rows (12 floats) of a row-major 4x4. lhs_stride 0 applies one
+    // lhs to every rhs, 12 composes element-wise; out may alias either input
+    void (*multiply_affines)(const float* lhs, size_t lhs_stride, const float* rhs, float* out, size_t count);
+    
+    // Quaternions stored as packed xyzw (16 bytes each); out may alias either input.
+    // Interpolation takes the shortest path and t per element; results are unit length
+    void (*multiply_quaternions)(const float* a, const float* b, float* out, size_t count);
+    void (*nlerp_quaternions)(const float* a, const float* b, const float* t, float* out, size_t count);
+    void (*slerp_quaternions)(const float* a, const float* b, const float* t, float* out, size_t count);
+    
+    // Element-wise transcendentals; the SIMD tiers use the polynomials in
+    // simd_math.h (error bounds documented there), the scalar tier libm.
+    // Outputs may alias the inputs
+    void (*sincos)(const float* angles, float* sin_out, float* cos_out, size_t count);
+    void (*tan)(const float* angles, float* out, size_t count);
+    void (*atan2)(const float* y, const float* x, float* out, size_t count);
+    void (*rsqrt)(const float* in, float* out, size_t count); // Positive inputs
+    
+    // World-space bounds of one sphere (cx, cy, cz, r) under count row-major 4x4
+    // transforms stored back to back: centers[i] = M[i] * c and radii[i] = r times
+    // M[i]'s largest axis scale
+    void (*transform_spheres)(const float* matrices, size_t count, const float* sphere, MutableStreams centers,
+                              float* radii);
+    
+    // Frustum culling against six (a, b, c, d) planes with inward-facing normals:
+    // visible[i] is 0 if the sphere or box lies entirely behind some plane, else 1
+    // (conservative near the frustum's corners)
+    void (*cull_spheres)(const float* planes, Streams centers, const float* radii, size_t count, uint8_t* visible);
+    void (*cull_aabbs)(const float* planes, Streams mins, Streams maxs, size_t count, uint8_t* visible);
+    
+    // Meshlet rejection from bounding spheres and normal cones (graphics/mesh.h
+    // Meshlets, in the planes' and eye's space): passes[i] bit 0 is set unless
+    // the sphere lies outside the frustum or every face turns away from eye,
+    // bit 1 unless it lies outside or every face turns towards eye. A null eye
+    // tests the spheres only
+    void (*cull_meshlets)(const float* planes, Streams centers, const float* radii, Streams axes,
+                          const float* cutoffs, const float* front_apexes, const float* back_apexes, size_t count,
+                          const float* eye, uint8_t* passes);
+    
+    // facing[i] = 1 if eye lies strictly in front of plane i (n . eye + offset > 0), else 0
+    void (*face_orientation)(Streams normals, const float* offsets, size_t count, const float* eye, uint8_t* facing);
+    
+    // 32-bit hash of each vertex's position, normal and color: hash_words over
+    // quantize_bits of every component, with inverse_cells[attribute].
+    // Attributes whose streams are null are left out. Equal inputs hash
+    // equally on every tier
+    void (*hash_vertices)(Streams positions, Streams normals, Streams colors, size_t count,
+                          const float* inverse_cells, uint32_t* hashes);
+    
+    // Draws triangles[ids[i]] in order into the tile with a less-than depth test
+    void (*rasterize_triangles)(const RasterTriangle* triangles, const uint32_t* ids, size_t count, const RasterTile& tile);
+};
+
+// Scalar reference for hash_vertices, for hashing cells on the host: a
+// value rounded to the nearest multiple of 1 / inverse_cell (clamped to
+// +-2^30 cells) as int32 bits, or with an inverse cell of 0 the exact bits
+// with -0 and +0 alike; and the FNV-1a hash of words, murmur3-finalized
+const uint32_t HASH_BASIS = 2166136261u; // FNV-1a offset basis
+const float QUANTIZE_LIMIT = 1073741824.0f; // 2^30 cells, inside int32 range
+
+uint32_t quantize_bits(float value, float inverse_cell);
+uint32_t hash_words(const uint32_t* words, size_t count);
+
+// Table for the currently selected level
+const KernelTable& active();
+
+// Highest level this host supports
+SimdLevel supported_level();
+
+// Switches every subsequent kernel call to the given level; returns false and
+// keeps the current selection if the host (or the build) lacks that level
+bool set_level(SimdLevel level);
+
+} // namespace kernels
@@ -1,17 +1,23 @@
 #pragma once
 
 #include <immintrin.h>
+#include <cstddef>
 #include "vector3.h"
+#include "vector3_stream.h"
 
-// Check for AVX support at compile time
-#ifndef __AVX__
-    #error "AVX support required. Please compile with -mavx or equivalent flag."
+// SSE4.1 is the baseline; wider instruction sets are only used by the
+// runtime-dispatched kernels (see kernels.h)
+#ifndef __SSE4_1__
+    #error "SSE4.1 support required. Please compile with -msse4.1 or -march=x86-64-v2."
 #endif
 
+class Quaternion;
+
 class alignas(16) Matrix4 {
 public:
     Matrix4();
     Matrix4(const float* data);
+    Matrix4(const __m128& row0, const __m128& row1, const __m128& row2, const __m128& row3);
     Matrix4(const Matrix4& other);
     
     Matrix4& operator=(const Matrix4& other);
@@ -23,6 +29,7 @@ public:
     static Matrix4 rotation_y(float angle);
     static Matrix4 rotation_z(float angle);
     static Matrix4 rotation(const Vector3& axis, float angle); // Arbitrary axis rotation
+    static void rotation_batch(const Vector3& axis, const float* angles, Matrix4* out, size_t count); // Batched sincos
     static Matrix4 scale(const Vector3& scale);
     static Matrix4 scale(float uniform_scale);
     static Matrix4 perspective(float fov, float aspect, float near, float far);
@@ -37,6 +44,18 @@ public:
     Vector3 transform_point(const Vector3& point) const;
     Vector3 transform_vector(const Vector3& vector) const;
     
+    // Batch transforms over packed xyz triplets (in[3*i], in[3*i+1], in[3*i+2]).
+    // Runs the active kernel tier (kernels::active()), a register of 4, 8 or
+    // 16 points at a time, or one on the scalar tier; in and out may alias.
+    void transform_points(const float* in, float* out, size_t count) const;
+    void transform_vectors(const float* in, float* out, size_t count) const;
+    void transform_normals(const float* in, float* out, size_t count) const; // transform_vector + normalize
+    
+    // Same transforms over SoA streams; out is resized to match in
+    void transform_points(const Vector3Stream& in, Vector3Stream& out) const;
+    void transform_vectors(const Vector3Stream& in, Vector3Stream& out) const;
+    void transform_normals(const Vector3Stream& in, Vector3Stream& out) const;
+    
     float& operator()(int row, int col) { return _data[row * 4 + col]; }
     const float& operator()(int row, int col) const { return _data[row * 4 + col]; }
     
@@ -44,7 +63,11 @@ public:
     const __m128* rows() const { return _rows; }
     
     Matrix4 transpose() const;
-    Matrix4 inverse() const;
+    Matrix4 inverse() const; // Returns identity for singular matrices
+    Matrix4 inverse_affine() const; // Rotation/scale/translation only (no shear or projection)
+    static void inverse_batch(const Matrix4* in, Matrix4* out, size_t count);
+    static void inverse_affine_batch(const Matrix4* in, Matrix4* out, size_t count);
+    static void multiply_batch(const Matrix4& lhs, const Matrix4* rhs, Matrix4* out, size_t count); // out[i] = lhs * rhs[i], may alias
     float determinant() const;
     bool is_invertible(float epsilon = 1e-6f) const;
     
@@ -52,6 +75,7 @@ public:
     
     [[maybe_unused]]
     bool decompose(Vector3& translation, Vector3& rotation, Vector3& scale) const;
+    bool decompose(Vector3& translation, Quaternion& rotation, Vector3& scale) const; // No Euler angles / atan2
     
 private:
     union {
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cstddef>
+#include "vector3.h"
+#include "matrix4.h"
+
+// Unit quaternion rotation stored as (x, y, z, w) in one SSE register:
+// 16 bytes instead of a 64-byte Matrix4, and composing two rotations is
+// 16 multiplies instead of 64. Convert with to_matrix() when a Matrix4 is needed.
+class alignas(16) Quaternion {
+public:
+    Quaternion(); // Identity
+    Quaternion(float x, float y, float z, float w);
+    Quaternion(const __m128& simd_data);
+
+    float x() const { return _data[0]; }
+    float y() const { return _data[1]; }
+    float z() const { return _data[2]; }
+    float w() const { return _data[3]; }
+
+    static Quaternion identity() { return Quaternion(); }
+    static Quaternion from_axis_angle(const Vector3& axis, float angle);
+    static void from_axis_angle_batch(const Vector3& axis, const float* angles, Quaternion* out, size_t count);
+    static Quaternion from_matrix(const Matrix4& matrix); // Upper 3x3 must be a pure rotation
+
+    // Hamilton product: (a * b) applies b first, then a, like Matrix4
+    Quaternion operator*(const Quaternion& other) const;
+    Quaternion operator*(float scalar) const;
+    Quaternion operator+(const Quaternion& other) const;
+    Quaternion operator-(const Quaternion& other) const;
+
+    float dot(const Quaternion& other) const;
+    float length() const;
+    Quaternion normalized() const; // Identity for zero-length quaternions
+    void normalize();
+    Quaternion conjugate() const;
+    Quaternion inverse() const;
+
+    Vector3 rotate(const Vector3& v) const;
+    Matrix4 to_matrix() const;
+
+    // Shortest-path interpolation; both return unit quaternions
+    static Quaternion slerp(const Quaternion& a, const Quaternion& b, float t);
+    static Quaternion nlerp(const Quaternion& a, const Quaternion& b, float t);
+
+    // Batch versions over arrays (runtime-dispatched, see kernels.h); out may alias the inputs
+    static void multiply_batch(const Quaternion* a, const Quaternion* b, Quaternion* out, size_t count);
+    static void slerp_batch(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count);
+    static void nlerp_batch(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count);
+    static void to_matrix_batch(const Quaternion* in, Matrix4* out, size_t count);
+
+    const __m128& simd_data() const { return _simd; }
+
+    void print() const;
+
+private:
+    union {
+        __m128 _simd;
+        float _data[4]; // x, y, z, w
+    };
+};
+
+std::ostream& operator<<(std::ostream& os, const Quaternion& q);
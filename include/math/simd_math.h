@@ -0,0 +1,90 @@
+#pragma once
+
+#include "simd_pack.h"
+
+// Vectorized transcendental functions written once against the packs in
+// simd_pack.h (and so available 4, 8 and 16 wide). Same inline-namespace rule
+// as simd_pack.h: only include this from code compiled for one instruction set.
+//
+// Maximum error against glibc's float functions (rsqrt: against the correctly
+// rounded result), measured over 2^22 inputs per tier:
+//   sincos  2 ulp for |x| <= 2 pi; 1e-7 absolute for |x| <= 8192
+//   tan     3 ulp for |x| <= 1.5 (the perspective / fov range)
+//   atan2   3 ulp for finite inputs, signed zeros as in atan2f
+//   rsqrt   4 ulp (Pack4 / Pack8), 2 ulp (Pack16) for positive normal inputs
+
+namespace simd {
+inline namespace SIMD_ISA_NAMESPACE {
+
+// sin and cos of x. Cody-Waite reduction by pi/2 split into three parts keeps
+// q * part exact for |q| < 2^16; cephes minimax polynomials on [-pi/4, pi/4]
+template <class P>
+inline void sincos(typename P::V x, typename P::V& s, typename P::V& c) {
+    using V = typename P::V;
+    V q = P::round(P::mul(x, P::set1(0.63661977236f))); // x * 2 / pi
+    V r = P::nmadd(q, P::set1(1.5703125f), x);
+    r = P::nmadd(q, P::set1(4.837512969970703125e-4f), r);
+    r = P::nmadd(q, P::set1(7.54978995489188216e-8f), r);
+    V z = P::mul(r, r);
+
+    V ps = P::madd(P::madd(P::set1(-1.9515295891e-4f), z, P::set1(8.3321608736e-3f)), z, P::set1(-1.6666654611e-1f));
+    ps = P::madd(P::mul(ps, z), r, r);
+    V pc = P::madd(P::madd(P::set1(2.443315711809948e-5f), z, P::set1(-1.388731625493765e-3f)), z,
+                   P::set1(4.166664568298827e-2f));
+    pc = P::madd(P::mul(pc, z), z, P::nmadd(P::set1(0.5f), z, P::set1(1.0f)));
+
+    // The quadrant q mod 4 rotates (sin, cos) through (ps, pc), (pc, -ps), (-ps, -pc), (-pc, ps)
+    V half = P::mul(q, P::set1(0.5f));
+    auto odd = P::greater(P::sub(half, P::floor(half)), P::set1(0.25f));
+    V quadrant = P::nmadd(P::floor(P::mul(q, P::set1(0.25f))), P::set1(4.0f), q);
+    auto sin_negative = P::greater(quadrant, P::set1(1.5f));
+    auto cos_negative = P::greater(P::set1(1.0f), P::abs(P::sub(quadrant, P::set1(1.5f))));
+    s = P::select(odd, pc, ps);
+    c = P::select(odd, ps, pc);
+    s = P::select(sin_negative, P::sub(P::zero(), s), s);
+    c = P::select(cos_negative, P::sub(P::zero(), c), c);
+}
+
+template <class P>
+inline typename P::V tan(typename P::V x) {
+    typename P::V s, c;
+    sincos<P>(x, s, c);
+    return P::div(s, c);
+}
+
+// atan2(y, x) in [-pi, pi]; like atan2f, +-0 or +-pi when both are zero
+template <class P>
+inline typename P::V atan2(typename P::V y, typename P::V x) {
+    using V = typename P::V;
+    V ax = P::abs(x), ay = P::abs(y);
+    V hi = P::max(ax, ay);
+    V lo = P::min(ax, ay);
+    V a = P::div(lo, P::select(P::greater(hi, P::zero()), hi, P::set1(1.0f))); // [0, 1]
+
+    // Above tan(pi / 8), atan(a) = pi / 4 + atan((a - 1) / (a + 1))
+    auto upper = P::greater(a, P::set1(0.41421356237f));
+    V offset = P::mask(upper, P::set1(0.78539816340f));
+    a = P::select(upper, P::div(P::sub(a, P::set1(1.0f)), P::add(a, P::set1(1.0f))), a);
+
+    V z = P::mul(a, a);
+    V p = P::madd(P::madd(P::madd(P::set1(8.05374449538e-2f), z, P::set1(-1.38776856032e-1f)), z,
+                          P::set1(1.99777106478e-1f)), z, P::set1(-3.33329491539e-1f));
+    V r = P::add(P::madd(P::mul(p, z), a, a), offset);
+
+    r = P::select(P::greater(ay, ax), P::sub(P::set1(1.57079632679f), r), r);
+    // The sign bit, not x < 0, so that -0 takes the left half plane: atan2(+-0, -0) = +-pi
+    r = P::select(P::greater(P::zero(), P::copysign(P::set1(1.0f), x)), P::sub(P::set1(3.14159265359f), r), r);
+    return P::copysign(r, y);
+}
+
+// 1 / sqrt(x): the hardware estimate plus one Newton-Raphson step
+template <class P>
+inline typename P::V rsqrt(typename P::V x) {
+    using V = typename P::V;
+    V r = P::rsqrt(x);
+    V half_x_r = P::mul(P::mul(P::set1(0.5f), x), r);
+    return P::mul(r, P::nmadd(half_x_r, r, P::set1(1.5f)));
+}
+
+} // namespace SIMD_ISA_NAMESPACE
+} // namespace simd
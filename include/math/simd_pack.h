@@ -0,0 +1,437 @@
+#pragma once
+
+#include <immintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Register-width abstraction shared by the kernels and the packet types in
+// vec3xn.h: Pack4 (SSE4.1), Pack8 (AVX2 + FMA) and Pack16 (AVX-512), each
+// defined only when the translation unit is compiled for that instruction set.
+//
+// Every definition lives in an inline namespace named after the widest
+// instruction set of the translation unit, so inline code compiled with
+// different flags (e.g. the per-tier kernel files) is never merged by the
+// linker. Only include headers here that follow the same rule.
+//
+// Loads, stores and gathers take the number of valid lanes n. Pack16 turns n
+// into a lane mask (masked = true), so loops can run to the end of the data
+// without a scalar cleanup loop; narrower packs must be called with n == width.
+
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512DQ__)
+    #define SIMD_ISA_NAMESPACE avx512
+#elif defined(__AVX2__) && defined(__FMA__)
+    #define SIMD_ISA_NAMESPACE avx2
+#elif defined(__SSE4_1__)
+    #define SIMD_ISA_NAMESPACE sse41
+#else
+    #error "simd_pack.h requires SSE4.1"
+#endif
+
+namespace simd {
+inline namespace SIMD_ISA_NAMESPACE {
+
+struct Pack4 {
+    using V = __m128;
+    using M = __m128;
+    static constexpr size_t width = 4;
+    static constexpr bool masked = false;
+
+    static V load(const float* p, size_t) { return _mm_loadu_ps(p); }
+    static void store(float* p, V v, size_t) { _mm_storeu_ps(p, v); }
+    static V set1(float f) { return _mm_set1_ps(f); }
+    static V zero() { return _mm_setzero_ps(); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+#ifdef __FMA__
+    static V madd(V a, V b, V c) { return _mm_fmadd_ps(a, b, c); }
+    static V nmadd(V a, V b, V c) { return _mm_fnmadd_ps(a, b, c); } // c - a * b
+#else
+    static V madd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static V nmadd(V a, V b, V c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+#endif
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_ps(a); }
+    static V rsqrt(V a) { return _mm_rsqrt_ps(a); } // ~12-bit estimate
+    static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static V copysign(V mag, V sign) { return _mm_blendv_ps(abs(mag), _mm_or_ps(mag, _mm_set1_ps(-0.0f)), sign); }
+    static V round(V a) { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static V floor(V a) { return _mm_floor_ps(a); }
+    static M greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static M greater_equal(V a, V b) { return _mm_cmpge_ps(a, b); }
+    static M mask_and(M a, M b) { return _mm_and_ps(a, b); }
+    static bool any(M m) { return _mm_movemask_ps(m) != 0; }
+    static unsigned bits(M m) { return static_cast<unsigned>(_mm_movemask_ps(m)); } // Bit k = lane k
+    static V mask(M m, V v) { return _mm_and_ps(m, v); }
+    static V select(M m, V a, V b) { return _mm_blendv_ps(b, a, m); } // m ? a : b
+    // 1 / sqrt(sq), zero where the length is <= 1e-8
+    static V inv_length(V sq) {
+        V len = _mm_sqrt_ps(sq);
+        return _mm_and_ps(_mm_cmpgt_ps(len, _mm_set1_ps(1e-8f)), _mm_div_ps(_mm_set1_ps(1.0f), len));
+    }
+    static V gather(const float* base, const int* indices, size_t) {
+        return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+    }
+    // r, g, b clamped to [0, 1] packed into RGBA8 pixels (alpha 255), returned as raw bits
+    static V pack_rgba8(V r, V g, V b) {
+        const V lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f);
+        __m128i ri = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(r, hi), lo), hi));
+        __m128i gi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(g, hi), lo), hi));
+        __m128i bi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(b, hi), lo), hi));
+        __m128i rg = _mm_or_si128(ri, _mm_slli_epi32(gi, 8));
+        __m128i ba = _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_set1_epi32(static_cast<int>(0xFF000000u)));
+        return _mm_castsi128_ps(_mm_or_si128(rg, ba));
+    }
+    // Hashing on raw 32-bit lanes: round_bits is a rounded to the nearest
+    // int32 (ties to even), hash_combine one FNV-1a step over a lane of bits
+    // and hash_finish the murmur3 finalizer
+    static V round_bits(V a) { return _mm_castsi128_ps(_mm_cvtps_epi32(a)); }
+    static V hash_combine(V hash, V bits) {
+        __m128i h = _mm_xor_si128(_mm_castps_si128(hash), _mm_castps_si128(bits));
+        return _mm_castsi128_ps(_mm_mullo_epi32(h, _mm_set1_epi32(16777619)));
+    }
+    static V hash_finish(V hash) {
+        __m128i h = _mm_castps_si128(hash);
+        h = _mm_mullo_epi32(_mm_xor_si128(h, _mm_srli_epi32(h, 16)), _mm_set1_epi32(static_cast<int>(0x85EBCA6Bu)));
+        h = _mm_mullo_epi32(_mm_xor_si128(h, _mm_srli_epi32(h, 13)), _mm_set1_epi32(static_cast<int>(0xC2B2AE35u)));
+        return _mm_castsi128_ps(_mm_xor_si128(h, _mm_srli_epi32(h, 16)));
+    }
+
+    // Deinterleave 4 packed xyz triplets (12 floats) into x, y and z lanes
+    static void load_xyz(const float* p, size_t, V& x, V& y, V& z) {
+        V m03 = _mm_loadu_ps(p + 0);
+        V m14 = _mm_loadu_ps(p + 4);
+        V m25 = _mm_loadu_ps(p + 8);
+
+        V xy = _mm_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        V yz = _mm_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        x = _mm_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+        z = _mm_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+    // Inverse of load_xyz
+    static void store_xyz(float* p, size_t, V x, V y, V z) {
+        V rxy = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+        V ryz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+        V rzx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_ps(p + 0, _mm_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(p + 4, _mm_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storeu_ps(p + 8, _mm_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    // 4 packed xyzw records (e.g. quaternions) to and from x, y, z and w lanes
+    static void load_xyzw(const float* p, size_t, V& x, V& y, V& z, V& w) {
+        x = _mm_loadu_ps(p);
+        y = _mm_loadu_ps(p + 4);
+        z = _mm_loadu_ps(p + 8);
+        w = _mm_loadu_ps(p + 12);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+    }
+
+    static void store_xyzw(float* p, size_t, V x, V y, V z, V w) {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(p, x);
+        _mm_storeu_ps(p + 4, y);
+        _mm_storeu_ps(p + 8, z);
+        _mm_storeu_ps(p + 12, w);
+    }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+struct Pack8 {
+    using V = __m256;
+    using M = __m256;
+    static constexpr size_t width = 8;
+    static constexpr bool masked = false;
+
+    static V load(const float* p, size_t) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v, size_t) { _mm256_storeu_ps(p, v); }
+    static V set1(float f) { return _mm256_set1_ps(f); }
+    static V zero() { return _mm256_setzero_ps(); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V madd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+    static V nmadd(V a, V b, V c) { return _mm256_fnmadd_ps(a, b, c); } // c - a * b
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static V rsqrt(V a) { return _mm256_rsqrt_ps(a); } // ~12-bit estimate
+    static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static V copysign(V mag, V sign) { return _mm256_blendv_ps(abs(mag), _mm256_or_ps(mag, _mm256_set1_ps(-0.0f)), sign); }
+    static V round(V a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static V floor(V a) { return _mm256_floor_ps(a); }
+    static M greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static M greater_equal(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M mask_and(M a, M b) { return _mm256_and_ps(a, b); }
+    static bool any(M m) { return _mm256_movemask_ps(m) != 0; }
+    static unsigned bits(M m) { return static_cast<unsigned>(_mm256_movemask_ps(m)); }
+    static V mask(M m, V v) { return _mm256_and_ps(m, v); }
+    static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); } // m ? a : b
+    // 1 / sqrt(sq), zero where the length is <= 1e-8
+    static V inv_length(V sq) {
+        V len = _mm256_sqrt_ps(sq);
+        return _mm256_and_ps(_mm256_cmp_ps(len, _mm256_set1_ps(1e-8f), _CMP_GT_OQ), _mm256_div_ps(_mm256_set1_ps(1.0f), len));
+    }
+    static V gather(const float* base, const int* indices, size_t) {
+        return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), 4);
+    }
+    static V pack_rgba8(V r, V g, V b) {
+        const V lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255.0f);
+        __m256i ri = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(r, hi), lo), hi));
+        __m256i gi = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(g, hi), lo), hi));
+        __m256i bi = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(b, hi), lo), hi));
+        __m256i rg = _mm256_or_si256(ri, _mm256_slli_epi32(gi, 8));
+        __m256i ba = _mm256_or_si256(_mm256_slli_epi32(bi, 16), _mm256_set1_epi32(static_cast<int>(0xFF000000u)));
+        return _mm256_castsi256_ps(_mm256_or_si256(rg, ba));
+    }
+    static V round_bits(V a) { return _mm256_castsi256_ps(_mm256_cvtps_epi32(a)); }
+    static V hash_combine(V hash, V bits) {
+        __m256i h = _mm256_xor_si256(_mm256_castps_si256(hash), _mm256_castps_si256(bits));
+        return _mm256_castsi256_ps(_mm256_mullo_epi32(h, _mm256_set1_epi32(16777619)));
+    }
+    static V hash_finish(V hash) {
+        __m256i h = _mm256_castps_si256(hash);
+        h = _mm256_mullo_epi32(_mm256_xor_si256(h, _mm256_srli_epi32(h, 16)),
+                               _mm256_set1_epi32(static_cast<int>(0x85EBCA6Bu)));
+        h = _mm256_mullo_epi32(_mm256_xor_si256(h, _mm256_srli_epi32(h, 13)),
+                               _mm256_set1_epi32(static_cast<int>(0xC2B2AE35u)));
+        return _mm256_castsi256_ps(_mm256_xor_si256(h, _mm256_srli_epi32(h, 16)));
+    }
+
+    // Deinterleave 8 packed xyz triplets (24 floats) into x, y and z lanes
+    static void load_xyz(const float* p, size_t, V& x, V& y, V& z) {
+        V m03 = _mm256_castps128_ps256(_mm_loadu_ps(p + 0));
+        V m14 = _mm256_castps128_ps256(_mm_loadu_ps(p + 4));
+        V m25 = _mm256_castps128_ps256(_mm_loadu_ps(p + 8));
+        m03 = _mm256_insertf128_ps(m03, _mm_loadu_ps(p + 12), 1);
+        m14 = _mm256_insertf128_ps(m14, _mm_loadu_ps(p + 16), 1);
+        m25 = _mm256_insertf128_ps(m25, _mm_loadu_ps(p + 20), 1);
+
+        V xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        V yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+        z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+    // Inverse of load_xyz
+    static void store_xyz(float* p, size_t, V x, V y, V z) {
+        V rxy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+        V ryz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+        V rzx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+        V r03 = _mm256_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0));
+        V r14 = _mm256_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0));
+        V r25 = _mm256_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(p + 0, _mm256_castps256_ps128(r03));
+        _mm_storeu_ps(p + 4, _mm256_castps256_ps128(r14));
+        _mm_storeu_ps(p + 8, _mm256_castps256_ps128(r25));
+        _mm_storeu_ps(p + 12, _mm256_extractf128_ps(r03, 1));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(r14, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(r25, 1));
+    }
+
+    // Transposes four registers within each 128-bit lane
+    static void transpose4(V& a, V& b, V& c, V& d) {
+        V t0 = _mm256_unpacklo_ps(a, b), t1 = _mm256_unpacklo_ps(c, d);
+        V t2 = _mm256_unpackhi_ps(a, b), t3 = _mm256_unpackhi_ps(c, d);
+        a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    // 8 packed xyzw records; record k and k + 4 share a register so the
+    // in-lane transpose leaves the lanes in natural order
+    static void load_xyzw(const float* p, size_t, V& x, V& y, V& z, V& w) {
+        x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 16), 1);
+        y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 20), 1);
+        z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 24), 1);
+        w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 12)), _mm_loadu_ps(p + 28), 1);
+        transpose4(x, y, z, w);
+    }
+
+    static void store_xyzw(float* p, size_t, V x, V y, V z, V w) {
+        transpose4(x, y, z, w);
+        _mm_storeu_ps(p, _mm256_castps256_ps128(x));
+        _mm_storeu_ps(p + 4, _mm256_castps256_ps128(y));
+        _mm_storeu_ps(p + 8, _mm256_castps256_ps128(z));
+        _mm_storeu_ps(p + 12, _mm256_castps256_ps128(w));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(x, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(y, 1));
+        _mm_storeu_ps(p + 24, _mm256_extractf128_ps(z, 1));
+        _mm_storeu_ps(p + 28, _mm256_extractf128_ps(w, 1));
+    }
+};
+
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512DQ__)
+
+struct Pack16 {
+    using V = __m512;
+    using M = __mmask16;
+    static constexpr size_t width = 16;
+    static constexpr bool masked = true;
+
+    static M lanes(size_t n) { return static_cast<M>(n >= 16 ? 0xFFFFu : (1u << n) - 1u); }
+
+    static V load(const float* p, size_t n) { return _mm512_maskz_loadu_ps(lanes(n), p); }
+    static void store(float* p, V v, size_t n) { _mm512_mask_storeu_ps(p, lanes(n), v); }
+    static V set1(float f) { return _mm512_set1_ps(f); }
+    static V zero() { return _mm512_setzero_ps(); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V madd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+    static V nmadd(V a, V b, V c) { return _mm512_fnmadd_ps(a, b, c); } // c - a * b
+    static V min(V a, V b) { return _mm512_min_ps(a, b); }
+    static V max(V a, V b) { return _mm512_max_ps(a, b); }
+    static V sqrt(V a) { return _mm512_sqrt_ps(a); }
+    static V rsqrt(V a) { return _mm512_rsqrt14_ps(a); } // 14-bit estimate
+    static V abs(V a) { return _mm512_abs_ps(a); }
+    static V copysign(V mag, V sign) { // Bitwise 0x7fffffff ? mag : sign
+        return _mm512_castsi512_ps(_mm512_ternarylogic_epi32(_mm512_set1_epi32(0x7fffffff), _mm512_castps_si512(mag),
+                                                             _mm512_castps_si512(sign), 0xCA));
+    }
+    static V round(V a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static V floor(V a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+    static M greater(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static M greater_equal(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M mask_and(M a, M b) { return static_cast<M>(a & b); }
+    static bool any(M m) { return m != 0; }
+    static unsigned bits(M m) { return m; }
+    static V mask(M m, V v) { return _mm512_maskz_mov_ps(m, v); }
+    static V select(M m, V a, V b) { return _mm512_mask_blend_ps(m, b, a); } // m ? a : b
+    // 1 / sqrt(sq), zero where the length is <= 1e-8. rsqrt14 plus one
+    // Newton-Raphson step is within ~1e-8 relative and avoids sqrt + div
+    static V inv_length(V sq) {
+        V r = _mm512_rsqrt14_ps(sq);
+        V half_sq_r = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), sq), r);
+        r = _mm512_mul_ps(r, _mm512_fnmadd_ps(half_sq_r, r, _mm512_set1_ps(1.5f)));
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(sq, _mm512_set1_ps(1e-16f), _CMP_GT_OQ), r);
+    }
+    static V gather(const float* base, const int* indices, size_t n) {
+        M m = lanes(n);
+        __m512i idx = _mm512_maskz_loadu_epi32(m, indices);
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, idx, base, 4);
+    }
+    static V pack_rgba8(V r, V g, V b) {
+        const V lo = _mm512_setzero_ps(), hi = _mm512_set1_ps(255.0f);
+        __m512i ri = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(r, hi), lo), hi));
+        __m512i gi = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(g, hi), lo), hi));
+        __m512i bi = _mm512_cvtps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(b, hi), lo), hi));
+        __m512i rg = _mm512_or_si512(ri, _mm512_slli_epi32(gi, 8));
+        __m512i ba = _mm512_or_si512(_mm512_slli_epi32(bi, 16), _mm512_set1_epi32(static_cast<int>(0xFF000000u)));
+        return _mm512_castsi512_ps(_mm512_or_si512(rg, ba));
+    }
+    static V round_bits(V a) { return _mm512_castsi512_ps(_mm512_cvtps_epi32(a)); }
+    static V hash_combine(V hash, V bits) {
+        __m512i h = _mm512_xor_si512(_mm512_castps_si512(hash), _mm512_castps_si512(bits));
+        return _mm512_castsi512_ps(_mm512_mullo_epi32(h, _mm512_set1_epi32(16777619)));
+    }
+    static V hash_finish(V hash) {
+        __m512i h = _mm512_castps_si512(hash);
+        h = _mm512_mullo_epi32(_mm512_xor_si512(h, _mm512_srli_epi32(h, 16)),
+                               _mm512_set1_epi32(static_cast<int>(0x85EBCA6Bu)));
+        h = _mm512_mullo_epi32(_mm512_xor_si512(h, _mm512_srli_epi32(h, 13)),
+                               _mm512_set1_epi32(static_cast<int>(0xC2B2AE35u)));
+        return _mm512_castsi512_ps(_mm512_xor_si512(h, _mm512_srli_epi32(h, 16)));
+    }
+
+    // Masks for the three registers spanned by n packed xyz triplets
+    static void triplet_lanes(size_t n, M& m0, M& m1, M& m2) {
+        uint64_t bits = n >= 16 ? ~0ull : (1ull << (3 * n)) - 1ull;
+        m0 = static_cast<M>(bits);
+        m1 = static_cast<M>(bits >> 16);
+        m2 = static_cast<M>(bits >> 32);
+    }
+
+    // Deinterleave 16 packed xyz triplets (48 floats) with two-source permutes:
+    // the first gathers the elements held in registers a/b, the second the rest from c
+    static void load_xyz(const float* p, size_t n, V& x, V& y, V& z) {
+        M m0, m1, m2;
+        triplet_lanes(n, m0, m1, m2);
+        V a = _mm512_maskz_loadu_ps(m0, p);
+        V b = _mm512_maskz_loadu_ps(m1, p + 16);
+        V c = _mm512_maskz_loadu_ps(m2, p + 32);
+
+        const __m512i x_ab = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 0, 0, 0, 0, 0);
+        const __m512i x_c  = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 17, 20, 23, 26, 29);
+        const __m512i y_ab = _mm512_setr_epi32(1, 4, 7, 10, 13, 16, 19, 22, 25, 28, 31, 0, 0, 0, 0, 0);
+        const __m512i y_c  = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 18, 21, 24, 27, 30);
+        const __m512i z_ab = _mm512_setr_epi32(2, 5, 8, 11, 14, 17, 20, 23, 26, 29, 0, 0, 0, 0, 0, 0);
+        const __m512i z_c  = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 19, 22, 25, 28, 31);
+        x = _mm512_permutex2var_ps(_mm512_permutex2var_ps(a, x_ab, b), x_c, c);
+        y = _mm512_permutex2var_ps(_mm512_permutex2var_ps(a, y_ab, b), y_c, c);
+        z = _mm512_permutex2var_ps(_mm512_permutex2var_ps(a, z_ab, b), z_c, c);
+    }
+
+    // Inverse of load_xyz: each output register takes its x/y lanes first, then z
+    static void store_xyz(float* p, size_t n, V x, V y, V z) {
+        M m0, m1, m2;
+        triplet_lanes(n, m0, m1, m2);
+
+        const __m512i a_xy = _mm512_setr_epi32(0, 16, 0, 1, 17, 0, 2, 18, 0, 3, 19, 0, 4, 20, 0, 5);
+        const __m512i a_z  = _mm512_setr_epi32(0, 1, 16, 3, 4, 17, 6, 7, 18, 9, 10, 19, 12, 13, 20, 15);
+        const __m512i b_xy = _mm512_setr_epi32(21, 0, 6, 22, 0, 7, 23, 0, 8, 24, 0, 9, 25, 0, 10, 26);
+        const __m512i b_z  = _mm512_setr_epi32(0, 21, 2, 3, 22, 5, 6, 23, 8, 9, 24, 11, 12, 25, 14, 15);
+        const __m512i c_xy = _mm512_setr_epi32(0, 11, 27, 0, 12, 28, 0, 13, 29, 0, 14, 30, 0, 15, 31, 0);
+        const __m512i c_z  = _mm512_setr_epi32(26, 1, 2, 27, 4, 5, 28, 7, 8, 29, 10, 11, 30, 13, 14, 31);
+        _mm512_mask_storeu_ps(p, m0, _mm512_permutex2var_ps(_mm512_permutex2var_ps(x, a_xy, y), a_z, z));
+        _mm512_mask_storeu_ps(p + 16, m1, _mm512_permutex2var_ps(_mm512_permutex2var_ps(x, b_xy, y), b_z, z));
+        _mm512_mask_storeu_ps(p + 32, m2, _mm512_permutex2var_ps(_mm512_permutex2var_ps(x, c_xy, y), c_z, z));
+    }
+
+    // Transposes four registers within each 128-bit lane
+    static void transpose4(V& a, V& b, V& c, V& d) {
+        V t0 = _mm512_unpacklo_ps(a, b), t1 = _mm512_unpacklo_ps(c, d);
+        V t2 = _mm512_unpackhi_ps(a, b), t3 = _mm512_unpackhi_ps(c, d);
+        a = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        b = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        c = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        d = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    // 16 packed xyzw records. The in-lane transpose leaves record 4 * (k % 4) + k / 4
+    // in lane k; that order is its own inverse, so one permute per register fixes it
+    static void load_xyzw(const float* p, size_t n, V& x, V& y, V& z, V& w) {
+        uint64_t bits = n >= 16 ? ~0ull : (1ull << (4 * n)) - 1ull;
+        x = _mm512_maskz_loadu_ps(static_cast<M>(bits), p);
+        y = _mm512_maskz_loadu_ps(static_cast<M>(bits >> 16), p + 16);
+        z = _mm512_maskz_loadu_ps(static_cast<M>(bits >> 32), p + 32);
+        w = _mm512_maskz_loadu_ps(static_cast<M>(bits >> 48), p + 48);
+        transpose4(x, y, z, w);
+        const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        x = _mm512_permutexvar_ps(order, x);
+        y = _mm512_permutexvar_ps(order, y);
+        z = _mm512_permutexvar_ps(order, z);
+        w = _mm512_permutexvar_ps(order, w);
+    }
+
+    static void store_xyzw(float* p, size_t n, V x, V y, V z, V w) {
+        const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        x = _mm512_permutexvar_ps(order, x);
+        y = _mm512_permutexvar_ps(order, y);
+        z = _mm512_permutexvar_ps(order, z);
+        w = _mm512_permutexvar_ps(order, w);
+        transpose4(x, y, z, w);
+        uint64_t bits = n >= 16 ? ~0ull : (1ull << (4 * n)) - 1ull;
+        _mm512_mask_storeu_ps(p, static_cast<M>(bits), x);
+        _mm512_mask_storeu_ps(p + 16, static_cast<M>(bits >> 16), y);
+        _mm512_mask_storeu_ps(p + 32, static_cast<M>(bits >> 32), z);
+        _mm512_mask_storeu_ps(p + 48, static_cast<M>(bits >> 48), w);
+    }
+};
+
+#endif
+
+} // namespace SIMD_ISA_NAMESPACE
+} // namespace simd
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <immintrin.h>
+#include <cmath>
+#include "vector3.h"
+#include "matrix4.h"
+#include "affine3.h"
+#include "quaternion.h"
+
+// Lazy composition of translation / rotation / scale chains. The factories in
+// namespace transform return small terms and operator* only records the chain;
+// converting it to Affine3 or Matrix4 folds the terms left to right with an
+// update specialised per term, straight into the result registers. There is no
+// Matrix4 temporary per operator* and no identity-initialised storage:
+//
+//     Affine3 model = transform::translate(p) * transform::rotate_y(a) * transform::scale(s);
+//     Matrix4 model_matrix(transform::translate(p) * transform::rotate(q));
+//
+// translate * rotate_y * scale above costs three multiplies: the leading
+// translation only fills in the last column, the rotation is placed as is,
+// and scaling multiplies the columns.
+namespace transform {
+
+template <class Derived>
+struct Expr {
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+
+    Affine3 affine() const;
+    Matrix4 matrix() const;
+
+    operator Affine3() const { return affine(); }
+    explicit operator Matrix4() const { return matrix(); }
+};
+
+// Terms. Vectors keep lane 3 zero so they can be dropped into rows directly
+struct Translate : Expr<Translate> {
+    __m128 t;
+    explicit Translate(const Vector3& v) : t(_mm_blend_ps(v.simd_data(), _mm_setzero_ps(), 0x8)) {}
+};
+
+struct Scale : Expr<Scale> {
+    __m128 s;
+    explicit Scale(const Vector3& v) : s(_mm_blend_ps(v.simd_data(), _mm_setzero_ps(), 0x8)) {}
+};
+
+// Axis-aligned rotations keep sin / cos so composing touches only two columns
+struct RotateX : Expr<RotateX> {
+    float sin_a, cos_a;
+    explicit RotateX(float angle) : sin_a(std::sin(angle)), cos_a(std::cos(angle)) {}
+};
+
+struct RotateY : Expr<RotateY> {
+    float sin_a, cos_a;
+    explicit RotateY(float angle) : sin_a(std::sin(angle)), cos_a(std::cos(angle)) {}
+};
+
+struct RotateZ : Expr<RotateZ> {
+    float sin_a, cos_a;
+    explicit RotateZ(float angle) : sin_a(std::sin(angle)), cos_a(std::cos(angle)) {}
+};
+
+// General 3x3 (axis-angle or quaternion rotation), rows with lane 3 zero
+struct Linear : Expr<Linear> {
+    __m128 rows[3];
+};
+
+// An already built transform (e.g. a parent) inside a chain
+struct Transform : Expr<Transform> {
+    Affine3 value;
+    explicit Transform(const Affine3& a) : value(a) {}
+};
+
+template <class L, class R>
+struct Compose : Expr<Compose<L, R>> {
+    L lhs;
+    R rhs;
+    Compose(const L& l, const R& r) : lhs(l), rhs(r) {}
+};
+
+template <class L, class R>
+inline Compose<L, R> operator*(const Expr<L>& lhs, const Expr<R>& rhs) {
+    return Compose<L, R>(lhs.self(), rhs.self());
+}
+
+inline Translate translate(const Vector3& t) { return Translate(t); }
+inline Scale scale(const Vector3& s) { return Scale(s); }
+inline Scale scale(float s) { return Scale(Vector3(s, s, s)); }
+inline RotateX rotate_x(float angle) { return RotateX(angle); }
+inline RotateY rotate_y(float angle) { return RotateY(angle); }
+inline RotateZ rotate_z(float angle) { return RotateZ(angle); }
+inline Transform affine(const Affine3& a) { return Transform(a); }
+
+inline Linear rotate(const Vector3& axis, float angle) {
+    // Rodrigues' rotation formula
+    Vector3 n = axis.normalized();
+    float s = std::sin(angle), c = std::cos(angle), k = 1.0f - c;
+    float x = n.x(), y = n.y(), z = n.z();
+    Linear r;
+    r.rows[0] = _mm_setr_ps(c + x * x * k, x * y * k - z * s, x * z * k + y * s, 0.0f);
+    r.rows[1] = _mm_setr_ps(y * x * k + z * s, c + y * y * k, y * z * k - x * s, 0.0f);
+    r.rows[2] = _mm_setr_ps(z * x * k - y * s, z * y * k + x * s, c + z * z * k, 0.0f);
+    return r;
+}
+
+inline Linear rotate(const Quaternion& q) {
+    float x2 = q.x() + q.x(), y2 = q.y() + q.y(), z2 = q.z() + q.z();
+    float xx = q.x() * x2, yy = q.y() * y2, zz = q.z() * z2;
+    float xy = q.x() * y2, xz = q.x() * z2, yz = q.y() * z2;
+    float wx = q.w() * x2, wy = q.w() * y2, wz = q.w() * z2;
+    Linear r;
+    r.rows[0] = _mm_setr_ps(1.0f - (yy + zz), xy - wz, xz + wy, 0.0f);
+    r.rows[1] = _mm_setr_ps(xy + wz, 1.0f - (xx + zz), yz - wx, 0.0f);
+    r.rows[2] = _mm_setr_ps(xz - wy, yz + wx, 1.0f - (xx + yy), 0.0f);
+    return r;
+}
+
+namespace detail {
+
+inline __m128 madd(__m128 a, __m128 b, __m128 c) {
+    #ifdef __FMA__
+        return _mm_fmadd_ps(a, b, c);
+    #else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+    #endif
+}
+
+// Partial results of a fold: [I | t] until something other than a
+// translation shows up, then general rows [L | t]
+struct TranslationState {
+    __m128 t;
+};
+
+struct AffineState {
+    __m128 rows[3];
+};
+
+// Rows of a term on its own (translation column zero)
+inline AffineState rows_of(const Scale& s) {
+    __m128 v = s.s;
+    return { { _mm_blend_ps(_mm_setzero_ps(), v, 0x1), _mm_blend_ps(_mm_setzero_ps(), v, 0x2),
+               _mm_blend_ps(_mm_setzero_ps(), v, 0x4) } };
+}
+
+inline AffineState rows_of(const RotateX& r) {
+    return { { _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f), _mm_setr_ps(0.0f, r.cos_a, -r.sin_a, 0.0f),
+               _mm_setr_ps(0.0f, r.sin_a, r.cos_a, 0.0f) } };
+}
+
+inline AffineState rows_of(const RotateY& r) {
+    return { { _mm_setr_ps(r.cos_a, 0.0f, r.sin_a, 0.0f), _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f),
+               _mm_setr_ps(-r.sin_a, 0.0f, r.cos_a, 0.0f) } };
+}
+
+inline AffineState rows_of(const RotateZ& r) {
+    return { { _mm_setr_ps(r.cos_a, -r.sin_a, 0.0f, 0.0f), _mm_setr_ps(r.sin_a, r.cos_a, 0.0f, 0.0f),
+               _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f) } };
+}
+
+inline AffineState rows_of(const Linear& l) {
+    return { { l.rows[0], l.rows[1], l.rows[2] } };
+}
+
+// First term of a chain
+inline TranslationState start(const Translate& t) { return { t.t }; }
+inline AffineState start(const Transform& a) { return { { a.value.rows()[0], a.value.rows()[1], a.value.rows()[2] } }; }
+template <class T>
+inline AffineState start(const T& term) { return rows_of(term); }
+
+// [I | t] * term: the term's rows with t dropped into the last column
+inline TranslationState apply(const TranslationState& s, const Translate& t) { return { _mm_add_ps(s.t, t.t) }; }
+
+inline AffineState apply(const TranslationState& s, const Transform& a) {
+    const __m128* r = a.value.rows();
+    return { { _mm_add_ps(r[0], _mm_insert_ps(_mm_setzero_ps(), s.t, (0 << 6) | (3 << 4))),
+               _mm_add_ps(r[1], _mm_insert_ps(_mm_setzero_ps(), s.t, (1 << 6) | (3 << 4))),
+               _mm_add_ps(r[2], _mm_insert_ps(_mm_setzero_ps(), s.t, (2 << 6) | (3 << 4))) } };
+}
+
+inline AffineState place_translation(AffineState r, __m128 t) {
+    r.rows[0] = _mm_insert_ps(r.rows[0], t, (0 << 6) | (3 << 4));
+    r.rows[1] = _mm_insert_ps(r.rows[1], t, (1 << 6) | (3 << 4));
+    r.rows[2] = _mm_insert_ps(r.rows[2], t, (2 << 6) | (3 << 4));
+    return r;
+}
+
+inline AffineState apply(const TranslationState& s, const Scale& t) { return place_translation(rows_of(t), s.t); }
+inline AffineState apply(const TranslationState& s, const RotateX& t) { return place_translation(rows_of(t), s.t); }
+inline AffineState apply(const TranslationState& s, const RotateY& t) { return place_translation(rows_of(t), s.t); }
+inline AffineState apply(const TranslationState& s, const RotateZ& t) { return place_translation(rows_of(t), s.t); }
+inline AffineState apply(const TranslationState& s, const Linear& t) { return place_translation(rows_of(t), s.t); }
+
+// [L | t] * term
+inline AffineState apply(const AffineState& s, const Translate& t) {
+    // t' = L * v + t: one dot product per row over (v, 1), written to lane 3
+    __m128 v = _mm_blend_ps(t.t, _mm_set1_ps(1.0f), 0x8);
+    AffineState r;
+    for (int i = 0; i < 3; ++i) {
+        r.rows[i] = _mm_blend_ps(s.rows[i], _mm_dp_ps(s.rows[i], v, 0xF8), 0x8);
+    }
+    return r;
+}
+
+inline AffineState apply(const AffineState& s, const Scale& scale) {
+    __m128 v = _mm_blend_ps(scale.s, _mm_set1_ps(1.0f), 0x8);
+    return { { _mm_mul_ps(s.rows[0], v), _mm_mul_ps(s.rows[1], v), _mm_mul_ps(s.rows[2], v) } };
+}
+
+// Axis rotations mix two columns: row * keep + row.swizzled * mix
+template <int Swizzle>
+inline AffineState mix_columns(const AffineState& s, __m128 keep, __m128 mix) {
+    AffineState r;
+    for (int i = 0; i < 3; ++i) {
+        r.rows[i] = madd(_mm_shuffle_ps(s.rows[i], s.rows[i], Swizzle), mix, _mm_mul_ps(s.rows[i], keep));
+    }
+    return r;
+}
+
+inline AffineState apply(const AffineState& s, const RotateX& r) {
+    return mix_columns<_MM_SHUFFLE(3, 1, 2, 0)>(s, _mm_setr_ps(1.0f, r.cos_a, r.cos_a, 1.0f),
+                                                 _mm_setr_ps(0.0f, r.sin_a, -r.sin_a, 0.0f));
+}
+
+inline AffineState apply(const AffineState& s, const RotateY& r) {
+    return mix_columns<_MM_SHUFFLE(3, 0, 1, 2)>(s, _mm_setr_ps(r.cos_a, 1.0f, r.cos_a, 1.0f),
+                                                 _mm_setr_ps(-r.sin_a, 0.0f, r.sin_a, 0.0f));
+}
+
+inline AffineState apply(const AffineState& s, const RotateZ& r) {
+    return mix_columns<_MM_SHUFFLE(3, 2, 0, 1)>(s, _mm_setr_ps(r.cos_a, r.cos_a, 1.0f, 1.0f),
+                                                 _mm_setr_ps(r.sin_a, -r.sin_a, 0.0f, 0.0f));
+}
+
+// Row times the rhs rows (whose lane 3 brings in the rhs translation), plus the row's own translation
+inline __m128 compose_row(__m128 row, const __m128* rhs) {
+    __m128 x = _mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 y = _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 w = _mm_blend_ps(_mm_setzero_ps(), row, 0x8);
+    return madd(z, rhs[2], madd(y, rhs[1], madd(x, rhs[0], w)));
+}
+
+inline AffineState apply(const AffineState& s, const Linear& l) {
+    return { { compose_row(s.rows[0], l.rows), compose_row(s.rows[1], l.rows), compose_row(s.rows[2], l.rows) } };
+}
+
+inline AffineState apply(const AffineState& s, const Transform& a) {
+    const __m128* r = a.value.rows();
+    return { { compose_row(s.rows[0], r), compose_row(s.rows[1], r), compose_row(s.rows[2], r) } };
+}
+
+// Nested chains, e.g. a * (b * c), fold in order
+template <class S, class L, class R>
+inline auto apply(const S& s, const Compose<L, R>& c) {
+    return apply(apply(s, c.lhs), c.rhs);
+}
+
+template <class T>
+inline auto evaluate(const T& term) {
+    return start(term);
+}
+
+template <class L, class R>
+inline auto evaluate(const Compose<L, R>& c) {
+    return apply(evaluate(c.lhs), c.rhs);
+}
+
+inline Affine3 to_affine(const TranslationState& s) {
+    return Affine3(_mm_insert_ps(_mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f), s.t, (0 << 6) | (3 << 4)),
+                   _mm_insert_ps(_mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f), s.t, (1 << 6) | (3 << 4)),
+                   _mm_insert_ps(_mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f), s.t, (2 << 6) | (3 << 4)));
+}
+
+inline Affine3 to_affine(const AffineState& s) {
+    return Affine3(s.rows[0], s.rows[1], s.rows[2]);
+}
+
+} // namespace detail
+
+template <class Derived>
+inline Affine3 Expr<Derived>::affine() const {
+    return detail::to_affine(detail::evaluate(self()));
+}
+
+template <class Derived>
+inline Matrix4 Expr<Derived>::matrix() const {
+    Affine3 a = affine();
+    return Matrix4(a.rows()[0], a.rows()[1], a.rows()[2], _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+} // namespace transform
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "simd_pack.h"
+
+// Eight (or 4 / 16) 3D vectors held as one register per component, the SoA
+// counterpart of Vector3. Every operation is vertical: dot, cross and length
+// produce one result per lane with no horizontal shuffles or reductions.
+//
+//   Vec3x8 p = Vec3x8::load(positions.x() + i, positions.y() + i, positions.z() + i);
+//   Pack8::V n_dot_l = n.dot((light - p).normalized());
+//
+// Vec3x4 is always available, Vec3x8 needs AVX2 + FMA and Vec3x16 AVX-512
+// (see simd_pack.h). Like the packs, these types live in an ISA-tagged
+// namespace and are intended for the runtime-dispatched kernels.
+namespace simd {
+inline namespace SIMD_ISA_NAMESPACE {
+
+template <typename P>
+struct Vec3xN {
+    using Pack = P;
+    using V = typename P::V;
+    using M = typename P::M;
+    static constexpr size_t width = P::width;
+
+    V x, y, z;
+
+    Vec3xN() = default;
+    Vec3xN(V x_, V y_, V z_) : x(x_), y(y_), z(z_) {}
+
+    static Vec3xN broadcast(float vx, float vy, float vz) { return Vec3xN(P::set1(vx), P::set1(vy), P::set1(vz)); }
+    static Vec3xN zero() { return Vec3xN(P::zero(), P::zero(), P::zero()); }
+
+    // n valid lanes starting at the given SoA stream pointers
+    static Vec3xN load(const float* xs, const float* ys, const float* zs, size_t n = width) {
+        return Vec3xN(P::load(xs, n), P::load(ys, n), P::load(zs, n));
+    }
+    void store(float* xs, float* ys, float* zs, size_t n = width) const {
+        P::store(xs, x, n);
+        P::store(ys, y, n);
+        P::store(zs, z, n);
+    }
+
+    // Packed xyz triplets (AoS)
+    static Vec3xN load_packed(const float* xyz, size_t n = width) {
+        Vec3xN v;
+        P::load_xyz(xyz, n, v.x, v.y, v.z);
+        return v;
+    }
+    void store_packed(float* xyz, size_t n = width) const { P::store_xyz(xyz, n, x, y, z); }
+
+    // Element indices[k] of the streams into lane k
+    static Vec3xN gather(const float* xs, const float* ys, const float* zs, const int* indices, size_t n = width) {
+        return Vec3xN(P::gather(xs, indices, n), P::gather(ys, indices, n), P::gather(zs, indices, n));
+    }
+
+    Vec3xN operator+(const Vec3xN& o) const { return Vec3xN(P::add(x, o.x), P::add(y, o.y), P::add(z, o.z)); }
+    Vec3xN operator-(const Vec3xN& o) const { return Vec3xN(P::sub(x, o.x), P::sub(y, o.y), P::sub(z, o.z)); }
+    Vec3xN operator*(const Vec3xN& o) const { return Vec3xN(P::mul(x, o.x), P::mul(y, o.y), P::mul(z, o.z)); }
+    Vec3xN operator*(V s) const { return Vec3xN(P::mul(x, s), P::mul(y, s), P::mul(z, s)); }
+    Vec3xN& operator+=(const Vec3xN& o) { return *this = *this + o; }
+
+    // a * s + c per component
+    static Vec3xN madd(const Vec3xN& a, V s, const Vec3xN& c) {
+        return Vec3xN(P::madd(a.x, s, c.x), P::madd(a.y, s, c.y), P::madd(a.z, s, c.z));
+    }
+
+    V dot(const Vec3xN& o) const { return P::madd(x, o.x, P::madd(y, o.y, P::mul(z, o.z))); }
+
+    Vec3xN cross(const Vec3xN& o) const {
+        return Vec3xN(P::nmadd(z, o.y, P::mul(y, o.z)),
+                      P::nmadd(x, o.z, P::mul(z, o.x)),
+                      P::nmadd(y, o.x, P::mul(x, o.y)));
+    }
+
+    V length_squared() const { return dot(*this); }
+    V length() const { return P::sqrt(length_squared()); }
+
+    // Lanes shorter than 1e-8 become zero, matching Vector3::normalized
+    Vec3xN normalized() const { return *this * P::inv_length(length_squared()); }
+
+    Vec3xN min(const Vec3xN& o) const { return Vec3xN(P::min(x, o.x), P::min(y, o.y), P::min(z, o.z)); }
+    Vec3xN max(const Vec3xN& o) const { return Vec3xN(P::max(x, o.x), P::max(y, o.y), P::max(z, o.z)); }
+    Vec3xN clamped(float lo, float hi) const { return max(broadcast(lo, lo, lo)).min(broadcast(hi, hi, hi)); }
+
+    // Per lane: m ? a : b
+    static Vec3xN select(M m, const Vec3xN& a, const Vec3xN& b) {
+        return Vec3xN(P::select(m, a.x, b.x), P::select(m, a.y, b.y), P::select(m, a.z, b.z));
+    }
+};
+
+using Vec3x4 = Vec3xN<Pack4>;
+#if defined(__AVX2__) && defined(__FMA__)
+using Vec3x8 = Vec3xN<Pack8>;
+#endif
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512DQ__)
+using Vec3x16 = Vec3xN<Pack16>;
+#endif
+
+} // namespace SIMD_ISA_NAMESPACE
+} // namespace simd
@@ -4,9 +4,10 @@
 #include <cmath>
 #include <iostream>
 
-// Check for AVX support at compile time
-#ifndef __AVX__
-    #error "AVX support required. Please compile with -mavx or equivalent flag."
+// SSE4.1 is the baseline; wider instruction sets are only used by the
+// runtime-dispatched kernels (see kernels.h)
+#ifndef __SSE4_1__
+    #error "SSE4.1 support required. Please compile with -msse4.1 or -march=x86-64-v2."
 #endif
 
 class alignas(16) Vector3 {
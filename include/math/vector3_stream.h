@@ -0,0 +1,43 @@
+#pragma once
+
+#include "vector3.h"
+#include "aligned_allocator.h"
+#include <vector>
+
+using AlignedFloatVector = std::vector<float, AlignedAllocator<float, 32>>;
+
+// Structure-of-arrays storage for many Vector3s: three contiguous, 32-byte
+// aligned x/y/z streams that can be loaded straight into AVX registers.
+// Uses 12 bytes per element instead of the 16 a Vector3 occupies.
+class Vector3Stream {
+public:
+    Vector3Stream() = default;
+    explicit Vector3Stream(size_t count, const Vector3& value = Vector3());
+    
+    void push_back(const Vector3& value);
+    void resize(size_t count, const Vector3& value = Vector3());
+    void reserve(size_t count);
+    void clear();
+    
+    Vector3 get(size_t index) const { return Vector3(_x[index], _y[index], _z[index]); }
+    void set(size_t index, const Vector3& value) {
+        _x[index] = value.x();
+        _y[index] = value.y();
+        _z[index] = value.z();
+    }
+    
+    size_t size() const { return _x.size(); }
+    bool empty() const { return _x.empty(); }
+    
+    const float* x() const { return _x.data(); }
+    const float* y() const { return _y.data(); }
+    const float* z() const { return _z.data(); }
+    float* x() { return _x.data(); }
+    float* y() { return _y.data(); }
+    float* z() { return _z.data(); }
+    
+private:
+    AlignedFloatVector _x;
+    AlignedFloatVector _y;
+    AlignedFloatVector _z;
+};
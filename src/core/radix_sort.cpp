@@ -0,0 +1,101 @@
+#include "../../include/core/radix_sort.h"
+#include <algorithm>
+#include <cstring>
+
+RadixSorter::RadixSorter(unsigned threads)
+    : _threads(threads)
+    , _pool(nullptr)
+    , _chunks(1)
+    , _chunk_size(0) {
+}
+
+RadixSorter::RadixSorter(ThreadPool& pool, unsigned threads)
+    : _threads(threads)
+    , _pool(&pool)
+    , _chunks(1)
+    , _chunk_size(0) {
+}
+
+void RadixSorter::histogram(const uint64_t* keys, size_t count, unsigned shift) {
+    std::fill(_counts.begin(), _counts.end(), 0);
+    auto count_chunk = [&](size_t chunk) {
+        size_t* counts = _counts.data() + chunk * 256;
+        const size_t end = std::min(count, (chunk + 1) * _chunk_size);
+        for (size_t i = chunk * _chunk_size; i < end; ++i) {
+            ++counts[(keys[i] >> shift) & 0xFF];
+        }
+    };
+    if (_chunks == 1) {
+        count_chunk(0);
+    } else {
+        _pool->parallel_for(_chunks, count_chunk);
+    }
+}
+
+void RadixSorter::sort(uint64_t* keys, uint32_t* values, size_t count) {
+    if (count < 2) return;
+    
+    _chunks = 1;
+    if (count >= PARALLEL_MIN && _threads != 1) {
+        if (!_pool) {
+            _owned_pool.reset(new ThreadPool(_threads));
+            _pool = _owned_pool.get();
+        }
+        _chunks = _threads ? std::min<size_t>(_threads, _pool->size()) : _pool->size();
+    }
+    _chunk_size = (count + _chunks - 1) / _chunks;
+    _counts.resize(_chunks * 256);
+    _keys.resize(count);
+    _values.resize(count);
+    
+    // Bits that differ anywhere decide which bytes need a pass
+    uint64_t varying = 0;
+    for (size_t i = 1; i < count; ++i) {
+        varying |= keys[i] ^ keys[0];
+    }
+    
+    uint64_t* src_keys = keys;
+    uint32_t* src_values = values;
+    uint64_t* dst_keys = _keys.data();
+    uint32_t* dst_values = _values.data();
+    
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0) continue;
+        
+        histogram(src_keys, count, shift);
+        
+        // Offsets in (digit, chunk) order keep equal digits in input order
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; ++digit) {
+            for (size_t chunk = 0; chunk < _chunks; ++chunk) {
+                size_t& slot = _counts[chunk * 256 + digit];
+                size_t n = slot;
+                slot = offset;
+                offset += n;
+            }
+        }
+        
+        auto scatter_chunk = [&](size_t chunk) {
+            size_t* offsets = _counts.data() + chunk * 256;
+            const size_t end = std::min(count, (chunk + 1) * _chunk_size);
+            for (size_t i = chunk * _chunk_size; i < end; ++i) {
+                size_t slot = offsets[(src_keys[i] >> shift) & 0xFF]++;
+                dst_keys[slot] = src_keys[i];
+                dst_values[slot] = src_values[i];
+            }
+        };
+        if (_chunks == 1) {
+            scatter_chunk(0);
+        } else {
+            _pool->parallel_for(_chunks, scatter_chunk);
+        }
+        
+        std::swap(src_keys, dst_keys);
+        std::swap(src_values, dst_values);
+    }
+    
+    if (src_keys != keys) {
+        std::memcpy(keys, src_keys, count * sizeof(uint64_t));
+        std::memcpy(values, src_values, count * sizeof(uint32_t));
+    }
+}
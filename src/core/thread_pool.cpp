@@ -0,0 +1,100 @@
+#include "../../include/core/thread_pool.h"
+
+namespace {
+
+std::mutex g_shared_pool_mutex;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads)
+    : _task(nullptr)
+    , _count(0)
+    , _next(0)
+    , _active(0)
+    , _generation(0)
+    , _stopping(false) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    _workers.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) {
+        _workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _work_ready.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    
+    if (_workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &fn;
+        _count = count;
+        _next.store(0, std::memory_order_relaxed);
+        _active = static_cast<unsigned>(_workers.size());
+        ++_generation;
+    }
+    _work_ready.notify_all();
+    
+    run_items();
+    
+    std::unique_lock<std::mutex> lock(_mutex);
+    _work_done.wait(lock, [this] { return _active == 0; });
+    _task = nullptr;
+}
+
+void ThreadPool::run_items() {
+    for (size_t i = _next.fetch_add(1, std::memory_order_relaxed); i < _count;
+         i = _next.fetch_add(1, std::memory_order_relaxed)) {
+        (*_task)(i);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _work_ready.wait(lock, [&] { return _stopping || _generation != seen; });
+            if (_stopping) return;
+            seen = _generation;
+        }
+        
+        run_items();
+        
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_active == 0) {
+            _work_done.notify_one();
+        }
+    }
+}
+
+SharedPoolLease::SharedPoolLease(bool wanted)
+    : _pool(nullptr) {
+    if (!wanted) return;
+    _lock = std::unique_lock<std::mutex>(g_shared_pool_mutex, std::try_to_lock);
+    if (_lock.owns_lock()) {
+        static ThreadPool pool;
+        _pool = &pool;
+    }
+}
@@ -0,0 +1,227 @@
+#include "../../include/graphics/light_clusters.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Range of tiles covered by the view-space interval [lo, hi] seen at depths
+// [near_depth, far_depth]; x / depth is monotonic in depth, so the extremes
+// sit at the interval's ends. False if it is entirely off screen
+bool tile_range(float lo, float hi, float near_depth, float far_depth, float tan_half, int tiles,
+                int& first, int& last) {
+    float ndc_lo = lo / ((lo >= 0.0f ? far_depth : near_depth) * tan_half);
+    float ndc_hi = hi / ((hi >= 0.0f ? near_depth : far_depth) * tan_half);
+    if (ndc_hi < -1.0f || ndc_lo > 1.0f) return false;
+    
+    first = std::max(0, static_cast<int>(std::floor((ndc_lo * 0.5f + 0.5f) * tiles)));
+    last = std::min(tiles - 1, static_cast<int>(std::floor((ndc_hi * 0.5f + 0.5f) * tiles)));
+    return true;
+}
+
+} // namespace
+
+LightClusters::LightClusters(unsigned threads)
+    : _tan_half_x(1.0f)
+    , _tan_half_y(1.0f)
+    , _near(0.1f)
+    , _far(100.0f)
+    , _slice_scale(1.0f)
+    , _slice_pairs(SLICES)
+    , _offsets(CLUSTER_COUNT + 2, 0)
+    , _counts(CLUSTER_COUNT + 1, 0)
+    , _capacity(0)
+    , _pool(threads) {
+}
+
+int LightClusters::slice_of(float depth) const {
+    int slice = static_cast<int>(std::floor(std::log(depth / _near) * _slice_scale));
+    return std::min(SLICES - 1, std::max(0, slice));
+}
+
+void LightClusters::build(const Camera& camera, const std::vector<Light>& lights) {
+    _view = camera.view_matrix();
+    _tan_half_y = std::tan(camera.fov() * 0.5f);
+    _tan_half_x = _tan_half_y * camera.aspect_ratio();
+    _near = camera.near_plane();
+    _far = camera.far_plane();
+    _slice_scale = SLICES / std::log(_far / _near);
+    _lights = lights;
+    
+    _bounds.resize(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i) {
+        const Light& light = lights[i];
+        LightBounds& b = _bounds[i];
+        if (light.range <= 0.0f) {
+            b.slice_min = 0;
+            b.slice_max = SLICES - 1;
+            continue;
+        }
+        
+        Vector3 center = _view.transform_point(light.position);
+        float depth = -center.z(); // The camera looks down -z
+        b.x_min = center.x() - light.range;
+        b.x_max = center.x() + light.range;
+        b.y_min = center.y() - light.range;
+        b.y_max = center.y() + light.range;
+        b.depth_min = std::max(depth - light.range, _near);
+        b.depth_max = std::min(depth + light.range, _far);
+        if (b.depth_min > b.depth_max) {
+            b.slice_min = b.slice_max = -1;
+            continue;
+        }
+        b.slice_min = slice_of(b.depth_min);
+        b.slice_max = slice_of(b.depth_max);
+    }
+    
+    // Bin each depth slice independently
+    _pool.parallel_for(SLICES, [this](size_t slice) { bin_slice(static_cast<int>(slice), _slice_pairs[slice]); });
+    
+    std::fill(_counts.begin(), _counts.end(), 0);
+    for (int slice = 0; slice < SLICES; ++slice) {
+        const std::vector<uint32_t>& pairs = _slice_pairs[slice];
+        for (size_t p = 0; p < pairs.size(); p += 2) {
+            ++_counts[static_cast<size_t>(slice) * TILES_X * TILES_Y + pairs[p]];
+        }
+    }
+    _counts[CLUSTER_COUNT] = static_cast<uint32_t>(lights.size());
+    for (int c = 0; c <= CLUSTER_COUNT; ++c) {
+        _offsets[c + 1] = _offsets[c] + _counts[c];
+    }
+    
+    _capacity = _offsets[CLUSTER_COUNT + 1];
+    _light_data.resize(_capacity * 8);
+    auto store = [this](size_t slot, uint32_t index) {
+        const Light& light = _lights[index];
+        const float values[8] = {light.position.x(), light.position.y(), light.position.z(),
+                                 light.color.x(), light.color.y(), light.color.z(), light.intensity,
+                                 light.range > 0.0f ? 1.0f / (light.range * light.range) : 0.0f};
+        for (int k = 0; k < 8; ++k) {
+            _light_data[k * _capacity + slot] = values[k];
+        }
+    };
+    
+    _pool.parallel_for(SLICES, [&](size_t slice) {
+        const size_t first_cell = slice * TILES_X * TILES_Y;
+        uint32_t cursor[TILES_X * TILES_Y];
+        for (int cell = 0; cell < TILES_X * TILES_Y; ++cell) {
+            cursor[cell] = _offsets[first_cell + cell];
+        }
+        const std::vector<uint32_t>& pairs = _slice_pairs[slice];
+        for (size_t p = 0; p < pairs.size(); p += 2) {
+            store(cursor[pairs[p]]++, pairs[p + 1]);
+        }
+    });
+    for (size_t i = 0; i < lights.size(); ++i) {
+        store(_offsets[CLUSTER_COUNT] + i, static_cast<uint32_t>(i));
+    }
+}
+
+void LightClusters::bin_slice(int slice, std::vector<uint32_t>& pairs) const {
+    pairs.clear();
+    // Widened slightly so rounding in slice_of() cannot put a vertex outside its slice's bounds
+    const float slice_near = _near * std::exp(slice / _slice_scale) * 0.9999f;
+    const float slice_far = _near * std::exp((slice + 1) / _slice_scale) * 1.0001f;
+    
+    // Lights in index order, so every froxel lists them in the same order as the
+    // full list and sums match the unclustered result
+    for (size_t i = 0; i < _lights.size(); ++i) {
+        const LightBounds& b = _bounds[i];
+        if (slice < b.slice_min || slice > b.slice_max) continue;
+        
+        int x0 = 0, x1 = TILES_X - 1, y0 = 0, y1 = TILES_Y - 1;
+        if (_lights[i].range > 0.0f) {
+            float near_depth = std::max(slice_near, b.depth_min);
+            float far_depth = std::min(slice_far, b.depth_max);
+            if (!tile_range(b.x_min, b.x_max, near_depth, far_depth, _tan_half_x, TILES_X, x0, x1) ||
+                !tile_range(b.y_min, b.y_max, near_depth, far_depth, _tan_half_y, TILES_Y, y0, y1)) {
+                continue;
+            }
+        }
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                pairs.push_back(static_cast<uint32_t>(y * TILES_X + x));
+                pairs.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+}
+
+int LightClusters::cluster_of(const Vector3& point) const {
+    Vector3 view = _view.transform_point(point);
+    float depth = -view.z();
+    if (!(depth >= _near && depth <= _far)) return -1;
+    
+    float ndc_x = view.x() / (depth * _tan_half_x);
+    float ndc_y = view.y() / (depth * _tan_half_y);
+    if (!(std::fabs(ndc_x) <= 1.0f && std::fabs(ndc_y) <= 1.0f)) return -1;
+    
+    int x = std::min(TILES_X - 1, static_cast<int>((ndc_x * 0.5f + 0.5f) * TILES_X));
+    int y = std::min(TILES_Y - 1, static_cast<int>((ndc_y * 0.5f + 0.5f) * TILES_Y));
+    return (slice_of(depth) * TILES_Y + y) * TILES_X + x;
+}
+
+kernels::LightArray LightClusters::light_array(size_t offset, size_t count) const {
+    const float* data = _light_data.data() + offset;
+    return {data, data + _capacity, data + 2 * _capacity, data + 3 * _capacity, data + 4 * _capacity,
+            data + 5 * _capacity, data + 6 * _capacity, data + 7 * _capacity, count};
+}
+
+void LightClusters::light_vertices(kernels::Streams positions, kernels::Streams normals, kernels::Streams colors,
+                                   size_t count, float ambient, kernels::MutableStreams out) {
+    // Counting sort of the vertices by froxel; bucket CLUSTER_COUNT takes the
+    // ones outside the frustum
+    _vertex_cluster.resize(count);
+    std::vector<uint32_t>& offsets = _bucket_offsets;
+    offsets.assign(CLUSTER_COUNT + 2, 0);
+    for (size_t i = 0; i < count; ++i) {
+        int cluster = cluster_of(Vector3(positions.x[i], positions.y[i], positions.z[i]));
+        _vertex_cluster[i] = cluster < 0 ? CLUSTER_COUNT : cluster;
+        ++offsets[_vertex_cluster[i] + 1];
+    }
+    for (int c = 0; c <= CLUSTER_COUNT; ++c) {
+        offsets[c + 1] += offsets[c];
+    }
+    _order.resize(count);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < count; ++i) {
+            _order[cursor[_vertex_cluster[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+    
+    // Gather into contiguous per-froxel runs: 9 input streams and 3 outputs
+    _gathered.resize(count * 12);
+    float* streams[12];
+    for (int k = 0; k < 12; ++k) {
+        streams[k] = _gathered.data() + k * count;
+    }
+    const float* inputs[9] = {positions.x, positions.y, positions.z, normals.x, normals.y, normals.z,
+                              colors.x, colors.y, colors.z};
+    for (size_t j = 0; j < count; ++j) {
+        for (int k = 0; k < 9; ++k) {
+            streams[k][j] = inputs[k][_order[j]];
+        }
+    }
+    
+    std::vector<uint32_t> buckets;
+    for (int c = 0; c <= CLUSTER_COUNT; ++c) {
+        if (offsets[c + 1] > offsets[c]) buckets.push_back(static_cast<uint32_t>(c));
+    }
+    const kernels::KernelTable& k = kernels::active();
+    _pool.parallel_for(buckets.size(), [&](size_t b) {
+        const uint32_t cluster = buckets[b];
+        const size_t first = offsets[cluster];
+        const size_t n = offsets[cluster + 1] - first;
+        k.light_vertices({streams[0] + first, streams[1] + first, streams[2] + first},
+                         {streams[3] + first, streams[4] + first, streams[5] + first},
+                         {streams[6] + first, streams[7] + first, streams[8] + first}, n,
+                         light_array(_offsets[cluster], _counts[cluster]), ambient,
+                         {streams[9] + first, streams[10] + first, streams[11] + first});
+    });
+    
+    for (size_t j = 0; j < count; ++j) {
+        out.x[_order[j]] = streams[9][j];
+        out.y[_order[j]] = streams[10][j];
+        out.z[_order[j]] = streams[11][j];
+    }
+}
@@ -1,18 +1,198 @@
 #include "../../include/graphics/mesh.h"
+#include "../../include/math/kernels.h"
+#include "../../include/math/fast_math.h"
+#include "../../include/core/radix_sort.h"
+#include "../../include/core/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
 #include <cmath>
+#include <cstring>
+#include <functional>
 
-Mesh::Mesh() {}
+namespace {
+
+uint64_t next_revision() {
+    static std::atomic<uint64_t> counter(0);
+    return ++counter;
+}
+
+// Meshlets whose faces stray further than this (cosine) from the cone axis
+// get no cone
+const float MESHLET_CONE_MIN_DOT = 0.1f;
+
+// Multiple of every kernel tier's register width
+const size_t NORMALS_CHUNK_ALIGN = 64;
+
+// Faces whose normals are closer than this are treated as one plane
+const float COPLANAR_DOT = 0.9999f;
+
+} // namespace
+
+Mesh::Mesh()
+    : _revision(next_revision())
+    , _topology_revision(_revision)
+    , _corners_revision(0)
+    , _bounds_revision(0)
+    , _bounding_sphere{ Vector3(), 0.0f }
+    , _adjacency_revision(0) {
+}
 
 Mesh::~Mesh() {}
 
+void Mesh::touch() {
+    _revision = next_revision();
+}
+
+void Mesh::touch_positions() {
+    touch();
+    _lods.clear();
+    _meshlets = Meshlets();
+}
+
+void Mesh::touch_topology() {
+    touch_positions();
+    _topology_revision = _revision;
+}
+
+const Aabb& Mesh::bounds() const {
+    if (_bounds_revision != _revision) update_bounds();
+    return _bounds;
+}
+
+const BoundingSphere& Mesh::bounding_sphere() const {
+    if (_bounds_revision != _revision) update_bounds();
+    return _bounding_sphere;
+}
+
+void Mesh::update_bounds() const {
+    const size_t count = vertex_count();
+    const float* axes[3] = { _positions.x(), _positions.y(), _positions.z() };
+    float lo[3] = { 0.0f, 0.0f, 0.0f };
+    float hi[3] = { 0.0f, 0.0f, 0.0f };
+    for (int axis = 0; axis < 3 && count > 0; ++axis) {
+        lo[axis] = *std::min_element(axes[axis], axes[axis] + count);
+        hi[axis] = *std::max_element(axes[axis], axes[axis] + count);
+    }
+    _bounds = { Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]) };
+    
+    const Vector3 center = _bounds.center();
+    float radius_sq = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        float dx = axes[0][i] - center.x();
+        float dy = axes[1][i] - center.y();
+        float dz = axes[2][i] - center.z();
+        radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+    }
+    _bounding_sphere = { center, std::sqrt(radius_sq) };
+    _bounds_revision = _revision;
+}
+
+const EdgeAdjacency& Mesh::adjacency() const {
+    if (_adjacency_revision != _revision) update_adjacency();
+    return _adjacency;
+}
+
+void Mesh::update_adjacency() const {
+    const size_t count = vertex_count();
+    const size_t triangles = triangle_count();
+    EdgeAdjacency& adjacency = _adjacency;
+    
+    // Weld: every vertex maps to the first vertex at exactly its position
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    auto position_bits = [this](uint32_t i, uint32_t out[3]) {
+        const float p[3] = { _positions.x()[i], _positions.y()[i], _positions.z()[i] };
+        std::memcpy(out, p, sizeof(p));
+    };
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t pa[3], pb[3];
+        position_bits(a, pa);
+        position_bits(b, pb);
+        return std::lexicographical_compare(pa, pa + 3, pb, pb + 3) || (std::equal(pa, pa + 3, pb) && a < b);
+    });
+    std::vector<uint32_t> weld(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t current[3], previous[3];
+        position_bits(order[i], current);
+        if (i > 0) position_bits(order[i - 1], previous);
+        weld[order[i]] = i > 0 && std::equal(current, current + 3, previous) ? weld[order[i - 1]] : order[i];
+    }
+    
+    // Half-edges keyed by their welded end points, sorted so each edge's halves are adjacent
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> halves;
+    keys.reserve(triangles * 3);
+    halves.reserve(triangles * 3);
+    for (size_t t = 0; t < triangles; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            uint64_t a = weld[_indices[t * 3 + k]];
+            uint64_t b = weld[_indices[t * 3 + (k + 1) % 3]];
+            if (a == b) continue;
+            keys.push_back(a < b ? a << 32 | b : b << 32 | a);
+            halves.push_back(static_cast<uint32_t>(t * 3 + k));
+        }
+    }
+    const SharedPoolLease lease(keys.size() >= RadixSorter::PARALLEL_MIN);
+    RadixSorter sorter = lease.pool() ? RadixSorter(*lease.pool()) : RadixSorter(1);
+    sorter.sort(keys.data(), halves.data(), keys.size());
+    
+    adjacency.vertices.clear();
+    adjacency.faces.clear();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const uint32_t half = halves[i];
+        if (i > 0 && keys[i] == keys[i - 1]) {
+            // Second face of the edge; any further ones (non-manifold) are dropped
+            int& second = adjacency.faces.back();
+            if (second < 0) second = static_cast<int>(half / 3);
+            continue;
+        }
+        adjacency.vertices.push_back(_indices[half]);
+        adjacency.vertices.push_back(_indices[half - half % 3 + (half % 3 + 1) % 3]);
+        adjacency.faces.push_back(static_cast<int>(half / 3));
+        adjacency.faces.push_back(-1);
+    }
+    
+    // Face planes, flipped where the winding disagrees with the vertex normals
+    adjacency.face_normals.resize(triangles);
+    adjacency.face_offsets.resize(triangles);
+    for (size_t t = 0; t < triangles; ++t) {
+        const int* tri = &_indices[t * 3];
+        const Vector3 p0 = position(tri[0]);
+        Vector3 n = (position(tri[1]) - p0).cross(position(tri[2]) - p0);
+        const Vector3 smooth = normal(tri[0]) + normal(tri[1]) + normal(tri[2]);
+        float length = n.length();
+        float scale = length > 1e-12f ? 1.0f / length : 0.0f;
+        n = n * (n.dot(smooth) < 0.0f ? -scale : scale);
+        adjacency.face_normals.set(t, n);
+        adjacency.face_offsets[t] = -n.dot(p0);
+    }
+    
+    adjacency.feature_edges.clear();
+    for (size_t e = 0; e < adjacency.edge_count(); ++e) {
+        const int f0 = adjacency.faces[e * 2], f1 = adjacency.faces[e * 2 + 1];
+        if (f1 >= 0 && adjacency.face_normals.get(f0).dot(adjacency.face_normals.get(f1)) > COPLANAR_DOT) continue;
+        adjacency.feature_edges.push_back(adjacency.vertices[e * 2]);
+        adjacency.feature_edges.push_back(adjacency.vertices[e * 2 + 1]);
+    }
+    
+    _adjacency_revision = _revision;
+}
+
 void Mesh::add_vertex(const Vertex& vertex) {
-    _vertices.push_back(vertex);
+    _positions.push_back(vertex.position);
+    _normals.push_back(vertex.normal);
+    _colors.push_back(vertex.color);
+    touch_topology();
 }
 
 void Mesh::add_triangle(int v1, int v2, int v3) {
     _indices.push_back(v1);
     _indices.push_back(v2);
     _indices.push_back(v3);
+    touch_topology();
 }
 
 Mesh Mesh::create_cube(float size) {
@@ -67,7 +247,7 @@ Mesh Mesh::create_cube(float size) {
     };
     
     for (int face = 0; face < 6; ++face) {
-        int base_vertex = mesh._vertices.size();
+        int base_vertex = mesh.vertex_count();
         
         for (int i = 0; i < 4; ++i) {
             mesh.add_vertex(Vertex(
@@ -97,23 +277,29 @@ Mesh Mesh::create_sphere(float radius, int segments) {
         Vector3(1, 1, 1)
     ));
     
-    for (int lat = 1; lat < segments; ++lat) {
-        float theta = static_cast<float>(lat) * M_PI / segments;
-        float sin_theta = std::sin(theta);
-        float cos_theta = std::cos(theta);
-        
-        for (int lon = 0; lon < segments * 2; ++lon) {
-            float phi = static_cast<float>(lon) * 2.0f * M_PI / (segments * 2);
-            float sin_phi = std::sin(phi);
-            float cos_phi = std::cos(phi);
-            
-            Vector3 position(
-                radius * sin_theta * cos_phi,
-                radius * cos_theta,
-                radius * sin_theta * sin_phi
+    // Every ring shares the same longitudes, so the trig runs once per angle
+    // through the batched sincos instead of twice per vertex
+    const int points_per_ring = segments * 2;
+    std::vector<float> theta(segments > 1 ? segments - 1 : 0), sin_theta(theta.size()), cos_theta(theta.size());
+    std::vector<float> phi(points_per_ring), sin_phi(phi.size()), cos_phi(phi.size());
+    for (size_t lat = 0; lat < theta.size(); ++lat) {
+        theta[lat] = static_cast<float>(lat + 1) * M_PI / segments;
+    }
+    for (int lon = 0; lon < points_per_ring; ++lon) {
+        phi[lon] = static_cast<float>(lon) * 2.0f * M_PI / points_per_ring;
+    }
+    sincos_batch(theta.data(), sin_theta.data(), cos_theta.data(), theta.size());
+    sincos_batch(phi.data(), sin_phi.data(), cos_phi.data(), phi.size());
+    
+    for (size_t lat = 0; lat < theta.size(); ++lat) {
+        for (int lon = 0; lon < points_per_ring; ++lon) {
+            // Unit direction from the centre, which is also the normal
+            Vector3 normal(
+                sin_theta[lat] * cos_phi[lon],
+                cos_theta[lat],
+                sin_theta[lat] * sin_phi[lon]
             );
-            
-            Vector3 normal = position.normalized();
+            Vector3 position = normal * radius;
             Vector3 color(
                 (normal.x() + 1.0f) * 0.5f,
                 (normal.y() + 1.0f) * 0.5f,
@@ -131,7 +317,6 @@ Mesh Mesh::create_sphere(float radius, int segments) {
     ));
     
     int rings = segments - 1;
-    int points_per_ring = segments * 2;
     
     for (int i = 0; i < points_per_ring; ++i) {
         int next = (i + 1) % points_per_ring;
@@ -160,7 +345,7 @@ Mesh Mesh::create_sphere(float radius, int segments) {
     }
     
     int last_ring_start = 1 + (rings - 1) * points_per_ring;
-    int bottom_vertex = mesh._vertices.size() - 1;
+    int bottom_vertex = mesh.vertex_count() - 1;
     
     for (int i = 0; i < points_per_ring; ++i) {
         int next = (i + 1) % points_per_ring;
@@ -233,31 +418,248 @@ Mesh Mesh::create_triangle(float size) {
     return mesh;
 }
 
-void Mesh::calculate_normals() {
-    for (auto& vertex : _vertices) {
-        vertex.normal = Vector3(0, 0, 0);
+void Mesh::calculate_normals(NormalWeighting weighting, unsigned threads) {
+    const size_t count = vertex_count();
+    const size_t triangles = triangle_count();
+    _normals.resize(count);
+    
+    // Counting sort of the corners by vertex, in corner order, so each vertex
+    // sums its faces in the same order a serial scatter would
+    if (_corners_revision != _topology_revision) {
+        _corner_offsets.assign(count + 1, 0);
+        for (size_t c = 0; c < triangles * 3; ++c) {
+            ++_corner_offsets[_indices[c] + 1];
+        }
+        for (size_t v = 0; v < count; ++v) {
+            _corner_offsets[v + 1] += _corner_offsets[v];
+        }
+        _vertex_corners.resize(triangles * 3);
+        std::vector<uint32_t> fill(_corner_offsets.begin(), _corner_offsets.end() - 1);
+        for (size_t c = 0; c < triangles * 3; ++c) {
+            _vertex_corners[fill[_indices[c]]++] = static_cast<uint32_t>(c);
+        }
+        _corners_revision = _topology_revision;
+    }
+    
+    // Contiguous chunks of triangles, then of vertices, one per thread for
+    // large meshes. Chunks are whole registers, so only the last one ends in a
+    // scalar tail and the result stays the same for any thread count
+    const SharedPoolLease lease(triangles >= NORMALS_PARALLEL_MIN && threads != 1);
+    ThreadPool* pool = lease.pool();
+    const size_t chunks = !pool ? 1 : threads ? std::min(threads, pool->size()) : pool->size();
+    auto for_chunks = [&](size_t total, const std::function<void(size_t, size_t)>& fn) {
+        const size_t chunk_size = ((total + chunks - 1) / chunks + NORMALS_CHUNK_ALIGN - 1) & ~(NORMALS_CHUNK_ALIGN - 1);
+        auto run = [&](size_t chunk) {
+            const size_t first = std::min(total, chunk * chunk_size);
+            fn(first, std::min(total, first + chunk_size));
+        };
+        if (pool) {
+            pool->parallel_for(chunks, run);
+        } else {
+            run(0);
+        }
+    };
+    
+    const kernels::KernelTable& k = kernels::active();
+    const kernels::Streams positions = { _positions.x(), _positions.y(), _positions.z() };
+    Vector3Stream faces(triangles);
+    std::vector<float> angles(weighting == NormalWeighting::Angle ? triangles * 3 : 0);
+    float* corner_angles = angles.empty() ? nullptr : angles.data();
+    for_chunks(triangles, [&](size_t first, size_t last) {
+        k.face_normals(positions, _indices.data() + first * 3, last - first, weighting != NormalWeighting::Area,
+                       { faces.x() + first, faces.y() + first, faces.z() + first },
+                       corner_angles ? corner_angles + first * 3 : nullptr);
+    });
+    for_chunks(count, [&](size_t first, size_t last) {
+        k.gather_vertex_normals({ faces.x(), faces.y(), faces.z() }, corner_angles, _corner_offsets.data() + first,
+                                _vertex_corners.data(), last - first,
+                                { _normals.x() + first, _normals.y() + first, _normals.z() + first });
+    });
+    touch();
+}
+
+MeshOptimization Mesh::optimize() {
+    const size_t count = vertex_count();
+    MeshOptimization report;
+    report.before = analyze_vertex_cache(_indices.data(), _indices.size(), count);
+    
+    std::vector<int> ordered(_indices.size());
+    optimize_vertex_cache(_indices.data(), _indices.size(), count, ordered.data());
+    optimize_overdraw(ordered.data(), ordered.size(), _positions, _normals, _indices.data());
+    
+    std::vector<int> remap(count);
+    vertex_fetch_remap(_indices.data(), _indices.size(), count, remap.data());
+    for (int& index : _indices) {
+        index = remap[index];
+    }
+    for (Vector3Stream* stream : { &_positions, &_normals, &_colors }) {
+        Vector3Stream reordered(count);
+        for (size_t v = 0; v < count; ++v) {
+            reordered.set(remap[v], stream->get(v));
+        }
+        *stream = std::move(reordered);
+    }
+    touch_topology();
+    
+    report.after = analyze_vertex_cache(_indices.data(), _indices.size(), count);
+    return report;
+}
+
+size_t Mesh::weld(const WeldTolerance& tolerance, unsigned threads) {
+    const size_t count = vertex_count();
+    std::vector<int> remap(count);
+    const size_t unique = weld_remap(_positions, _normals, _colors, tolerance, remap.data(), threads);
+    if (unique == count) return 0;
+    
+    // Representatives are numbered in vertex order, so each lands at or before its old slot
+    for (Vector3Stream* stream : { &_positions, &_normals, &_colors }) {
+        float* axes[3] = { stream->x(), stream->y(), stream->z() };
+        for (size_t v = 0, next = 0; v < count; ++v) {
+            if (remap[v] != static_cast<int>(next)) continue;
+            for (float* axis : axes) {
+                axis[next] = axis[v];
+            }
+            ++next;
+        }
+        stream->resize(unique);
+    }
+    for (int& index : _indices) {
+        index = remap[index];
+    }
+    touch_topology();
+    return count - unique;
+}
+
+void Mesh::generate_lods(const std::vector<LodTarget>& targets, unsigned threads) {
+    std::vector<MeshLod> levels(targets.size());
+    auto build = [&](size_t level) {
+        MeshLod& lod = levels[level];
+        const size_t target = static_cast<size_t>(targets[level].triangle_ratio * triangle_count()) * 3;
+        lod.indices.resize(_indices.size());
+        lod.indices.resize(simplify(_indices.data(), _indices.size(), _positions, target, targets[level].max_error,
+                                    lod.indices.data(), &lod.error));
+        lod.indices.shrink_to_fit();
+    };
+    
+    // Up to threads lanes of the shared pool, each building every lanes-th level
+    const SharedPoolLease lease(targets.size() > 1 && threads != 1);
+    const size_t lanes = !lease.pool() ? 1 : std::min<size_t>(targets.size(),
+                                                               threads ? threads : lease.pool()->size());
+    auto run = [&](size_t lane) {
+        for (size_t level = lane; level < targets.size(); level += lanes) build(level);
+    };
+    if (lanes > 1) {
+        lease.pool()->parallel_for(lanes, run);
+    } else {
+        run(0);
     }
     
-    for (size_t i = 0; i < _indices.size(); i += 3) {
-        int i0 = _indices[i];
-        int i1 = _indices[i + 1];
-        int i2 = _indices[i + 2];
+    _revision = next_revision(); // Meshlets index the unchanged full mesh
+    _lods.clear();
+    size_t previous = _indices.size();
+    for (MeshLod& lod : levels) {
+        if (lod.indices.empty() || lod.indices.size() >= previous) continue;
+        previous = lod.indices.size();
+        _lods.push_back(std::move(lod));
+    }
+}
+
+void Mesh::generate_lods(size_t levels, float ratio, unsigned threads) {
+    std::vector<LodTarget> targets(levels);
+    float triangle_ratio = 1.0f;
+    for (LodTarget& target : targets) {
+        triangle_ratio *= ratio;
+        target.triangle_ratio = triangle_ratio;
+    }
+    generate_lods(targets, threads);
+}
+
+void Mesh::build_meshlets(size_t max_vertices, size_t max_triangles) {
+    const size_t triangles = triangle_count();
+    std::vector<int> ordered(triangles * 3);
+    Meshlets meshlets;
+    meshlets.first_triangle.resize(triangles + 1);
+    const size_t count = ::build_meshlets(_indices.data(), ordered.size(), _positions, max_vertices, max_triangles,
+                                          ordered.data(), meshlets.first_triangle.data());
+    meshlets.first_triangle.resize(count + 1);
+    meshlets.centers.resize(count);
+    meshlets.radii.resize(count);
+    meshlets.cone_axes.resize(count);
+    meshlets.cone_cutoffs.resize(count);
+    meshlets.front_apexes.resize(count);
+    meshlets.back_apexes.resize(count);
+    
+    std::vector<Vector3> normals;
+    for (size_t m = 0; m < count; ++m) {
+        const int* first = ordered.data() + size_t(meshlets.first_triangle[m]) * 3;
+        const int* last = ordered.data() + size_t(meshlets.first_triangle[m + 1]) * 3;
         
-        Vector3 v1 = _vertices[i1].position - _vertices[i0].position;
-        Vector3 v2 = _vertices[i2].position - _vertices[i0].position;
-        Vector3 normal = v1.cross(v2).normalized();
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (const int* i = first; i != last; ++i) {
+            const float p[3] = { _positions.x()[*i], _positions.y()[*i], _positions.z()[*i] };
+            for (int axis = 0; axis < 3; ++axis) {
+                lo[axis] = std::min(lo[axis], p[axis]);
+                hi[axis] = std::max(hi[axis], p[axis]);
+            }
+        }
+        const Vector3 center = Aabb{ Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]) }.center();
+        float radius_sq = 0.0f;
+        for (const int* i = first; i != last; ++i) {
+            radius_sq = std::max(radius_sq, (_positions.get(*i) - center).length_squared());
+        }
+        meshlets.centers.set(m, center);
+        meshlets.radii[m] = std::sqrt(radius_sq);
         
-        _vertices[i0].normal = _vertices[i0].normal + normal;
-        _vertices[i1].normal = _vertices[i1].normal + normal;
-        _vertices[i2].normal = _vertices[i2].normal + normal;
+        // Axis along the mean face normal; degenerate faces face nowhere
+        normals.clear();
+        Vector3 sum;
+        for (const int* tri = first; tri != last; tri += 3) {
+            const Vector3 p0 = _positions.get(tri[0]);
+            const Vector3 normal = (_positions.get(tri[1]) - p0).cross(_positions.get(tri[2]) - p0);
+            const float length = normal.length();
+            normals.push_back(length > 0.0f ? normal * (1.0f / length) : Vector3());
+            sum = sum + normals.back();
+        }
+        const float sum_length = sum.length();
+        const Vector3 axis = sum_length > 0.0f ? sum * (1.0f / sum_length) : Vector3(0, 0, 1);
+        float min_dot = 1.0f;
+        for (const Vector3& normal : normals) {
+            if (normal.length_squared() > 0.0f) min_dot = std::min(min_dot, normal.dot(axis));
+        }
+        meshlets.cone_axes.set(m, axis);
+        
+        // Past about 84 degrees the apexes run off too far to reject anything
+        if (sum_length == 0.0f || min_dot <= MESHLET_CONE_MIN_DOT) {
+            meshlets.cone_cutoffs[m] = 2.0f;
+            continue;
+        }
+        meshlets.cone_cutoffs[m] = std::sqrt(1.0f - min_dot * min_dot);
+        
+        // Offsets along the axis at which the eye is behind (front) or in
+        // front of (back) every face's plane once inside the cone
+        float front = -FLT_MAX, back = FLT_MAX;
+        for (size_t t = 0; t < normals.size(); ++t) {
+            const Vector3& normal = normals[t];
+            if (normal.dot(axis) <= 0.0f) continue;
+            const float offset = (center - _positions.get(first[t * 3])).dot(normal) / normal.dot(axis);
+            front = std::max(front, offset);
+            back = std::min(back, offset);
+        }
+        meshlets.front_apexes[m] = front;
+        meshlets.back_apexes[m] = back;
     }
     
-    for (auto& vertex : _vertices) {
-        vertex.normal.normalize();
-    }
+    _indices.swap(ordered);
+    _revision = next_revision(); // Levels of detail index the unchanged vertices
+    _topology_revision = _revision;
+    _meshlets = std::move(meshlets);
 }
 
 void Mesh::clear() {
-    _vertices.clear();
+    _positions.clear();
+    _normals.clear();
+    _colors.clear();
     _indices.clear();
+    touch_topology();
 } 
@@ -0,0 +1,776 @@
+#include "../../include/graphics/mesh_optimizer.h"
+#include "../../include/math/kernels.h"
+#include "../../include/core/radix_sort.h"
+#include "../../include/core/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Forsyth's scoring: the last triangle's vertices get a fixed score, the
+// rest of the cache a score decaying with position, and vertices with few
+// remaining triangles a boost so that they are finished off early
+const int SCORE_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+const unsigned VALENCE_TABLE_SIZE = 32;
+
+struct ScoreTables {
+    float cache[SCORE_CACHE_SIZE + 1]; // By cache position + 1; [0] is not cached
+    float valence[VALENCE_TABLE_SIZE];
+
+    ScoreTables() {
+        cache[0] = 0.0f;
+        for (int position = 0; position < SCORE_CACHE_SIZE; ++position) {
+            cache[position + 1] = position < 3
+                ? LAST_TRIANGLE_SCORE
+                : std::pow(1.0f - float(position - 3) / (SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        valence[0] = 0.0f;
+        for (unsigned live = 1; live < VALENCE_TABLE_SIZE; ++live) {
+            valence[live] = VALENCE_BOOST_SCALE * std::pow(float(live), -VALENCE_BOOST_POWER);
+        }
+    }
+
+    float score(int cache_position, unsigned live) const {
+        if (live == 0) return -1.0f; // Nothing left to draw with it
+        float boost = live < VALENCE_TABLE_SIZE ? valence[live]
+                                                : VALENCE_BOOST_SCALE * std::pow(float(live), -VALENCE_BOOST_POWER);
+        return cache[cache_position + 1] + boost;
+    }
+};
+
+const ScoreTables& score_tables() {
+    static const ScoreTables tables;
+    return tables;
+}
+
+// FIFO cache simulation by timestamps: a vertex is cached while fewer than
+// cache_size misses happened since its own
+struct FifoCache {
+    std::vector<uint32_t> stamps;
+    uint32_t time;
+    uint32_t size;
+
+    FifoCache(size_t vertex_count, unsigned cache_size) : stamps(vertex_count, 0), time(cache_size + 1), size(cache_size) {}
+
+    bool miss(int vertex) {
+        if (time - stamps[vertex] <= size) return false;
+        stamps[vertex] = time++;
+        return true;
+    }
+    void reset() { time += size + 1; }
+};
+
+} // namespace
+
+VertexCacheStats analyze_vertex_cache(const int* indices, size_t index_count, size_t vertex_count, unsigned cache_size) {
+    VertexCacheStats stats;
+    if (index_count < 3) return stats;
+
+    FifoCache cache(vertex_count, cache_size);
+    std::vector<uint8_t> referenced(vertex_count, 0);
+    size_t misses = 0, unique = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+        misses += cache.miss(indices[i]);
+        unique += !referenced[indices[i]];
+        referenced[indices[i]] = 1;
+    }
+    stats.acmr = float(misses) / float(index_count / 3);
+    stats.atvr = float(misses) / float(unique);
+    return stats;
+}
+
+void optimize_vertex_cache(const int* indices, size_t index_count, size_t vertex_count, int* out) {
+    const size_t triangles = index_count / 3;
+    const ScoreTables& tables = score_tables();
+
+    // Triangles using each vertex; the first live[v] of them are not drawn yet
+    std::vector<unsigned> live(vertex_count, 0);
+    for (size_t i = 0; i < triangles * 3; ++i) {
+        ++live[indices[i]];
+    }
+    std::vector<size_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacent(offsets.back());
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangles * 3; ++i) {
+            adjacent[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        vertex_score[v] = tables.score(-1, live[v]);
+    }
+    std::vector<float> triangle_score(triangles);
+    std::vector<uint8_t> emitted(triangles, 0);
+    for (size_t t = 0; t < triangles; ++t) {
+        const int* tri = indices + t * 3;
+        triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+    }
+
+    int cache[SCORE_CACHE_SIZE + 3];
+    int cache_count = 0;
+    size_t best = triangles ? std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin() : 0;
+    size_t cursor = 0; // Input order fallback once nothing in the cache has triangles left
+
+    for (size_t emitted_count = 0; emitted_count < triangles; ++emitted_count) {
+        if (best == triangles) {
+            while (emitted[cursor]) ++cursor;
+            best = cursor;
+        }
+        const int* tri = indices + best * 3;
+        std::copy(tri, tri + 3, out + emitted_count * 3);
+        emitted[best] = 1;
+
+        // Retire the triangle from its vertices' live lists
+        for (int k = 0; k < 3; ++k) {
+            const int v = tri[k];
+            uint32_t* list = &adjacent[offsets[v]];
+            for (unsigned j = 0; j < live[v]; ++j) {
+                if (list[j] == best) {
+                    std::swap(list[j], list[live[v] - 1]);
+                    --live[v];
+                    break;
+                }
+            }
+        }
+
+        // Its vertices move to the front of the LRU cache
+        int next[SCORE_CACHE_SIZE + 3];
+        int next_count = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (std::find(next, next + next_count, tri[k]) == next + next_count) next[next_count++] = tri[k];
+        }
+        for (int i = 0; i < cache_count; ++i) {
+            if (std::find(next, next + next_count, cache[i]) == next + next_count) next[next_count++] = cache[i];
+        }
+        std::copy(next, next + next_count, cache);
+        cache_count = next_count;
+
+        // Rescore every vertex whose position or valence changed and the
+        // triangles still using it, keeping the best of those
+        best = triangles;
+        float best_score = -1.0f;
+        for (int i = 0; i < cache_count; ++i) {
+            const int v = cache[i];
+            const int position = i < SCORE_CACHE_SIZE ? i : -1; // Pushed out past the end
+            const float score = tables.score(position, live[v]);
+            const float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (unsigned j = 0; j < live[v]; ++j) {
+                const uint32_t t = adjacent[offsets[v] + j];
+                triangle_score[t] += delta;
+            }
+        }
+        for (int i = 0; i < std::min(cache_count, SCORE_CACHE_SIZE); ++i) {
+            const int v = cache[i];
+            for (unsigned j = 0; j < live[v]; ++j) {
+                const uint32_t t = adjacent[offsets[v] + j];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+        cache_count = std::min(cache_count, SCORE_CACHE_SIZE);
+    }
+}
+
+void optimize_overdraw(const int* indices, size_t index_count, const Vector3Stream& positions,
+                       const Vector3Stream& normals, int* out, float threshold, unsigned cache_size) {
+    const size_t triangles = index_count / 3;
+    if (triangles == 0) return;
+
+    // Hard cluster boundaries: triangles whose three vertices all miss
+    FifoCache cache(positions.size(), cache_size);
+    std::vector<size_t> hard;
+    for (size_t t = 0; t < triangles; ++t) {
+        const int* tri = indices + t * 3;
+        const int misses = cache.miss(tri[0]) + cache.miss(tri[1]) + cache.miss(tri[2]);
+        if (t == 0 || misses == 3) hard.push_back(t);
+    }
+    hard.push_back(triangles);
+
+    // Soft boundaries: restart the cache within a hard cluster wherever the
+    // part since the last restart is already within threshold of the
+    // cluster's own ACMR
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        const size_t begin = hard[h], end = hard[h + 1];
+        cache.reset();
+        size_t cluster_misses = 0;
+        for (size_t i = begin * 3; i < end * 3; ++i) {
+            cluster_misses += cache.miss(indices[i]);
+        }
+        const float limit = threshold * float(cluster_misses) / float(end - begin);
+
+        cache.reset();
+        size_t start = begin, misses = 0;
+        clusters.push_back(begin);
+        for (size_t t = begin; t < end; ++t) {
+            const int* tri = indices + t * 3;
+            misses += cache.miss(tri[0]) + cache.miss(tri[1]) + cache.miss(tri[2]);
+            if (t + 1 < end && float(misses) / float(t - start + 1) <= limit) {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+                cache.reset();
+            }
+        }
+    }
+    const size_t cluster_count = clusters.size();
+    clusters.push_back(triangles);
+
+    // Area-weighted centroid and facing of every cluster
+    std::vector<Vector3> centroids(cluster_count), facings(cluster_count);
+    Vector3 mesh_centroid;
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < cluster_count; ++c) {
+        Vector3 centroid, facing;
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const int* tri = indices + t * 3;
+            const Vector3 p0 = positions.get(tri[0]), p1 = positions.get(tri[1]), p2 = positions.get(tri[2]);
+            Vector3 n = (p1 - p0).cross(p2 - p0);
+            const Vector3 smooth = normals.get(tri[0]) + normals.get(tri[1]) + normals.get(tri[2]);
+            if (n.dot(smooth) < 0.0f) n = n * -1.0f;
+            const float weight = n.length();
+            centroid = centroid + (p0 + p1 + p2) * (weight / 3.0f);
+            facing = facing + n;
+            area += weight;
+        }
+        mesh_centroid = mesh_centroid + centroid;
+        mesh_area += area;
+        centroids[c] = area > 0.0f ? centroid * (1.0f / area) : positions.get(indices[clusters[c] * 3]);
+        const float length = facing.length();
+        facings[c] = length > 0.0f ? facing * (1.0f / length) : Vector3();
+    }
+    if (mesh_area > 0.0f) mesh_centroid = mesh_centroid * (1.0f / mesh_area);
+
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; ++c) {
+        sort_keys[c] = (centroids[c] - mesh_centroid).dot(facings[c]);
+    }
+    std::vector<size_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    for (size_t c : order) {
+        out = std::copy(indices + clusters[c] * 3, indices + clusters[c + 1] * 3, out);
+    }
+}
+
+size_t vertex_fetch_remap(const int* indices, size_t index_count, size_t vertex_count, int* remap) {
+    std::fill(remap, remap + vertex_count, -1);
+    int next = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+        if (remap[indices[i]] < 0) remap[indices[i]] = next++;
+    }
+    const size_t referenced = static_cast<size_t>(next);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        if (remap[v] < 0) remap[v] = next++;
+    }
+    return referenced;
+}
+
+namespace {
+
+// Vertices within tolerance of each other share a weld cell or, near its
+// faces, neighbour cells. WELD_CELL_MARGIN (in cells) absorbs rounding of the
+// scaled positions
+const float WELD_CELL_MARGIN = 1.0f / 16.0f;
+
+} // namespace
+
+size_t weld_remap(const Vector3Stream& positions, const Vector3Stream& normals, const Vector3Stream& colors,
+                  const WeldTolerance& tolerance, int* remap, unsigned threads) {
+    const size_t count = positions.size();
+    if (count == 0) return 0;
+    
+    // Contiguous chunks, one per thread of the shared pool for large inputs
+    const SharedPoolLease lease(count >= WELD_PARALLEL_MIN && threads != 1);
+    ThreadPool* pool = lease.pool();
+    const size_t chunks = !pool ? 1 : threads ? std::min<size_t>(threads, pool->size()) : pool->size();
+    const size_t chunk_size = (count + chunks - 1) / chunks;
+    auto for_chunks = [&](const std::function<void(size_t, size_t)>& fn) {
+        auto run = [&](size_t chunk) { fn(chunk * chunk_size, std::min(count, (chunk + 1) * chunk_size)); };
+        if (pool) {
+            pool->parallel_for(chunks, run);
+        } else {
+            run(0);
+        }
+    };
+    
+    // Hash the cell of each position (normals and colors are only compared),
+    // then sort by hash; the stable sort keeps each run in vertex order
+    const float inverse_cell = tolerance.position > 0.0f ? 1.0f / (WELD_CELL_SCALE * tolerance.position) : 0.0f;
+    const float inverse_cells[3] = { inverse_cell, 0.0f, 0.0f };
+    const kernels::Streams none = { nullptr, nullptr, nullptr };
+    std::vector<uint32_t> hashes(count);
+    const kernels::KernelTable& k = kernels::active();
+    for_chunks([&](size_t begin, size_t end) {
+        const kernels::Streams cells = { positions.x() + begin, positions.y() + begin, positions.z() + begin };
+        k.hash_vertices(cells, none, none, end - begin, inverse_cells, hashes.data() + begin);
+    });
+    std::vector<uint64_t> keys(count);
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = uint64_t(hashes[i]) << 32;
+        order[i] = static_cast<uint32_t>(i);
+    }
+    RadixSorter sorter = pool ? RadixSorter(*pool, threads) : RadixSorter(1);
+    sorter.sort(keys.data(), order.data(), count);
+    
+    // Runs are named by their first sorted index. Neighbour cells are found by
+    // hash through an open-addressed table of run starts (the hashes are
+    // already mixed)
+    std::vector<uint32_t> own_run(count);
+    size_t run_total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const bool starts = i == 0 || keys[i] != keys[i - 1];
+        own_run[order[i]] = starts ? static_cast<uint32_t>(i) : own_run[order[i - 1]];
+        run_total += starts;
+    }
+    const bool neighbours = inverse_cell > 0.0f; // Exact duplicates share a cell
+    size_t slots = 1;
+    while (neighbours && slots < 2 * run_total) slots <<= 1;
+    std::vector<uint32_t> run_starts(slots, UINT32_MAX);
+    for (size_t i = 0; neighbours && i < count; ++i) {
+        if (i > 0 && keys[i] == keys[i - 1]) continue;
+        size_t slot = (keys[i] >> 32) & (slots - 1);
+        while (run_starts[slot] != UINT32_MAX) slot = (slot + 1) & (slots - 1);
+        run_starts[slot] = static_cast<uint32_t>(i);
+    }
+    auto find_run = [&](uint32_t hash) {
+        for (size_t slot = hash & (slots - 1); run_starts[slot] != UINT32_MAX; slot = (slot + 1) & (slots - 1)) {
+            if (keys[run_starts[slot]] >> 32 == hash) return size_t(run_starts[slot]);
+        }
+        return count;
+    };
+    
+    // Runs of v's cell and of the neighbour cells it lies near: those a
+    // tolerance away across a face, edge or corner
+    const float reach = 0.5f - 1.0f / WELD_CELL_SCALE - WELD_CELL_MARGIN;
+    auto cell_runs = [&](size_t v, size_t* runs) {
+        size_t run_count = 0;
+        runs[run_count++] = own_run[v];
+        if (!neighbours) return run_count;
+        const float p[3] = { positions.x()[v], positions.y()[v], positions.z()[v] };
+        uint32_t cell[3];
+        uint32_t step[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            cell[axis] = kernels::quantize_bits(p[axis], inverse_cell);
+            const float scaled = std::fmin(std::fmax(p[axis] * inverse_cell, -kernels::QUANTIZE_LIMIT),
+                                           kernels::QUANTIZE_LIMIT);
+            const float offset = scaled - static_cast<float>(static_cast<int32_t>(cell[axis]));
+            step[axis] = offset > reach ? 1u : offset < -reach ? ~0u : 0u;
+        }
+        for (unsigned corner = 1; corner < 8; ++corner) {
+            uint32_t words[3];
+            bool near_corner = true;
+            for (int axis = 0; axis < 3; ++axis) {
+                const bool moved = (corner >> axis) & 1u;
+                near_corner = near_corner && (!moved || step[axis]);
+                words[axis] = cell[axis] + (moved ? step[axis] : 0u);
+            }
+            if (!near_corner) continue;
+            const size_t run = find_run(kernels::hash_words(words, 3));
+            if (run < count && std::find(runs, runs + run_count, run) == runs + run_count) runs[run_count++] = run;
+        }
+        return run_count;
+    };
+    auto within = [&](size_t a, size_t b) {
+        const Vector3Stream* streams[3] = { &positions, &normals, &colors };
+        const float limits[3] = { tolerance.position, tolerance.normal, tolerance.color };
+        for (int attribute = 0; attribute < 3; ++attribute) {
+            const Vector3Stream& s = *streams[attribute];
+            if (std::fabs(s.x()[a] - s.x()[b]) > limits[attribute] ||
+                std::fabs(s.y()[a] - s.y()[b]) > limits[attribute] ||
+                std::fabs(s.z()[a] - s.z()[b]) > limits[attribute]) return false;
+        }
+        return true;
+    };
+    
+    // Earliest vertex before v within tolerance of it, if wanted only among
+    // the representatives settled so far; -1 if there is none
+    auto earliest = [&](size_t v, bool representatives) {
+        size_t runs[8];
+        const size_t run_count = cell_runs(v, runs);
+        int match = -1;
+        for (size_t r = 0; r < run_count; ++r) {
+            for (size_t i = runs[r]; i < count && keys[i] == keys[runs[r]]; ++i) {
+                const int u = static_cast<int>(order[i]);
+                if (u >= (match < 0 ? static_cast<int>(v) : match)) break;
+                if ((!representatives || remap[u] == u) && within(v, order[i])) {
+                    match = u;
+                    break;
+                }
+            }
+        }
+        return match;
+    };
+    
+    // Each vertex joins the earliest representative within tolerance, or
+    // becomes one. The earliest vertex within tolerance is found in parallel;
+    // only where that one was itself absorbed is the search repeated in order
+    for_chunks([&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) remap[v] = earliest(v, false);
+    });
+    for (size_t v = 0; v < count; ++v) {
+        int match = remap[v];
+        if (match >= 0 && remap[match] != match) match = earliest(v, true);
+        remap[v] = match < 0 ? static_cast<int>(v) : match;
+    }
+    
+    // Representatives precede the vertices they absorb, so one pass numbers them
+    size_t unique = 0;
+    for (size_t v = 0; v < count; ++v) {
+        remap[v] = remap[v] == static_cast<int>(v) ? static_cast<int>(unique++) : remap[remap[v]];
+    }
+    return unique;
+}
+
+namespace {
+
+// Symmetric 4x4 plane quadric plus the area it was accumulated over
+struct Quadric {
+    double a2 = 0, b2 = 0, c2 = 0, d2 = 0, ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+    double weight = 0;
+
+    void add_plane(double a, double b, double c, double d, double w) {
+        a2 += w * a * a; b2 += w * b * b; c2 += w * c * c; d2 += w * d * d;
+        ab += w * a * b; ac += w * a * c; ad += w * a * d;
+        bc += w * b * c; bd += w * b * d; cd += w * c * d;
+        weight += w;
+    }
+    void add(const Quadric& q) {
+        a2 += q.a2; b2 += q.b2; c2 += q.c2; d2 += q.d2; ab += q.ab; ac += q.ac; ad += q.ad;
+        bc += q.bc; bd += q.bd; cd += q.cd; weight += q.weight;
+    }
+    // Weighted sum of squared plane distances of (x, y, z)
+    double evaluate(double x, double y, double z) const {
+        return a2 * x * x + b2 * y * y + c2 * z * z + d2
+             + 2 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+    }
+};
+
+// Every vertex mapped to the first vertex at exactly its position
+std::vector<int> position_groups(const Vector3Stream& positions) {
+    const size_t count = positions.size();
+    std::vector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    auto key = [&](int v) { return std::make_tuple(positions.x()[v], positions.y()[v], positions.z()[v]); };
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return key(a) < key(b) || (key(a) == key(b) && a < b); });
+    std::vector<int> group(count);
+    for (size_t i = 0; i < count; ++i) {
+        group[order[i]] = i > 0 && key(order[i]) == key(order[i - 1]) ? group[order[i - 1]] : order[i];
+    }
+    return group;
+}
+
+} // namespace
+
+size_t simplify(const int* indices, size_t index_count, const Vector3Stream& positions, size_t target_index_count,
+                float max_error, int* out, float* error) {
+    const size_t vertex_count = positions.size();
+    const std::vector<int> group = position_groups(positions);
+    auto position = [&](int v) { return positions.get(v); };
+    auto degenerate = [&](const int* tri) {
+        return group[tri[0]] == group[tri[1]] || group[tri[1]] == group[tri[2]] || group[tri[2]] == group[tri[0]];
+    };
+    std::vector<int> triangles;
+    triangles.reserve(index_count);
+    for (size_t t = 0; t + 3 <= index_count; t += 3) {
+        if (!degenerate(indices + t)) triangles.insert(triangles.end(), indices + t, indices + t + 3);
+    }
+    
+    // Seams and open or non-manifold borders stay put
+    std::vector<uint8_t> locked(vertex_count, 0);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        if (group[v] != static_cast<int>(v)) locked[v] = locked[group[v]] = 1;
+    }
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            uint64_t a = group[triangles[i]], b = group[triangles[i - i % 3 + (i % 3 + 1) % 3]];
+            if (a != b) edges.push_back(a < b ? a << 32 | b : b << 32 | a);
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i]) ++j;
+            if (j - i != 2) locked[edges[i] >> 32] = locked[edges[i] & 0xFFFFFFFFu] = 1;
+            i = j;
+        }
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+        locked[v] = locked[group[v]];
+    }
+    
+    // Area-weighted plane quadrics, accumulated on each position's group
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t t = 0; t < triangles.size(); t += 3) {
+        const Vector3 p0 = position(triangles[t]);
+        const Vector3 n = (position(triangles[t + 1]) - p0).cross(position(triangles[t + 2]) - p0);
+        const double length = n.length();
+        if (length <= 0.0) continue;
+        const double a = n.x() / length, b = n.y() / length, c = n.z() / length;
+        const double d = -(a * p0.x() + b * p0.y() + c * p0.z());
+        for (int k = 0; k < 3; ++k) {
+            quadrics[group[triangles[t + k]]].add_plane(a, b, c, d, length * 0.5);
+        }
+    }
+    
+    const size_t target_triangles = target_index_count / 3;
+    const float error_limit = max_error * max_error; // Costs are squared distances
+    float reached = 0.0f;
+    
+    struct Collapse {
+        int from, to;
+        float cost;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> order;
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> adjacent;
+    std::vector<uint8_t> touched;
+    bool relaxed = false; // Last pass found nothing under its limit
+    
+    while (triangles.size() / 3 > target_triangles) {
+        const size_t triangle_count = triangles.size() / 3;
+        
+        // Candidates: both directions of every edge whose source may move,
+        // taken from the half-edge running from the lower index
+        collapses.clear();
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            const int a = triangles[i], b = triangles[i - i % 3 + (i % 3 + 1) % 3];
+            if (a > b) continue;
+            for (int direction = 0; direction < 2; ++direction) {
+                const int from = direction ? b : a, to = direction ? a : b;
+                if (locked[from]) continue;
+                Quadric q = quadrics[group[from]];
+                q.add(quadrics[group[to]]);
+                const Vector3 p = position(to);
+                const double cost = q.weight > 0.0 ? std::max(0.0, q.evaluate(p.x(), p.y(), p.z())) / q.weight : 0.0;
+                collapses.push_back({ from, to, static_cast<float>(cost) });
+            }
+        }
+        if (collapses.empty()) break;
+        order.resize(collapses.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+            const Collapse& a = collapses[x];
+            const Collapse& b = collapses[y];
+            if (a.cost != b.cost) return a.cost < b.cost;
+            return a.from != b.from ? a.from < b.from : a.to < b.to;
+        });
+        
+        // Each collapse removes about two triangles; leave the costlier half
+        // of what the goal would take for later passes, when costs are current
+        const size_t goal = (triangle_count - target_triangles + 1) / 2;
+        const float pass_limit = relaxed ? error_limit
+                               : std::min(error_limit, collapses[order[std::min(goal, order.size() - 1)]].cost * 1.5f);
+        
+        // Triangles around every vertex, as of the start of the pass
+        offsets.assign(vertex_count + 1, 0);
+        for (int v : triangles) ++offsets[v + 1];
+        for (size_t v = 0; v < vertex_count; ++v) offsets[v + 1] += offsets[v];
+        adjacent.resize(triangles.size());
+        {
+            std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < triangles.size(); ++i) {
+                adjacent[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+        
+        // Apply independent collapses: once a vertex takes part in one, its
+        // group is off limits until the next pass
+        touched.assign(vertex_count, 0);
+        size_t remaining = triangle_count;
+        size_t applied = 0;
+        for (uint32_t c : order) {
+            const Collapse& collapse = collapses[c];
+            if (collapse.cost > pass_limit || remaining <= target_triangles) break;
+            const int from = collapse.from, to = collapse.to;
+            if (touched[group[from]] || touched[group[to]]) continue;
+            
+            const Vector3 target = position(to);
+            bool flips = false;
+            for (size_t j = offsets[from]; j < offsets[from + 1] && !flips; ++j) {
+                const int* tri = &triangles[adjacent[j] * 3];
+                if (tri[0] < 0) continue; // Removed earlier this pass
+                if (group[tri[0]] == group[to] || group[tri[1]] == group[to] || group[tri[2]] == group[to]) continue;
+                Vector3 p[3], q[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = position(tri[k]);
+                    q[k] = tri[k] == from ? target : p[k];
+                }
+                const Vector3 before = (p[1] - p[0]).cross(p[2] - p[0]);
+                const Vector3 after = (q[1] - q[0]).cross(q[2] - q[0]);
+                // Also rejects turns past ~75 degrees, which fold slivers over their neighbours
+                flips = before.dot(after) <= 0.25f * before.length() * after.length();
+            }
+            if (flips) continue;
+            
+            for (size_t j = offsets[from]; j < offsets[from + 1]; ++j) {
+                int* tri = &triangles[adjacent[j] * 3];
+                if (tri[0] < 0) continue;
+                for (int k = 0; k < 3; ++k) {
+                    if (tri[k] == from) tri[k] = to;
+                }
+                if (degenerate(tri)) {
+                    tri[0] = tri[1] = tri[2] = -1;
+                    --remaining;
+                }
+            }
+            quadrics[group[to]].add(quadrics[group[from]]);
+            touched[group[from]] = touched[group[to]] = 1;
+            reached = std::max(reached, collapse.cost);
+            ++applied;
+        }
+        
+        triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [](int v) { return v < 0; }),
+                        triangles.end());
+        if (applied == 0) {
+            if (relaxed) break;
+            relaxed = true;
+        } else {
+            relaxed = false;
+        }
+    }
+    
+    std::copy(triangles.begin(), triangles.end(), out);
+    if (error) *error = std::sqrt(reached);
+    return triangles.size();
+}
+
+size_t build_meshlets(const int* indices, size_t index_count, const Vector3Stream& positions, size_t max_vertices,
+                      size_t max_triangles, int* out, uint32_t* first_triangle) {
+    const size_t triangles = index_count / 3;
+    const size_t vertex_count = positions.size();
+    max_vertices = std::max<size_t>(max_vertices, 3);
+    max_triangles = std::max<size_t>(max_triangles, 1);
+
+    // Triangles using each vertex; the first live[v] of them are not placed yet
+    std::vector<unsigned> live(vertex_count, 0);
+    for (size_t i = 0; i < triangles * 3; ++i) {
+        ++live[indices[i]];
+    }
+    std::vector<size_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacent(offsets.back());
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangles * 3; ++i) {
+            adjacent[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+    auto centroid = [&](size_t t) {
+        const int* tri = indices + t * 3;
+        return (positions.get(tri[0]) + positions.get(tri[1]) + positions.get(tri[2])) * (1.0f / 3.0f);
+    };
+
+    std::vector<uint8_t> placed(triangles, 0);
+    std::vector<uint32_t> owner(vertex_count, 0); // Meshlet number + 1 that last took the vertex
+    std::vector<int> members;
+    members.reserve(max_vertices);
+    size_t meshlets = 0, written = 0;
+    size_t seed = triangles;
+    size_t cursor = 0; // Input order fallback once no neighbour is left
+
+    while (written < triangles) {
+        if (seed == triangles) {
+            while (placed[cursor]) ++cursor;
+            seed = cursor;
+        }
+        first_triangle[meshlets] = static_cast<uint32_t>(written);
+        const uint32_t id = static_cast<uint32_t>(++meshlets);
+        members.clear();
+        Vector3 sum;
+        size_t count = 0;
+
+        for (size_t next = seed; next != triangles;) {
+            const int* tri = indices + next * 3;
+            std::copy(tri, tri + 3, out + written * 3);
+            placed[next] = 1;
+            ++written;
+            ++count;
+            for (int k = 0; k < 3; ++k) {
+                const int v = tri[k];
+                uint32_t* list = &adjacent[offsets[v]];
+                for (unsigned j = 0; j < live[v]; ++j) {
+                    if (list[j] == next) {
+                        std::swap(list[j], list[live[v] - 1]);
+                        --live[v];
+                        break;
+                    }
+                }
+                if (owner[v] != id) {
+                    owner[v] = id;
+                    members.push_back(v);
+                    sum = sum + positions.get(v);
+                }
+            }
+            if (count == max_triangles) break;
+
+            // Fewest new vertices, fewest triangles left on them, nearest the centroid, lowest index
+            const Vector3 center = sum * (1.0f / float(members.size()));
+            next = triangles;
+            int best_new = 4;
+            unsigned best_open = 0;
+            float best_distance = 0.0f;
+            for (int v : members) {
+                for (unsigned j = 0; j < live[v]; ++j) {
+                    const uint32_t t = adjacent[offsets[v] + j];
+                    const int* candidate = indices + size_t(t) * 3;
+                    int added = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        added += owner[candidate[k]] != id &&
+                                 std::find(candidate, candidate + k, candidate[k]) == candidate + k;
+                    }
+                    if (members.size() + added > max_vertices) continue;
+                    const unsigned open = live[candidate[0]] + live[candidate[1]] + live[candidate[2]];
+                    const float distance = (centroid(t) - center).length_squared();
+                    if (std::make_tuple(added, open, distance, t) < std::make_tuple(best_new, best_open, best_distance, next)) {
+                        next = t;
+                        best_new = added;
+                        best_open = open;
+                        best_distance = distance;
+                    }
+                }
+            }
+        }
+
+        // The next meshlet starts from the triangle left nearest this one
+        const Vector3 center = sum * (1.0f / float(members.size()));
+        seed = triangles;
+        float seed_distance = 0.0f;
+        for (int v : members) {
+            for (unsigned j = 0; j < live[v]; ++j) {
+                const uint32_t t = adjacent[offsets[v] + j];
+                const float distance = (centroid(t) - center).length_squared();
+                if (seed == triangles || distance < seed_distance || (distance == seed_distance && t < seed)) {
+                    seed = t;
+                    seed_distance = distance;
+                }
+            }
+        }
+    }
+    first_triangle[meshlets] = static_cast<uint32_t>(triangles);
+    return meshlets;
+}
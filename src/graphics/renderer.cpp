@@ -1,10 +1,116 @@
 #include "../../include/graphics/renderer.h"
+#include "../../include/math/kernels.h"
 #include <iostream>
+#include <algorithm>
+#include <cfloat>
 #include <cstring>
 
+// Shared with every MeshBuffers of the renderer: buffer objects of destroyed
+// meshes wait here for the thread that owns the GL context
+struct GpuContext {
+    std::mutex mutex;
+    std::vector<GLuint> released;
+};
+
+// Static vertex data as three packed xyz blocks (positions, normals, dimmed
+// back-face colors), triangle and outline edge index buffers, and a buffer for
+// the lit colors. The triangle buffer holds every level of detail back to
+// back. Headless renderers keep only the CPU-side members
+struct MeshBuffers {
+    GLuint vertex_buffer = 0;
+    GLuint color_buffer = 0;
+    GLuint index_buffer = 0;
+    GLuint edge_buffer = 0;
+    size_t vertex_count = 0;
+    GLsizei index_count = 0;
+    std::vector<GLsizei> lod_first; // Per level of detail, in indices; level 0 is index_count from 0
+    std::vector<GLsizei> lod_counts;
+    GLsizei edge_count = -1; // Outline edges uploaded on first use
+    GLuint silhouette_buffer = 0; // Per-draw silhouette edges, created on first use
+    uint64_t revision = 0; // Of the uploaded contents
+    uint64_t recorded_revision = 0; // Of the last draw recorded, on the calling thread
+    std::weak_ptr<GpuContext> context;
+    
+    // Transform-and-light results, shared by both passes and kept across frames
+    // until the mesh, the model transform or the light set changes
+    Vector3Stream world_positions;
+    Vector3Stream world_normals;
+    Vector3Stream lit_colors;
+    Vector3Stream dim_colors; // Headless back faces
+    Affine3 lit_model;
+    uint64_t lit_mesh_revision = 0;
+    uint64_t lit_lights_revision = 0;
+    
+    // Instanced draws: the triangle indices repeated instance_capacity times
+    // (at most one batch), copy k offset by k * vertex_count, and a stream
+    // buffer for the world-space vertices (GL only, created on first use)
+    std::vector<int> instance_indices;
+    size_t instance_capacity = 0;
+    GLuint instance_vertex_buffer = 0;
+    GLuint instance_index_buffer = 0;
+    
+    ~MeshBuffers() {
+        std::shared_ptr<GpuContext> owner = context.lock();
+        if (!owner || vertex_buffer == 0) return;
+        std::lock_guard<std::mutex> lock(owner->mutex);
+        for (GLuint buffer : {vertex_buffer, color_buffer, index_buffer, edge_buffer, silhouette_buffer,
+                              instance_vertex_buffer, instance_index_buffer}) {
+            if (buffer != 0) {
+                owner->released.push_back(buffer);
+            }
+        }
+    }
+};
+
+namespace {
+
+const float AMBIENT = 0.1f;
+const float BACK_FACE_DIM = 0.15f;
+const size_t CLUSTERED_LIGHTS = 32; // Below this, binning costs more than the per-mesh range cull
+// World-space vertices per instanced batch (at least one instance), which keeps
+// the five streams and the packed upload near 1.5 MB however many instances draw
+const size_t INSTANCE_BATCH_VERTICES = 16384;
+
+// Draw sort keys, most significant bits first: pass (3), cull mode (1; 0 for
+// back faces, 1 for lit front faces), mesh (24, order of first use within the
+// frame), view depth (24, front to back). The low 12 bits are unused
+const uint64_t PASS_FACES = 0;
+const uint64_t PASS_WIREFRAME = 1;
+const uint64_t PASS_LINES = 2;
+const uint32_t KEY_MESH_MAX = (1u << 24) - 1;
+const float KEY_DEPTH_MAX = 16777215.0f;
+
+uint64_t draw_key(uint64_t pass, uint64_t cull, uint32_t mesh, uint32_t depth) {
+    return pass << 61 | cull << 60 | static_cast<uint64_t>(mesh) << 36 | static_cast<uint64_t>(depth) << 12;
+}
+
+void pack_xyz(const Vector3Stream& stream, float scale, float* out) {
+    for (size_t i = 0; i < stream.size(); ++i) {
+        out[i * 3] = stream.x()[i] * scale;
+        out[i * 3 + 1] = stream.y()[i] * scale;
+        out[i * 3 + 2] = stream.z()[i] * scale;
+    }
+}
+
+const GLvoid* buffer_offset(size_t bytes) {
+    return reinterpret_cast<const GLvoid*>(bytes);
+}
+
+} // namespace
+
 Renderer::Renderer()
     : _width(0)
     , _height(0)
+    , _lights_revision(1)
+    , _lod_error_pixels(1.0f)
+    , _frames_in_flight(0)
+    , _recording(nullptr)
+    , _frames_pending(0)
+    , _stopping(false)
+    , _frame(nullptr)
+    , _viewport_width(0)
+    , _viewport_height(0)
+    , _clusters_lights_revision(0)
     , _display(nullptr)
     , _window(0)
     , _glx_context(nullptr)
@@ -18,10 +124,14 @@ Renderer::~Renderer() {
     shutdown();
 }
 
-bool Renderer::initialize(int width, int height, const char* title) {
+bool Renderer::initialize(int width, int height, const char* title, unsigned frames_in_flight) {
     _width = width;
     _height = height;
     
+    // The render thread presents through the same connection the events arrive on
+    if (frames_in_flight > 0) {
+        XInitThreads();
+    }
     _display = XOpenDisplay(nullptr);
     if (!_display) {
         std::cerr << "Failed to open X11 display. Make sure DISPLAY is set correctly." << std::endl;
@@ -100,15 +210,101 @@ bool Renderer::initialize(int width, int height, const char* title) {
         return false;
     }
     
+    _context_token = std::make_shared<GpuContext>();
     _initialized = true;
     std::cout << "Renderer initialized successfully for WSL/Linux" << std::endl;
     std::cout << "OpenGL Version: " << glGetString(GL_VERSION) << std::endl;
     std::cout << "OpenGL Vendor: " << glGetString(GL_VENDOR) << std::endl;
     std::cout << "OpenGL Renderer: " << glGetString(GL_RENDERER) << std::endl;
     
+    // The render thread makes the context current for itself
+    if (frames_in_flight > 0) {
+        glXMakeCurrent(_display, None, nullptr);
+    }
+    start_frames(frames_in_flight);
+    
+    return true;
+}
+
+bool Renderer::initialize_headless(int width, int height, unsigned threads, unsigned frames_in_flight) {
+    _width = width;
+    _height = height;
+    _software.reset(new SoftwareRasterizer(width, height, threads));
+    _context_token = std::make_shared<GpuContext>();
+    
+    _initialized = true;
+    std::cout << "Renderer initialized headless: " << width << "x" << height << " software rasterizer, "
+              << _software->threads() << " threads" << std::endl;
+    
+    start_frames(frames_in_flight);
     return true;
 }
 
+void Renderer::start_frames(unsigned frames_in_flight) {
+    _frames_in_flight = frames_in_flight;
+    _packets.clear();
+    for (unsigned i = 0; i < std::max(1u, frames_in_flight); ++i) {
+        _packets.emplace_back(new FramePacket());
+    }
+    _recording = nullptr;
+    if (frames_in_flight == 0) return;
+    
+    _free.reset(new SpscRing<FramePacket*>(frames_in_flight));
+    _submitted.reset(new SpscRing<FramePacket*>(frames_in_flight));
+    for (auto& packet : _packets) {
+        _free->try_push(packet.get());
+    }
+    _stopping = false;
+    _render_thread = std::thread(&Renderer::render_thread_main, this);
+}
+
+void Renderer::stop_render_thread() {
+    if (!_render_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    _render_thread.join();
+}
+
+void Renderer::render_thread_main() {
+    if (!_software) {
+        glXMakeCurrent(_display, _window, _glx_context);
+    }
+    
+    while (FramePacket* frame = wait_pop(*_submitted)) {
+        execute_frame(*frame);
+        push_and_wake(*_free, frame);
+        {
+            std::lock_guard<std::mutex> lock(_wake_mutex);
+            --_frames_pending;
+        }
+        _wake.notify_all();
+    }
+    
+    if (!_software) {
+        release_buffers();
+        glXMakeCurrent(_display, None, nullptr);
+    }
+}
+
+Renderer::FramePacket* Renderer::wait_pop(SpscRing<FramePacket*>& ring) {
+    FramePacket* packet = nullptr;
+    if (ring.try_pop(packet)) return packet;
+    
+    std::unique_lock<std::mutex> lock(_wake_mutex);
+    _wake.wait(lock, [&] { return ring.try_pop(packet) || _stopping; });
+    return packet;
+}
+
+void Renderer::push_and_wake(SpscRing<FramePacket*>& ring, FramePacket* packet) {
+    ring.try_push(packet); // Rings hold every packet, so this never fails
+    // Taking the mutex orders the push before a sleeper's last look at the ring
+    { std::lock_guard<std::mutex> lock(_wake_mutex); }
+    _wake.notify_all();
+}
+
 bool Renderer::setup_opengl() {
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
@@ -120,6 +316,8 @@ bool Renderer::setup_opengl() {
     glDisable(GL_BLEND);
     
     glViewport(0, 0, _width, _height);
+    _viewport_width = _width;
+    _viewport_height = _height;
     
     GLenum error = glGetError();
     if (error != GL_NO_ERROR) {
@@ -133,6 +331,11 @@ bool Renderer::setup_opengl() {
 void Renderer::shutdown() {
     if (!_initialized) return;
     
+    stop_render_thread();
+    _recording = nullptr;
+    _software.reset();
+    _context_token.reset();
+    
     if (_glx_context) {
         glXMakeCurrent(_display, None, nullptr);
         glXDestroyContext(_display, _glx_context);
@@ -164,133 +367,812 @@ void Renderer::shutdown() {
 }
 
 void Renderer::begin_frame() {
-    setup_matrices();
+    recording();
 }
 
 void Renderer::end_frame() {
-    swap_buffers();
+    FramePacket& frame = recording();
+    frame.camera = _camera;
+    frame.frustum = _frustum;
+    if (frame.lights_revision != _lights_revision) {
+        frame.lights = _lights;
+        frame.lights_revision = _lights_revision;
+    }
+    frame.width = _width;
+    frame.height = _height;
+    _frame_meshes.clear();
+    _recording = nullptr;
+    
+    if (_frames_in_flight == 0) {
+        execute_frame(frame);
+        return;
+    }
+    ++_frames_pending;
+    push_and_wake(*_submitted, &frame);
+}
+
+void Renderer::finish() {
+    if (_frames_in_flight == 0) return;
+    std::unique_lock<std::mutex> lock(_wake_mutex);
+    _wake.wait(lock, [this] { return _frames_pending == 0; });
+}
+
+Renderer::FramePacket& Renderer::recording() {
+    if (!_recording) {
+        _recording = _frames_in_flight == 0 ? _packets[0].get() : wait_pop(*_free);
+    }
+    return *_recording;
 }
 
 void Renderer::clear(const Vector3& color) {
-    glClearColor(color.x(), color.y(), color.z(), 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    FramePacket& frame = recording();
+    frame.cleared = true;
+    frame.clear_color = color;
 }
 
-void Renderer::draw_mesh(const Mesh& mesh, const Matrix4& model_matrix) {
-    const auto& vertices = mesh.vertices();
-    const auto& indices = mesh.indices();
+bool Renderer::is_visible(const Mesh& mesh, const Affine3& transform) const {
+    // Sphere first (cheapest), then the box, which is tighter for boxy meshes
+    return _frustum.intersects(mesh.bounding_sphere().transformed(transform)) &&
+           _frustum.intersects(mesh.bounds().transformed(transform));
+}
+
+void Renderer::draw_mesh(const Mesh& mesh, const Affine3& model_matrix) {
+    if (mesh.vertex_count() == 0 || mesh.indices().empty() || !is_visible(mesh, model_matrix)) return;
     
-    if (vertices.empty() || indices.empty()) return;
+    // Back faces (dimmed) and front faces (lit) sort into separate passes
+    const uint32_t id = mesh_key(mesh);
+    const uint32_t depth = depth_key(mesh, model_matrix);
+    DrawCommand command;
+    command.kind = DrawCommand::Faces;
+    command.mesh = &mesh;
+    command.transform = model_matrix;
+    command.lod = select_lod(mesh, model_matrix);
+    record(command, draw_key(PASS_FACES, 0, id, depth));
+    command.lit = true;
+    record(command, draw_key(PASS_FACES, 1, id, depth));
+}
+
+void Renderer::draw_mesh_instanced(const Mesh& mesh, const Matrix4* transforms, size_t count, const Vector3* colors) {
+    if (mesh.vertex_count() == 0 || mesh.indices().empty() || count == 0) return;
     
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
+    // Culled, transformed and lit as a whole when the command runs. Bounds are
+    // cached on first use, so take them here rather than on the drawing thread
+    mesh.bounding_sphere();
+    FramePacket& frame = recording();
+    DrawCommand command;
+    command.kind = DrawCommand::Instanced;
+    command.mesh = &mesh;
+    command.first_instance = frame.transforms.size();
+    command.instance_count = count;
+    command.tinted = colors != nullptr;
+    frame.transforms.insert(frame.transforms.end(), transforms, transforms + count);
+    if (colors) {
+        frame.colors.resize(command.first_instance);
+        frame.colors.insert(frame.colors.end(), colors, colors + count);
+    }
+    record(command, draw_key(PASS_FACES, 0, mesh_key(mesh), 0));
+}
+
+void Renderer::draw_wireframe_mesh(const Mesh& mesh, const Affine3& model_matrix) {
+    if (mesh.vertex_count() == 0 || mesh.indices().empty() || !is_visible(mesh, model_matrix)) return;
     
-    Matrix4 model_transposed = model_matrix.transpose();
-    glMultMatrixf(model_transposed.data());
+    // The software path draws the unique edges; build them on this thread (see draw_mesh_outline)
+    if (_software) {
+        mesh.adjacency();
+    }
+    DrawCommand command;
+    command.kind = DrawCommand::Wireframe;
+    command.mesh = &mesh;
+    command.transform = model_matrix;
+    command.color = Vector3(1.0f, 1.0f, 1.0f);
+    record(command, draw_key(PASS_WIREFRAME, 0, mesh_key(mesh), depth_key(mesh, model_matrix)));
+}
+
+void Renderer::draw_mesh_outline(const Mesh& mesh, const Affine3& transform, const Vector3& color, Outline mode) {
+    if (mesh.vertex_count() == 0 || mesh.indices().empty() || !is_visible(mesh, transform)) return;
     
-    // Pass 1: Draw back faces (the "inside" of the cube)
-    // We make them slightly darker for visual distinction.
-    glCullFace(GL_FRONT);
-    glBegin(GL_TRIANGLES);
-    for (size_t i = 0; i < indices.size(); ++i) {
-        const Vertex& vertex = vertices[indices[i]];
-        
-        Vector3 world_pos = model_matrix.transform_point(vertex.position);
-        Vector3 world_normal = model_matrix.transform_vector(vertex.normal).normalized();
-        // Render inside with a darker, ambient-only color
-        Vector3 inside_color = vertex.color * 0.15f;
-        
-        glColor3f(inside_color.x(), inside_color.y(), inside_color.z());
-        glNormal3f(world_normal.x(), world_normal.y(), world_normal.z());
-        glVertex3f(vertex.position.x(), vertex.position.y(), vertex.position.z());
+    // Adjacency is cached on first use, so build it here rather than on the drawing thread
+    mesh.adjacency();
+    DrawCommand command;
+    command.kind = DrawCommand::Outline;
+    command.silhouette = mode == Outline::Silhouette;
+    command.mesh = &mesh;
+    command.transform = transform;
+    command.color = color;
+    record(command, draw_key(PASS_LINES, 0, mesh_key(mesh), depth_key(mesh, transform)));
+}
+
+void Renderer::draw_line(const Vector3& start, const Vector3& end, const Vector3& color) {
+    // After every outline, in call order
+    DrawCommand command;
+    command.kind = DrawCommand::Line;
+    command.start = start;
+    command.end = end;
+    command.color = color;
+    record(command, draw_key(PASS_LINES, 1, KEY_MESH_MAX, 0));
+}
+
+void Renderer::record(const DrawCommand& command, uint64_t key) {
+    FramePacket& frame = recording();
+    frame.keys.push_back(key);
+    frame.order.push_back(static_cast<uint32_t>(frame.commands.size()));
+    frame.commands.push_back(command);
+    if (command.mesh) {
+        frame.commands.back().buffers = frame.buffers[frame_mesh(*command.mesh)].get();
     }
-    glEnd();
+}
+
+uint32_t Renderer::frame_mesh(const Mesh& mesh) {
+    auto entry = _frame_meshes.emplace(&mesh, static_cast<uint32_t>(_frame_meshes.size()));
+    if (!entry.second) return entry.first->second;
     
-    // Pass 2: Draw front faces (the "outside") with full lighting
-    glCullFace(GL_BACK);
-    glBegin(GL_TRIANGLES);
-    for (size_t i = 0; i < indices.size(); ++i) {
-        const Vertex& vertex = vertices[indices[i]];
+    // Fresh buffers unless the mesh's are this renderer's and, if the mesh
+    // changed since, no copy shares them (copies keep the old contents).
+    // Packets of finished frames no longer hold them
+    std::shared_ptr<MeshBuffers>& buffers = mesh.gpu_buffers();
+    if (!buffers || buffers->context.lock() != _context_token ||
+        (buffers->recorded_revision != mesh.revision() && buffers.use_count() > 1)) {
+        buffers = std::make_shared<MeshBuffers>();
+        buffers->context = _context_token;
+    }
+    buffers->recorded_revision = mesh.revision();
+    recording().buffers.push_back(buffers);
+    return entry.first->second;
+}
+
+uint32_t Renderer::mesh_key(const Mesh& mesh) {
+    return std::min(frame_mesh(mesh), KEY_MESH_MAX);
+}
+
+uint32_t Renderer::select_lod(const Mesh& mesh, const Affine3& transform) const {
+    const std::vector<MeshLod>& lods = mesh.lods();
+    if (lods.empty()) return 0;
+    
+    // Screen pixels per object-space unit at the nearest point of the bounds:
+    // the projection's y scale maps view units to half the viewport height
+    const BoundingSphere& local = mesh.bounding_sphere();
+    const BoundingSphere world = local.transformed(transform);
+    const Matrix4 projection = _camera.projection_matrix();
+    float pixels_per_unit = projection.data()[5] * _height * 0.5f;
+    if (local.radius > 0.0f) {
+        pixels_per_unit *= world.radius / local.radius;
+    }
+    if (projection.data()[15] == 0.0f) { // Perspective
+        const float depth = -_camera.view_matrix().transform_point(world.center).z() - world.radius;
+        pixels_per_unit /= std::max(depth, _camera.near_plane());
+    }
+    
+    // Coarsest level whose error stays under the threshold on screen
+    uint32_t level = 0;
+    for (size_t i = 0; i < lods.size() && lods[i].error * pixels_per_unit <= _lod_error_pixels; ++i) {
+        level = static_cast<uint32_t>(i + 1);
+    }
+    return level;
+}
+
+uint32_t Renderer::depth_key(const Mesh& mesh, const Affine3& transform) const {
+    // View depth of the bounding sphere's centre, linear between the clip planes
+    const Vector3 center = transform.transform_point(mesh.bounding_sphere().center);
+    const float depth = -_camera.view_matrix().transform_point(center).z();
+    const float t = (depth - _camera.near_plane()) / (_camera.far_plane() - _camera.near_plane());
+    return static_cast<uint32_t>(std::min(1.0f, std::max(0.0f, t)) * KEY_DEPTH_MAX);
+}
+
+bool Renderer::visible_meshlets(const DrawCommand& command, const Matrix4& view_projection) {
+    const Meshlets& meshlets = command.mesh->meshlets();
+    if (command.lod != 0 || meshlets.size() == 0) return false;
+    
+    // Planes and eye in object space. Facing is the sign of the face normal
+    // against the eye, which any affine map keeps unless it mirrors
+    const Frustum frustum(view_projection * command.transform.to_matrix());
+    const float* m = command.transform.data();
+    const float determinant = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) +
+                              m[2] * (m[4] * m[9] - m[5] * m[8]);
+    const bool perspective = _frame->camera.projection_matrix().data()[15] == 0.0f;
+    const Vector3 eye = command.transform.inverse().transform_point(_frame->camera.position());
+    const float eye_xyz[3] = {eye.x(), eye.y(), eye.z()};
+    
+    const size_t count = meshlets.size();
+    const Vector3Stream& centers = meshlets.centers;
+    const Vector3Stream& axes = meshlets.cone_axes;
+    _meshlet_passes.resize(count);
+    kernels::active().cull_meshlets(frustum.planes(), {centers.x(), centers.y(), centers.z()}, meshlets.radii.data(),
+                                    {axes.x(), axes.y(), axes.z()}, meshlets.cone_cutoffs.data(),
+                                    meshlets.front_apexes.data(), meshlets.back_apexes.data(), count,
+                                    perspective && determinant != 0.0f ? eye_xyz : nullptr, _meshlet_passes.data());
+    
+    // Lit faces turn towards the eye, so mirroring swaps the passes' bits
+    const uint8_t pass = (command.lit == (determinant >= 0.0f)) ? 1 : 2;
+    _meshlet_ranges.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (!(_meshlet_passes[i] & pass)) continue;
+        const uint32_t first = meshlets.first_triangle[i] * 3;
+        const uint32_t size = (meshlets.first_triangle[i + 1] - meshlets.first_triangle[i]) * 3;
+        if (!_meshlet_ranges.empty() && _meshlet_ranges[_meshlet_ranges.size() - 2] +
+                                        _meshlet_ranges.back() == first) {
+            _meshlet_ranges.back() += size;
+        } else {
+            _meshlet_ranges.push_back(first);
+            _meshlet_ranges.push_back(size);
+        }
+    }
+    return true;
+}
+
+void Renderer::execute_frame(FramePacket& frame) {
+    _frame = &frame;
+    _command_sorter.sort(frame.keys.data(), frame.order.data(), frame.keys.size());
+    
+    if (_software) {
+        if (frame.cleared) {
+            _software->clear(frame.clear_color);
+        }
+        execute_software();
+    } else {
+        release_buffers();
+        if (frame.width != _viewport_width || frame.height != _viewport_height) {
+            glViewport(0, 0, frame.width, frame.height);
+            _viewport_width = frame.width;
+            _viewport_height = frame.height;
+        }
+        setup_matrices();
+        if (frame.cleared) {
+            glClearColor(frame.clear_color.x(), frame.clear_color.y(), frame.clear_color.z(), 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        execute_opengl();
+    }
+    swap_buffers();
+    
+    frame.cleared = false;
+    frame.commands.clear();
+    frame.keys.clear();
+    frame.order.clear();
+    frame.transforms.clear();
+    frame.colors.clear();
+    frame.buffers.clear();
+    _frame = nullptr;
+}
+
+void Renderer::release_buffers() {
+    std::vector<GLuint> released;
+    {
+        std::lock_guard<std::mutex> lock(_context_token->mutex);
+        released.swap(_context_token->released);
+    }
+    if (!released.empty()) {
+        glDeleteBuffers(static_cast<GLsizei>(released.size()), released.data());
+    }
+}
+
+void Renderer::execute_software() {
+    const std::vector<DrawCommand>& commands = _frame->commands;
+    const Matrix4 view_projection = _frame->camera.view_projection_matrix();
+    
+    for (uint32_t index : _frame->order) {
+        const DrawCommand& command = commands[index];
+        switch (command.kind) {
+        case DrawCommand::Faces: {
+            const Mesh& mesh = *command.mesh;
+            const bool clustered = visible_meshlets(command, view_projection);
+            if (clustered && _meshlet_ranges.empty()) break;
+            MeshBuffers& buffers = mesh_buffers(command);
+            if (command.lit) {
+                update_lighting(mesh, command.transform, buffers);
+            }
+            Matrix4 mvp = view_projection * command.transform.to_matrix();
+            const std::vector<int>& indices = mesh.lod_indices(command.lod);
+            const Vector3Stream& colors = command.lit ? buffers.lit_colors : buffers.dim_colors;
+            const SoftwareRasterizer::Cull cull = command.lit ? SoftwareRasterizer::Cull::Back
+                                                              : SoftwareRasterizer::Cull::Front;
+            if (clustered) {
+                _software->draw_triangle_ranges(mvp, mesh.positions(), colors, indices.data(), _meshlet_ranges.data(),
+                                                _meshlet_ranges.size() / 2, cull);
+            } else {
+                _software->draw_triangles(mvp, mesh.positions(), colors, indices.data(), indices.size(), cull);
+            }
+            break;
+        }
+        case DrawCommand::Instanced:
+            execute_instanced(command);
+            break;
+        case DrawCommand::Wireframe:
+            draw_edges_software(*command.mesh, command.transform, command.mesh->adjacency().vertices, command.color);
+            break;
+        case DrawCommand::Outline:
+            if (command.silhouette) {
+                silhouette_edges(*command.mesh, command.transform, _silhouette_scratch);
+                draw_edges_software(*command.mesh, command.transform, _silhouette_scratch, command.color);
+            } else {
+                draw_edges_software(*command.mesh, command.transform, command.mesh->adjacency().feature_edges,
+                                    command.color);
+            }
+            break;
+        case DrawCommand::Line:
+            _software->draw_line(view_projection, command.start, command.end, command.color);
+            break;
+        }
+    }
+}
+
+void Renderer::execute_opengl() {
+    // GL state left behind by the previous command; runs of commands that share
+    // it skip the calls. Setup leaves GL_BACK culling, filled polygons and the
+    // view matrix on the modelview stack
+    const std::vector<DrawCommand>& commands = _frame->commands;
+    const std::vector<uint32_t>& order = _frame->order;
+    const Matrix4 view = _frame->camera.view_matrix();
+    const Matrix4 view_projection = _frame->camera.view_projection_matrix();
+    const MeshBuffers* bound = nullptr;
+    int binding = -1; // Faces: 0 back / 1 lit, 2 triangle edges, 3 outline edges, 4 silhouette edges
+    GLenum cull_face = GL_BACK;
+    bool wireframe = false;
+    bool model_loaded = false; // Modelview is view * loaded_model rather than view
+    Affine3 loaded_model;
+    
+    auto load_view = [&]() {
+        if (bound) {
+            unbind_vertex_arrays();
+            bound = nullptr;
+        }
+        if (model_loaded) {
+            glLoadMatrixf(view.transpose().data());
+            model_loaded = false;
+        }
+    };
+    
+    const size_t count = order.size();
+    for (size_t i = 0; i < count;) {
+        const DrawCommand& command = commands[order[i]];
+        
+        if (command.kind == DrawCommand::Line) {
+            // Consecutive lines share one glBegin / glEnd
+            load_view();
+            glBegin(GL_LINES);
+            for (; i < count && commands[order[i]].kind == DrawCommand::Line; ++i) {
+                const DrawCommand& line = commands[order[i]];
+                glColor3f(line.color.x(), line.color.y(), line.color.z());
+                glVertex3f(line.start.x(), line.start.y(), line.start.z());
+                glVertex3f(line.end.x(), line.end.y(), line.end.z());
+            }
+            glEnd();
+            continue;
+        }
+        ++i;
         
-        // Calculate lighting
-        Vector3 world_pos = model_matrix.transform_point(vertex.position);
-        Vector3 world_normal = model_matrix.transform_vector(vertex.normal).normalized();
-        Vector3 lit_color = calculate_lighting(world_pos, world_normal, vertex.color);
+        if (command.kind == DrawCommand::Instanced) {
+            load_view();
+            execute_instanced(command); // Ends on GL_BACK
+            cull_face = GL_BACK;
+            continue;
+        }
+        
+        const Mesh& mesh = *command.mesh;
+        const bool clustered = command.kind == DrawCommand::Faces && visible_meshlets(command, view_projection);
+        if (clustered && _meshlet_ranges.empty()) continue;
+        MeshBuffers& buffers = mesh_buffers(command);
+        if (command.kind == DrawCommand::Faces && command.lit && update_lighting(mesh, command.transform, buffers)) {
+            _color_scratch.resize(buffers.vertex_count * 3);
+            pack_xyz(buffers.lit_colors, 1.0f, _color_scratch.data());
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.color_buffer);
+            glBufferData(GL_ARRAY_BUFFER, _color_scratch.size() * sizeof(float), _color_scratch.data(), GL_DYNAMIC_DRAW);
+        }
+        
+        const bool silhouette = command.kind == DrawCommand::Outline && command.silhouette;
+        if (command.kind == DrawCommand::Outline) {
+            if (buffers.edge_count < 0) {
+                const std::vector<int>& edges = mesh.adjacency().feature_edges;
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.edge_buffer);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, edges.size() * sizeof(int), edges.data(), GL_STATIC_DRAW);
+                buffers.edge_count = static_cast<GLsizei>(edges.size());
+                binding = -1;
+            }
+            if (silhouette) {
+                silhouette_edges(mesh, command.transform, _silhouette_scratch);
+                if (buffers.silhouette_buffer == 0) {
+                    glGenBuffers(1, &buffers.silhouette_buffer);
+                }
+            }
+        }
         
-        glColor3f(lit_color.x(), lit_color.y(), lit_color.z());
-        glNormal3f(world_normal.x(), world_normal.y(), world_normal.z());
-        glVertex3f(vertex.position.x(), vertex.position.y(), vertex.position.z());
+        const int wanted = command.kind == DrawCommand::Faces ? (command.lit ? 1 : 0)
+                         : command.kind == DrawCommand::Wireframe ? 2 : (silhouette ? 4 : 3);
+        if (&buffers != bound || wanted != binding) {
+            if (&buffers != bound) {
+                bind_vertex_arrays(buffers);
+            }
+            if (command.kind == DrawCommand::Faces) {
+                // Back faces read the dimmed block of the static buffer
+                glEnableClientState(GL_COLOR_ARRAY);
+                glBindBuffer(GL_ARRAY_BUFFER, command.lit ? buffers.color_buffer : buffers.vertex_buffer);
+                glColorPointer(3, GL_FLOAT, 0, buffer_offset(command.lit ? 0 : buffers.vertex_count * 6 * sizeof(float)));
+            } else {
+                glDisableClientState(GL_COLOR_ARRAY);
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, silhouette ? buffers.silhouette_buffer
+                                                : command.kind == DrawCommand::Outline ? buffers.edge_buffer
+                                                : buffers.index_buffer);
+            bound = &buffers;
+            binding = wanted;
+        }
+        
+        const GLenum wanted_cull = command.kind == DrawCommand::Faces && !command.lit ? GL_FRONT : GL_BACK;
+        if (wanted_cull != cull_face) {
+            glCullFace(wanted_cull);
+            cull_face = wanted_cull;
+        }
+        if ((command.kind == DrawCommand::Wireframe) != wireframe) {
+            wireframe = !wireframe;
+            glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+        }
+        if (!model_loaded || std::memcmp(loaded_model.data(), command.transform.data(), 12 * sizeof(float)) != 0) {
+            glLoadMatrixf((view * command.transform.to_matrix()).transpose().data());
+            loaded_model = command.transform;
+            model_loaded = true;
+        }
+        
+        if (silhouette) {
+            glColor3f(command.color.x(), command.color.y(), command.color.z());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, _silhouette_scratch.size() * sizeof(int), _silhouette_scratch.data(),
+                         GL_STREAM_DRAW);
+            glDrawElements(GL_LINES, static_cast<GLsizei>(_silhouette_scratch.size()), GL_UNSIGNED_INT, buffer_offset(0));
+        } else if (command.kind == DrawCommand::Outline) {
+            glColor3f(command.color.x(), command.color.y(), command.color.z());
+            glDrawElements(GL_LINES, buffers.edge_count, GL_UNSIGNED_INT, buffer_offset(0));
+        } else if (command.kind == DrawCommand::Wireframe) {
+            glColor3f(command.color.x(), command.color.y(), command.color.z());
+            glDrawElements(GL_TRIANGLES, buffers.index_count, GL_UNSIGNED_INT, buffer_offset(0));
+        } else if (clustered) {
+            _multi_counts.clear();
+            _multi_offsets.clear();
+            for (size_t r = 0; r < _meshlet_ranges.size(); r += 2) {
+                _multi_offsets.push_back(buffer_offset(_meshlet_ranges[r] * sizeof(int)));
+                _multi_counts.push_back(static_cast<GLsizei>(_meshlet_ranges[r + 1]));
+            }
+            glMultiDrawElements(GL_TRIANGLES, _multi_counts.data(), GL_UNSIGNED_INT, _multi_offsets.data(),
+                                static_cast<GLsizei>(_multi_counts.size()));
+        } else {
+            glDrawElements(GL_TRIANGLES, buffers.lod_counts[command.lod], GL_UNSIGNED_INT,
+                           buffer_offset(buffers.lod_first[command.lod] * sizeof(int)));
+        }
     }
-    glEnd();
     
-    glPopMatrix();
+    load_view();
+    if (wireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+    if (cull_face != GL_BACK) {
+        glCullFace(GL_BACK);
+    }
 }
 
-void Renderer::draw_wireframe_mesh(const Mesh& mesh, const Matrix4& model_matrix) {
-    const auto& vertices = mesh.vertices();
+void Renderer::execute_instanced(const DrawCommand& command) {
+    const Mesh& mesh = *command.mesh;
     const auto& indices = mesh.indices();
+    const size_t vertex_count = mesh.vertex_count();
+    const size_t count = command.instance_count;
+    const Matrix4* transforms = _frame->transforms.data() + command.first_instance;
+    const Vector3* colors = command.tinted ? _frame->colors.data() + command.first_instance : nullptr;
     
-    if (vertices.empty() || indices.empty()) return;
+    // Cull every instance's bounding sphere in one batch
+    _instance_radii.resize(count);
+    _instance_visible.resize(count);
+    mesh.bounding_sphere().transformed(transforms, count, _instance_centers, _instance_radii.data());
+    _frame->frustum.cull(_instance_centers, _instance_radii.data(), _instance_visible.data());
     
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    
-    Matrix4 model_transposed = model_matrix.transpose();
-    glMultMatrixf(model_transposed.data());
+    size_t visible = 0;
+    for (size_t i = 0; i < count; ++i) {
+        visible += _instance_visible[i];
+    }
+    if (visible == 0) return;
     
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glColor3f(1.0f, 1.0f, 1.0f);
+    // Survivors go back to back in world space a batch at a time, so the
+    // working set is bounded by the batch size whatever the instance count
+    const size_t batch_size = std::max<size_t>(1, INSTANCE_BATCH_VERTICES / vertex_count);
+    const size_t largest = std::min(visible, batch_size);
     
-    glBegin(GL_TRIANGLES);
-    for (size_t i = 0; i < indices.size(); ++i) {
-        const Vertex& vertex = vertices[indices[i]];
-        glVertex3f(vertex.position.x(), vertex.position.y(), vertex.position.z());
+    // Index copies are offset by whole meshes, so a longer list serves any smaller batch
+    MeshBuffers& buffers = mesh_buffers(command);
+    bool grown = largest > buffers.instance_capacity;
+    if (grown) {
+        size_t capacity = std::min(batch_size, std::max(largest, buffers.instance_capacity * 2));
+        buffers.instance_indices.resize(capacity * indices.size());
+        for (size_t copy = 0; copy < capacity; ++copy) {
+            const int offset = static_cast<int>(copy * vertex_count);
+            int* out = buffers.instance_indices.data() + copy * indices.size();
+            for (size_t j = 0; j < indices.size(); ++j) {
+                out[j] = indices[j] + offset;
+            }
+        }
+        buffers.instance_capacity = capacity;
+    }
+    if (!_software) {
+        if (buffers.instance_vertex_buffer == 0) {
+            glGenBuffers(1, &buffers.instance_vertex_buffer);
+            glGenBuffers(1, &buffers.instance_index_buffer);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.instance_index_buffer);
+        if (grown) {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.instance_indices.size() * sizeof(int),
+                         buffers.instance_indices.data(), GL_STATIC_DRAW);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.instance_vertex_buffer);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
     }
-    glEnd();
     
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // The mesh's own streams are shared by every instance
+    const kernels::KernelTable& k = kernels::active();
+    const Vector3Stream& positions = mesh.positions();
+    const Vector3Stream& normals = mesh.normals();
+    const Vector3Stream& mesh_colors = mesh.colors();
+    size_t batch = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!_instance_visible[i]) continue;
+        
+        if (batch == 0) {
+            const size_t total = std::min(visible, batch_size) * vertex_count;
+            _instance_positions.resize(total);
+            _instance_normals.resize(total);
+            _instance_colors.resize(total);
+            _instance_dim_colors.resize(total);
+            _instance_lit_colors.resize(total);
+        }
+        const size_t base = batch * vertex_count;
+        const float* matrix = transforms[i].data();
+        k.transform_points_soa(matrix, {positions.x(), positions.y(), positions.z()},
+                               {_instance_positions.x() + base, _instance_positions.y() + base,
+                                _instance_positions.z() + base}, vertex_count);
+        k.transform_normals_soa(matrix, {normals.x(), normals.y(), normals.z()},
+                                {_instance_normals.x() + base, _instance_normals.y() + base,
+                                 _instance_normals.z() + base}, vertex_count);
+        
+        const Vector3 tint = colors ? colors[i] : Vector3(1.0f, 1.0f, 1.0f);
+        const float scale[3] = {tint.x(), tint.y(), tint.z()};
+        const float* in[3] = {mesh_colors.x(), mesh_colors.y(), mesh_colors.z()};
+        float* out[3] = {_instance_colors.x() + base, _instance_colors.y() + base, _instance_colors.z() + base};
+        float* dim[3] = {_instance_dim_colors.x() + base, _instance_dim_colors.y() + base,
+                         _instance_dim_colors.z() + base};
+        for (int c = 0; c < 3; ++c) {
+            for (size_t v = 0; v < vertex_count; ++v) {
+                out[c][v] = in[c][v] * scale[c];
+                dim[c][v] = out[c][v] * BACK_FACE_DIM;
+            }
+        }
+        
+        --visible;
+        if (++batch < batch_size && visible > 0) continue;
+        
+        // The batch is full or holds the last survivor
+        const size_t total = batch * vertex_count;
+        const size_t index_count = batch * indices.size();
+        batch = 0;
+        light_world_vertices(_instance_positions, _instance_normals, _instance_colors, total, _instance_lit_colors);
+        
+        if (_software) {
+            // Same two passes as draw_mesh, already in world space
+            Matrix4 view_projection = _frame->camera.view_projection_matrix();
+            _software->draw_triangles(view_projection, _instance_positions, _instance_dim_colors,
+                                      buffers.instance_indices.data(), index_count, SoftwareRasterizer::Cull::Front);
+            _software->draw_triangles(view_projection, _instance_positions, _instance_lit_colors,
+                                      buffers.instance_indices.data(), index_count, SoftwareRasterizer::Cull::Back);
+            continue;
+        }
+        
+        // Positions, back-face colors and lit colors as three packed xyz blocks
+        _color_scratch.resize(total * 9);
+        pack_xyz(_instance_positions, 1.0f, _color_scratch.data());
+        pack_xyz(_instance_dim_colors, 1.0f, _color_scratch.data() + total * 3);
+        pack_xyz(_instance_lit_colors, 1.0f, _color_scratch.data() + total * 6);
+        glBufferData(GL_ARRAY_BUFFER, _color_scratch.size() * sizeof(float), _color_scratch.data(), GL_STREAM_DRAW);
+        
+        glVertexPointer(3, GL_FLOAT, 0, buffer_offset(0));
+        const GLsizei draw_count = static_cast<GLsizei>(index_count);
+        
+        glColorPointer(3, GL_FLOAT, 0, buffer_offset(total * 3 * sizeof(float)));
+        glCullFace(GL_FRONT);
+        glDrawElements(GL_TRIANGLES, draw_count, GL_UNSIGNED_INT, buffer_offset(0));
+        
+        glColorPointer(3, GL_FLOAT, 0, buffer_offset(total * 6 * sizeof(float)));
+        glCullFace(GL_BACK);
+        glDrawElements(GL_TRIANGLES, draw_count, GL_UNSIGNED_INT, buffer_offset(0));
+    }
     
-    glPopMatrix();
+    if (!_software) {
+        unbind_vertex_arrays();
+    }
 }
 
-void Renderer::draw_mesh_outline(const Mesh& mesh, const Matrix4& transform, const Vector3& color) {
-    const auto& vertices = mesh.vertices();
-    const auto& indices = mesh.indices();
+MeshBuffers& Renderer::mesh_buffers(const DrawCommand& command) {
+    const Mesh& mesh = *command.mesh;
+    MeshBuffers* buffers = command.buffers;
+    if (buffers->revision == mesh.revision()) {
+        return *buffers;
+    }
+    
+    if (!_software && buffers->vertex_buffer == 0) {
+        glGenBuffers(1, &buffers->vertex_buffer);
+        glGenBuffers(1, &buffers->color_buffer);
+        glGenBuffers(1, &buffers->index_buffer);
+        glGenBuffers(1, &buffers->edge_buffer);
+    }
+    
+    const size_t count = mesh.vertex_count();
+    buffers->vertex_count = count;
+    buffers->revision = mesh.revision();
+    buffers->instance_capacity = 0;
+    
+    if (_software) {
+        buffers->dim_colors.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            buffers->dim_colors.set(i, mesh.color(i) * BACK_FACE_DIM);
+        }
+        return *buffers;
+    }
+    
+    std::vector<float> vertex_data(count * 9);
+    pack_xyz(mesh.positions(), 1.0f, vertex_data.data());
+    pack_xyz(mesh.normals(), 1.0f, vertex_data.data() + count * 3);
+    pack_xyz(mesh.colors(), BACK_FACE_DIM, vertex_data.data() + count * 6);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertex_data.size() * sizeof(float), vertex_data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers->color_buffer);
+    glBufferData(GL_ARRAY_BUFFER, count * 3 * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    std::vector<int> indices;
+    buffers->lod_first.clear();
+    buffers->lod_counts.clear();
+    for (size_t level = 0; level < mesh.lod_count(); ++level) {
+        const std::vector<int>& lod = mesh.lod_indices(level);
+        buffers->lod_first.push_back(static_cast<GLsizei>(indices.size()));
+        buffers->lod_counts.push_back(static_cast<GLsizei>(lod.size()));
+        indices.insert(indices.end(), lod.begin(), lod.end());
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(int), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    
+    buffers->index_count = buffers->lod_counts[0];
+    buffers->edge_count = -1;
+    return *buffers;
+}
 
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
+bool Renderer::update_lighting(const Mesh& mesh, const Affine3& model_matrix, MeshBuffers& buffers) {
+    if (buffers.lit_mesh_revision == mesh.revision() && buffers.lit_lights_revision == _frame->lights_revision &&
+        std::memcmp(buffers.lit_model.data(), model_matrix.data(), 12 * sizeof(float)) == 0) {
+        return false;
+    }
     
-    Matrix4 model_transposed = transform.transpose();
-    glMultMatrixf(model_transposed.data());
+    // Every unique vertex once, batched through the dispatched kernels
+    const size_t count = mesh.vertex_count();
+    Matrix4 model = model_matrix.to_matrix();
+    model.transform_points(mesh.positions(), buffers.world_positions);
+    model.transform_normals(mesh.normals(), buffers.world_normals);
+    const Vector3Stream& positions = buffers.world_positions;
+    const Vector3Stream& normals = buffers.world_normals;
+    const Vector3Stream& colors = mesh.colors();
+    buffers.lit_colors.resize(count);
     
-    glColor3f(color.x(), color.y(), color.z());
+    light_world_vertices(positions, normals, colors, count, buffers.lit_colors);
     
-    glBegin(GL_LINES);
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        const Vector3& v0 = vertices[indices[i]].position;
-        const Vector3& v1 = vertices[indices[i + 1]].position;
-        const Vector3& v2 = vertices[indices[i + 2]].position;
+    buffers.lit_model = model_matrix;
+    buffers.lit_mesh_revision = mesh.revision();
+    buffers.lit_lights_revision = _frame->lights_revision;
+    return true;
+}
 
-        glVertex3f(v0.x(), v0.y(), v0.z());
-        glVertex3f(v1.x(), v1.y(), v1.z());
-        
-        glVertex3f(v1.x(), v1.y(), v1.z());
-        glVertex3f(v2.x(), v2.y(), v2.z());
-        
-        glVertex3f(v2.x(), v2.y(), v2.z());
-        glVertex3f(v0.x(), v0.y(), v0.z());
+void Renderer::light_world_vertices(const Vector3Stream& positions, const Vector3Stream& normals,
+                                    const Vector3Stream& colors, size_t count, Vector3Stream& out) {
+    if (_frame->lights.size() < CLUSTERED_LIGHTS) {
+        light_in_range(positions, normals, colors, count, out);
+        return;
     }
-    glEnd();
     
-    glPopMatrix();
+    if (!_clusters) {
+        _clusters.reset(new LightClusters());
+    }
+    Matrix4 view_projection = _frame->camera.view_projection_matrix();
+    if (_clusters_lights_revision != _frame->lights_revision ||
+        std::memcmp(view_projection.data(), _clusters_view_projection.data(), 16 * sizeof(float)) != 0) {
+        _clusters->build(_frame->camera, _frame->lights);
+        _clusters_view_projection = view_projection;
+        _clusters_lights_revision = _frame->lights_revision;
+    }
+    _clusters->light_vertices({positions.x(), positions.y(), positions.z()},
+                              {normals.x(), normals.y(), normals.z()},
+                              {colors.x(), colors.y(), colors.z()}, count, AMBIENT,
+                              {out.x(), out.y(), out.z()});
 }
 
-void Renderer::draw_line(const Vector3& start, const Vector3& end, const Vector3& color) {
-    glColor3f(color.x(), color.y(), color.z());
-    glBegin(GL_LINES);
-    glVertex3f(start.x(), start.y(), start.z());
-    glVertex3f(end.x(), end.y(), end.z());
-    glEnd();
+void Renderer::light_in_range(const Vector3Stream& positions, const Vector3Stream& normals,
+                              const Vector3Stream& colors, size_t count, Vector3Stream& out) {
+    float bounds_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float bounds_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    const float* axes[3] = {positions.x(), positions.y(), positions.z()};
+    for (int axis = 0; axis < 3; ++axis) {
+        for (size_t i = 0; i < count; ++i) {
+            bounds_min[axis] = std::min(bounds_min[axis], axes[axis][i]);
+            bounds_max[axis] = std::max(bounds_max[axis], axes[axis][i]);
+        }
+    }
+    
+    // SoA blocks (x, y, z, r, g, b, intensity, 1 / range^2) of the lights in reach
+    const std::vector<Light>& scene_lights = _frame->lights;
+    const size_t capacity = scene_lights.size();
+    _light_soa.resize(capacity * 8);
+    size_t n = 0;
+    for (const Light& light : scene_lights) {
+        const float center[3] = {light.position.x(), light.position.y(), light.position.z()};
+        if (light.range > 0.0f) {
+            float distance_sq = 0.0f;
+            for (int axis = 0; axis < 3; ++axis) {
+                float d = std::max({bounds_min[axis] - center[axis], 0.0f, center[axis] - bounds_max[axis]});
+                distance_sq += d * d;
+            }
+            if (distance_sq >= light.range * light.range) continue;
+        }
+        const float values[8] = {center[0], center[1], center[2], light.color.x(), light.color.y(), light.color.z(),
+                                 light.intensity, light.range > 0.0f ? 1.0f / (light.range * light.range) : 0.0f};
+        for (int k = 0; k < 8; ++k) {
+            _light_soa[k * capacity + n] = values[k];
+        }
+        ++n;
+    }
+    const float* soa = _light_soa.data();
+    const kernels::LightArray lights = {soa, soa + capacity, soa + 2 * capacity, soa + 3 * capacity, soa + 4 * capacity,
+                                        soa + 5 * capacity, soa + 6 * capacity, soa + 7 * capacity, n};
+    
+    kernels::active().light_vertices({positions.x(), positions.y(), positions.z()},
+                                     {normals.x(), normals.y(), normals.z()},
+                                     {colors.x(), colors.y(), colors.z()}, count, lights, AMBIENT,
+                                     {out.x(), out.y(), out.z()});
+}
+
+void Renderer::bind_vertex_arrays(const MeshBuffers& buffers) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vertex_buffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, buffer_offset(0));
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, buffer_offset(buffers.vertex_count * 3 * sizeof(float)));
+}
+
+void Renderer::unbind_vertex_arrays() {
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Renderer::draw_edges_software(const Mesh& mesh, const Affine3& model_matrix, const std::vector<int>& edges,
+                                   const Vector3& color) {
+    Matrix4 mvp = _frame->camera.view_projection_matrix() * model_matrix.to_matrix();
+    
+    for (size_t i = 0; i + 1 < edges.size(); i += 2) {
+        _software->draw_line(mvp, mesh.position(edges[i]), mesh.position(edges[i + 1]), color);
+    }
+}
+
+void Renderer::silhouette_edges(const Mesh& mesh, const Affine3& model_matrix, std::vector<int>& out) {
+    const EdgeAdjacency& adjacency = mesh.adjacency();
+    const Vector3Stream& normals = adjacency.face_normals;
+    const Vector3 eye = model_matrix.inverse().transform_point(_frame->camera.position());
+    const float eye_xyz[3] = {eye.x(), eye.y(), eye.z()};
+    
+    // Which side of every face the eye is on, in object space
+    _silhouette_facing.resize(normals.size());
+    kernels::active().face_orientation({normals.x(), normals.y(), normals.z()}, adjacency.face_offsets.data(),
+                                       normals.size(), eye_xyz, _silhouette_facing.data());
+    
+    out.clear();
+    for (size_t e = 0; e < adjacency.edge_count(); ++e) {
+        const int f0 = adjacency.faces[e * 2], f1 = adjacency.faces[e * 2 + 1];
+        if (f1 < 0 || _silhouette_facing[f0] != _silhouette_facing[f1]) {
+            out.push_back(adjacency.vertices[e * 2]);
+            out.push_back(adjacency.vertices[e * 2 + 1]);
+        }
+    }
 }
 
 bool Renderer::should_close() const {
@@ -298,6 +1180,8 @@ bool Renderer::should_close() const {
 }
 
 void Renderer::poll_events() {
+    if (_software) return;
+    
     XEvent event;
     
     while (XPending(_display)) {
@@ -319,7 +1203,6 @@ void Renderer::poll_events() {
             if (event.xconfigure.width != _width || event.xconfigure.height != _height) {
                 _width = event.xconfigure.width;
                 _height = event.xconfigure.height;
-                glViewport(0, 0, _width, _height);
                 
                 Camera updated_camera = _camera;
                 updated_camera.set_perspective(
@@ -329,6 +1212,7 @@ void Renderer::poll_events() {
                     updated_camera.far_plane()
                 );
                 _camera = updated_camera;
+                _frustum = _camera.frustum();
             }
             break;
         }
@@ -336,36 +1220,21 @@ void Renderer::poll_events() {
 }
 
 void Renderer::swap_buffers() {
+    if (_software) {
+        _software->flush();
+        return;
+    }
     glXSwapBuffers(_display, _window);
 }
 
 void Renderer::setup_matrices() {
     glMatrixMode(GL_PROJECTION);
     // Transpose for OpenGL column-major format
-    Matrix4 proj_transposed = _camera.projection_matrix().transpose();
+    Matrix4 proj_transposed = _frame->camera.projection_matrix().transpose();
     glLoadMatrixf(proj_transposed.data());
     
     glMatrixMode(GL_MODELVIEW);
     // Transpose for OpenGL column-major format  
-    Matrix4 view_transposed = _camera.view_matrix().transpose();
+    Matrix4 view_transposed = _frame->camera.view_matrix().transpose();
     glLoadMatrixf(view_transposed.data());
 }
-
-Vector3 Renderer::calculate_lighting(const Vector3& position, const Vector3& normal, const Vector3& color) {
-    Vector3 final_color = color * 0.1f; // Ambient lighting
-    
-    for (const auto& light : _lights) {
-        Vector3 light_dir = (light.position - position).normalized();
-        float dot_product = std::max(0.0f, normal.dot(light_dir));
-        
-        Vector3 diffuse = light.color * (dot_product * light.intensity);
-        final_color = final_color + (color * diffuse);
-    }
-    
-    // Clamp to [0, 1]
-    final_color.set_x(std::min(1.0f, std::max(0.0f, final_color.x())));
-    final_color.set_y(std::min(1.0f, std::max(0.0f, final_color.y())));
-    final_color.set_z(std::min(1.0f, std::max(0.0f, final_color.z())));
-    
-    return final_color;
-} 
@@ -0,0 +1,398 @@
+#include "../../include/graphics/software_rasterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+
+namespace {
+
+const int TILE = kernels::RASTER_TILE_SIZE;
+const float LINE_DEPTH_BIAS = 1e-4f; // Lets edges drawn over their own faces win the depth test
+
+uint32_t pack_rgba8(float r, float g, float b) {
+    auto channel = [](float v) {
+        return static_cast<uint32_t>(std::lrint(std::min(1.0f, std::max(0.0f, v)) * 255.0f));
+    };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | 0xFF000000u;
+}
+
+// Plane through the three edge functions: sum of f_i * E_i / area
+void attribute_plane(const float (&edge)[3][3], float f0, float f1, float f2, float inv_area, float* plane) {
+    for (int k = 0; k < 3; ++k) {
+        plane[k] = (f0 * edge[0][k] + f1 * edge[1][k] + f2 * edge[2][k]) * inv_area;
+    }
+}
+
+// Clips the segment p + t * d, t in [t0, t1], to lo <= p + t * d <= hi (Liang-Barsky step)
+bool clip_axis(float p, float d, float lo, float hi, float& t0, float& t1) {
+    if (d == 0.0f) {
+        return p >= lo && p <= hi;
+    }
+    float ta = (lo - p) / d;
+    float tb = (hi - p) / d;
+    if (ta > tb) std::swap(ta, tb);
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+    return t0 <= t1;
+}
+
+} // namespace
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, unsigned threads)
+    : _width(std::max(1, width))
+    , _height(std::max(1, height))
+    , _clip_stamp(0)
+    , _pool(threads) {
+    _tiles_x = (_width + TILE - 1) / TILE;
+    _tiles_y = (_height + TILE - 1) / TILE;
+    
+    // Whole tiles in both directions, so full-register runs never leave the buffer
+    _stride = static_cast<size_t>(_tiles_x) * TILE;
+    _color.resize(_stride * _tiles_y * TILE);
+    _depth.resize(_stride * _tiles_y * TILE);
+    _bins.resize(static_cast<size_t>(_tiles_x) * _tiles_y);
+}
+
+void SoftwareRasterizer::clear(const Vector3& color, float depth) {
+    flush();
+    
+    const uint32_t rgba = pack_rgba8(color.x(), color.y(), color.z());
+    const size_t band = _stride * TILE;
+    _pool.parallel_for(_tiles_y, [&](size_t row) {
+        std::fill_n(_color.data() + row * band, band, rgba);
+        std::fill_n(_depth.data() + row * band, band, depth);
+    });
+}
+
+void SoftwareRasterizer::draw_triangles(const Matrix4& mvp, const Vector3Stream& positions, const Vector3Stream& colors,
+                                        const int* indices, size_t index_count, Cull cull) {
+    const size_t count = positions.size();
+    _clip.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        transform_vertex(mvp, positions, colors, i);
+    }
+    clip_triangles(indices, index_count, cull);
+}
+
+void SoftwareRasterizer::draw_triangle_ranges(const Matrix4& mvp, const Vector3Stream& positions,
+                                              const Vector3Stream& colors, const int* indices, const uint32_t* ranges,
+                                              size_t range_count, Cull cull) {
+    const size_t count = positions.size();
+    _clip.resize(count);
+    _clip_stamps.resize(count, 0);
+    if (++_clip_stamp == 0) {
+        std::fill(_clip_stamps.begin(), _clip_stamps.end(), 0u);
+        _clip_stamp = 1;
+    }
+    for (size_t r = 0; r < range_count; ++r) {
+        const int* first = indices + ranges[r * 2];
+        for (const int* i = first; i != first + ranges[r * 2 + 1]; ++i) {
+            if (_clip_stamps[*i] == _clip_stamp) continue;
+            _clip_stamps[*i] = _clip_stamp;
+            transform_vertex(mvp, positions, colors, *i);
+        }
+    }
+    for (size_t r = 0; r < range_count; ++r) {
+        clip_triangles(indices + ranges[r * 2], ranges[r * 2 + 1], cull);
+    }
+}
+
+void SoftwareRasterizer::transform_vertex(const Matrix4& mvp, const Vector3Stream& positions,
+                                          const Vector3Stream& colors, size_t i) {
+    const float* m = mvp.data();
+    const float x = positions.x()[i], y = positions.y()[i], z = positions.z()[i];
+    ClipVertex& v = _clip[i];
+    v.x = m[0] * x + m[1] * y + m[2] * z + m[3];
+    v.y = m[4] * x + m[5] * y + m[6] * z + m[7];
+    v.z = m[8] * x + m[9] * y + m[10] * z + m[11];
+    v.w = m[12] * x + m[13] * y + m[14] * z + m[15];
+    v.r = colors.x()[i];
+    v.g = colors.y()[i];
+    v.b = colors.z()[i];
+}
+
+void SoftwareRasterizer::clip_triangles(const int* indices, size_t index_count, Cull cull) {
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        const ClipVertex* in[3] = {&_clip[indices[i]], &_clip[indices[i + 1]], &_clip[indices[i + 2]]};
+        
+        // Trivial reject against each clip plane
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis) {
+            auto coord = [axis](const ClipVertex* v) { return axis == 0 ? v->x : (axis == 1 ? v->y : v->z); };
+            outside = (coord(in[0]) > in[0]->w && coord(in[1]) > in[1]->w && coord(in[2]) > in[2]->w) ||
+                      (coord(in[0]) < -in[0]->w && coord(in[1]) < -in[1]->w && coord(in[2]) < -in[2]->w);
+        }
+        if (outside) continue;
+        
+        if (in[0]->z >= -in[0]->w && in[1]->z >= -in[1]->w && in[2]->z >= -in[2]->w) {
+            setup_triangle(*in[0], *in[1], *in[2], cull);
+            continue;
+        }
+        
+        // Sutherland-Hodgman against the near plane z = -w; at most one extra vertex
+        ClipVertex polygon[4];
+        int vertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            const ClipVertex& a = *in[k];
+            const ClipVertex& b = *in[(k + 1) % 3];
+            float da = a.z + a.w;
+            float db = b.z + b.w;
+            if (da >= 0.0f) {
+                polygon[vertices++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                float t = da / (da - db);
+                ClipVertex& v = polygon[vertices++];
+                v.x = a.x + (b.x - a.x) * t;
+                v.y = a.y + (b.y - a.y) * t;
+                v.z = a.z + (b.z - a.z) * t;
+                v.w = a.w + (b.w - a.w) * t;
+                v.r = a.r + (b.r - a.r) * t;
+                v.g = a.g + (b.g - a.g) * t;
+                v.b = a.b + (b.b - a.b) * t;
+            }
+        }
+        for (int k = 1; k + 1 < vertices; ++k) {
+            setup_triangle(polygon[0], polygon[k], polygon[k + 1], cull);
+        }
+    }
+}
+
+void SoftwareRasterizer::setup_triangle(const ClipVertex& c0, const ClipVertex& c1, const ClipVertex& c2, Cull cull) {
+    struct Screen {
+        float x, y, z, inv_w, r, g, b;
+    } v[3];
+    const ClipVertex* clip[3] = {&c0, &c1, &c2};
+    for (int k = 0; k < 3; ++k) {
+        const ClipVertex& c = *clip[k];
+        float inv_w = 1.0f / c.w;
+        v[k].x = (c.x * inv_w + 1.0f) * 0.5f * _width;
+        v[k].y = (1.0f - c.y * inv_w) * 0.5f * _height;
+        v[k].z = c.z * inv_w * 0.5f + 0.5f;
+        v[k].inv_w = inv_w;
+        v[k].r = c.r * inv_w;
+        v[k].g = c.g * inv_w;
+        v[k].b = c.b * inv_w;
+    }
+    
+    // With y pointing down, counter-clockwise (front) faces have negative area
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (!(area != 0.0f)) return;
+    if ((cull == Cull::Back && area > 0.0f) || (cull == Cull::Front && area < 0.0f)) return;
+    if (area < 0.0f) {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+    
+    // Pixels whose centres fall inside the bounds, clamped to the viewport before
+    // converting so far-off vertices cannot overflow an int
+    const float w = static_cast<float>(_width), h = static_cast<float>(_height);
+    float min_x = std::min(w, std::max(0.0f, std::min({v[0].x, v[1].x, v[2].x})));
+    float max_x = std::min(w, std::max(0.0f, std::max({v[0].x, v[1].x, v[2].x})));
+    float min_y = std::min(h, std::max(0.0f, std::min({v[0].y, v[1].y, v[2].y})));
+    float max_y = std::min(h, std::max(0.0f, std::max({v[0].y, v[1].y, v[2].y})));
+    
+    kernels::RasterTriangle t;
+    t.min_x = static_cast<int>(std::ceil(min_x - 0.5f));
+    t.min_y = static_cast<int>(std::ceil(min_y - 0.5f));
+    t.max_x = std::min(_width - 1, static_cast<int>(std::floor(max_x - 0.5f)));
+    t.max_y = std::min(_height - 1, static_cast<int>(std::floor(max_y - 0.5f)));
+    if (t.min_x > t.max_x || t.min_y > t.max_y) return;
+    
+    // Planes are evaluated relative to the bounds' corner to keep magnitudes small
+    t.origin_x = static_cast<float>(t.min_x);
+    t.origin_y = static_cast<float>(t.min_y);
+    
+    // edge[k] is zero on the edge opposite vertex k and equals area at vertex k
+    for (int k = 0; k < 3; ++k) {
+        const Screen& a = v[(k + 1) % 3];
+        const Screen& b = v[(k + 2) % 3];
+        float ax = a.x - t.origin_x, ay = a.y - t.origin_y;
+        float bx = b.x - t.origin_x, by = b.y - t.origin_y;
+        float dy = a.y - b.y;
+        float dx = b.x - a.x;
+        t.edge[k][0] = dy;
+        t.edge[k][1] = dx;
+        t.edge[k][2] = ax * by - ay * bx;
+        
+        // Top-left rule: pixels exactly on a top or left edge belong to this triangle
+        bool top_left = dy > 0.0f || (dy == 0.0f && dx > 0.0f);
+        t.edge_bias[k] = top_left ? 0.0f : FLT_MIN;
+    }
+    
+    float inv_area = 1.0f / area;
+    attribute_plane(t.edge, v[0].z, v[1].z, v[2].z, inv_area, t.depth);
+    attribute_plane(t.edge, v[0].inv_w, v[1].inv_w, v[2].inv_w, inv_area, t.inv_w);
+    attribute_plane(t.edge, v[0].r, v[1].r, v[2].r, inv_area, t.color[0]);
+    attribute_plane(t.edge, v[0].g, v[1].g, v[2].g, inv_area, t.color[1]);
+    attribute_plane(t.edge, v[0].b, v[1].b, v[2].b, inv_area, t.color[2]);
+    
+    _triangles.push_back(t);
+    bin(static_cast<uint32_t>(_triangles.size() - 1), t.min_x, t.min_y, t.max_x, t.max_y);
+}
+
+void SoftwareRasterizer::draw_line(const Matrix4& mvp, const Vector3& start, const Vector3& end, const Vector3& color) {
+    const float* m = mvp.data();
+    float clip[2][4];
+    const Vector3* points[2] = {&start, &end};
+    for (int k = 0; k < 2; ++k) {
+        for (int row = 0; row < 4; ++row) {
+            const float* r = m + row * 4;
+            clip[k][row] = r[0] * points[k]->x() + r[1] * points[k]->y() + r[2] * points[k]->z() + r[3];
+        }
+    }
+    
+    // Near plane
+    float d0 = clip[0][2] + clip[0][3];
+    float d1 = clip[1][2] + clip[1][3];
+    if (d0 < 0.0f && d1 < 0.0f) return;
+    if ((d0 < 0.0f) != (d1 < 0.0f)) {
+        int behind = d0 < 0.0f ? 0 : 1;
+        float t = d0 / (d0 - d1);
+        for (int row = 0; row < 4; ++row) {
+            clip[behind][row] = clip[0][row] + (clip[1][row] - clip[0][row]) * t;
+        }
+    }
+    
+    float sx[2], sy[2], sz[2];
+    for (int k = 0; k < 2; ++k) {
+        float inv_w = 1.0f / clip[k][3];
+        sx[k] = (clip[k][0] * inv_w + 1.0f) * 0.5f * _width;
+        sy[k] = (1.0f - clip[k][1] * inv_w) * 0.5f * _height;
+        sz[k] = clip[k][2] * inv_w * 0.5f + 0.5f;
+    }
+    
+    // Clip to the viewport so the per-tile walk stays short
+    float t0 = 0.0f, t1 = 1.0f;
+    float dx = sx[1] - sx[0], dy = sy[1] - sy[0], dz = sz[1] - sz[0];
+    if (!clip_axis(sx[0], dx, 0.0f, static_cast<float>(_width), t0, t1) ||
+        !clip_axis(sy[0], dy, 0.0f, static_cast<float>(_height), t0, t1)) {
+        return;
+    }
+    
+    RasterLine line;
+    line.x0 = sx[0] + dx * t0;
+    line.y0 = sy[0] + dy * t0;
+    line.z0 = sz[0] + dz * t0;
+    line.x1 = sx[0] + dx * t1;
+    line.y1 = sy[0] + dy * t1;
+    line.z1 = sz[0] + dz * t1;
+    line.color = pack_rgba8(color.x(), color.y(), color.z());
+    
+    _lines.push_back(line);
+    bin(static_cast<uint32_t>(_lines.size() - 1) | LINE_BIT,
+        std::max(0, static_cast<int>(std::min(line.x0, line.x1))),
+        std::max(0, static_cast<int>(std::min(line.y0, line.y1))),
+        std::min(_width - 1, static_cast<int>(std::max(line.x0, line.x1))),
+        std::min(_height - 1, static_cast<int>(std::max(line.y0, line.y1))));
+}
+
+void SoftwareRasterizer::bin(uint32_t entry, int min_x, int min_y, int max_x, int max_y) {
+    for (int ty = min_y / TILE; ty <= max_y / TILE; ++ty) {
+        for (int tx = min_x / TILE; tx <= max_x / TILE; ++tx) {
+            _bins[static_cast<size_t>(ty) * _tiles_x + tx].push_back(entry);
+        }
+    }
+}
+
+void SoftwareRasterizer::flush() {
+    if (_triangles.empty() && _lines.empty()) return;
+    
+    _pool.parallel_for(_bins.size(), [this](size_t tile) { rasterize_tile(tile); });
+    
+    for (auto& bin : _bins) {
+        bin.clear();
+    }
+    _triangles.clear();
+    _lines.clear();
+}
+
+void SoftwareRasterizer::rasterize_tile(size_t tile_index) {
+    const std::vector<uint32_t>& bin = _bins[tile_index];
+    if (bin.empty()) return;
+    
+    kernels::RasterTile tile;
+    tile.color = _color.data();
+    tile.depth = _depth.data();
+    tile.stride = _stride;
+    tile.x0 = static_cast<int>(tile_index % _tiles_x) * TILE;
+    tile.y0 = static_cast<int>(tile_index / _tiles_x) * TILE;
+    tile.x1 = tile.x0 + TILE;
+    tile.y1 = std::min(tile.y0 + TILE, _height);
+    
+    // Runs of consecutive triangles go to the kernel in one call; lines keep their place in the order
+    const kernels::KernelTable& k = kernels::active();
+    size_t i = 0;
+    while (i < bin.size()) {
+        if (bin[i] & LINE_BIT) {
+            rasterize_line(_lines[bin[i] & ~LINE_BIT], tile);
+            ++i;
+            continue;
+        }
+        size_t run = i;
+        while (run < bin.size() && !(bin[run] & LINE_BIT)) {
+            ++run;
+        }
+        k.rasterize_triangles(_triangles.data(), bin.data() + i, run - i, tile);
+        i = run;
+    }
+}
+
+void SoftwareRasterizer::rasterize_line(const RasterLine& line, const kernels::RasterTile& tile) {
+    // DDA with one sample per pixel along the major axis; depth test is less-or-equal
+    float dx = line.x1 - line.x0;
+    float dy = line.y1 - line.y0;
+    int steps = std::max(1, static_cast<int>(std::ceil(std::max(std::fabs(dx), std::fabs(dy)))));
+    float inv_steps = 1.0f / steps;
+    for (int s = 0; s <= steps; ++s) {
+        float t = s * inv_steps;
+        int x = static_cast<int>(std::floor(line.x0 + dx * t));
+        int y = static_cast<int>(std::floor(line.y0 + dy * t));
+        if (x < tile.x0 || x >= tile.x1 || x >= _width || y < tile.y0 || y >= tile.y1) continue;
+        
+        size_t offset = static_cast<size_t>(y) * tile.stride + x;
+        float z = line.z0 + (line.z1 - line.z0) * t;
+        if (z <= tile.depth[offset] + LINE_DEPTH_BIAS) {
+            tile.depth[offset] = std::min(z, tile.depth[offset]);
+            tile.color[offset] = line.color;
+        }
+    }
+}
+
+bool SoftwareRasterizer::save_color(const char* path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    
+    file << "P7\nWIDTH " << _width << "\nHEIGHT " << _height
+         << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    std::vector<unsigned char> row(static_cast<size_t>(_width) * 4);
+    for (int y = 0; y < _height; ++y) {
+        const uint32_t* pixels = _color.data() + static_cast<size_t>(y) * _stride;
+        for (int x = 0; x < _width; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                row[x * 4 + c] = static_cast<unsigned char>(pixels[x] >> (8 * c));
+            }
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return static_cast<bool>(file);
+}
+
+bool SoftwareRasterizer::save_depth(const char* path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    
+    file << "P5\n" << _width << " " << _height << "\n65535\n";
+    std::vector<unsigned char> row(static_cast<size_t>(_width) * 2);
+    for (int y = 0; y < _height; ++y) {
+        const float* depth = _depth.data() + static_cast<size_t>(y) * _stride;
+        for (int x = 0; x < _width; ++x) {
+            float d = std::min(1.0f, std::max(0.0f, depth[x]));
+            auto value = static_cast<uint16_t>(std::lrint(d * 65535.0f));
+            row[x * 2] = static_cast<unsigned char>(value >> 8); // Big-endian
+            row[x * 2 + 1] = static_cast<unsigned char>(value);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return static_cast<bool>(file);
+}
@@ -1,18 +1,33 @@
 #include "../include/math/vector3.h"
 #include "../include/math/matrix4.h"
+#include "../include/math/affine3.h"
+#include "../include/math/transform_expr.h"
 #include "../include/graphics/renderer.h"
 #include "../include/graphics/mesh.h"
 #include "../include/graphics/camera.h"
+#include "../include/math/kernels.h"
 #include <iostream>
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 
-int main() {
+int main(int argc, char** argv) {
+    // --headless [frames]: software rasterizer, fixed 60 Hz timestep, last frame
+    // written to frame.pam / frame_depth.pgm
+    bool headless = argc > 1 && std::strcmp(argv[1], "--headless") == 0;
+    int headless_frames = headless && argc > 2 ? std::max(1, std::atoi(argv[2])) : 120;
+    
     std::cout << "3D Graphics Engine with SIMD Operations" << std::endl;
     std::cout << "========================================" << std::endl;
+    std::cout << "SIMD kernels: " << simd_level_name(kernels::active().level)
+              << " (host supports " << simd_level_name(kernels::supported_level()) << ")" << std::endl;
     
     Renderer renderer;
-    if (!renderer.initialize(1280, 720, "3D Engine - SIMD Demo")) {
+    bool initialized = headless ? renderer.initialize_headless(1280, 720)
+                                : renderer.initialize(1280, 720, "3D Engine - SIMD Demo");
+    if (!initialized) {
         std::cerr << "Failed to initialize renderer!" << std::endl;
         return -1;
     }
@@ -27,6 +42,9 @@ int main() {
     
     std::cout << "Created meshes:" << std::endl;
     std::cout << "  Cube: " << cube.vertex_count() << " vertices, " << cube.triangle_count() << " triangles" << std::endl;
+    MeshOptimization optimized = cube.optimize();
+    std::cout << "  Cube vertex cache: ACMR " << optimized.before.acmr << " -> " << optimized.after.acmr
+              << ", ATVR " << optimized.before.atvr << " -> " << optimized.after.atvr << std::endl;
     
     // Camera orbit parameters
     const float camera_distance = 7.0f;  // Distance from cube center
@@ -38,19 +56,24 @@ int main() {
     int frame_count = 0;
     
     std::cout << "\nStarting render loop..." << std::endl;
-    std::cout << "Controls: ESC to exit" << std::endl;
+    if (headless) {
+        std::cout << "Rendering " << headless_frames << " frames headless" << std::endl;
+    } else {
+        std::cout << "Controls: ESC to exit" << std::endl;
+    }
     std::cout << "Camera orbiting at half cube rotation speed..." << std::endl;
     
-    while (!renderer.should_close()) {
+    while (headless ? frame_count < headless_frames : !renderer.should_close()) {
         auto current_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(current_time - start_time);
         total_time = duration.count() / 1000000.0f;
+        float scene_time = headless ? frame_count / 60.0f : total_time;
         
         renderer.poll_events();
         renderer.begin_frame();
         renderer.clear(Vector3(0.1f, 0.2f, 0.3f));
 
-        float camera_rotation = total_time * 45.0f;  // 45 degrees per second
+        float camera_rotation = scene_time * 45.0f;  // 45 degrees per second
         float camera_rad = camera_rotation * M_PI / 180.0f;
         
         // Orbit on an angled circle (30 degrees tilt)
@@ -66,8 +89,8 @@ int main() {
         camera.look_at(look_target);
         renderer.set_camera(camera);
 
-        float cube_rotation = total_time * 90.0f;
-        Matrix4 cube_transform = Matrix4::rotation_y(cube_rotation * M_PI / 180.0f);
+        float cube_rotation = scene_time * 90.0f;
+        Affine3 cube_transform = transform::rotate_y(cube_rotation * M_PI / 180.0f);
         renderer.draw_mesh(cube, cube_transform);
         renderer.draw_mesh_outline(cube, cube_transform, Vector3(0, 0, 0));
 
@@ -86,6 +109,19 @@ int main() {
         }
     }
     
+    auto end_time = std::chrono::high_resolution_clock::now();
+    total_time = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() / 1000000.0f;
+    
+    if (headless) {
+        renderer.finish();
+        const SoftwareRasterizer* target = renderer.software_target();
+        if (target->save_color("frame.pam") && target->save_depth("frame_depth.pgm")) {
+            std::cout << "Wrote frame.pam and frame_depth.pgm" << std::endl;
+        } else {
+            std::cerr << "Failed to write the final frame" << std::endl;
+        }
+    }
+    
     std::cout << "\nShutting down..." << std::endl;
     std::cout << "Total frames rendered: " << frame_count << std::endl;
     std::cout << "Average FPS: " << static_cast<int>(frame_count / total_time) << std::endl;
@@ -0,0 +1,221 @@
+#include "../../include/math/affine3.h"
+#include "../../include/math/kernels.h"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+static_assert(sizeof(Affine3) == 12 * sizeof(float), "Affine3 arrays must be tightly packed");
+
+namespace {
+
+// Selects lane 3 (the translation column) of a row
+inline __m128 w_mask() {
+    return _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+}
+
+inline __m128 cross3(__m128 a, __m128 b) {
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    // (a * b.yzx - a.yzx * b).yzx
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// Row r of lhs times the 3 rows of rhs, plus lhs's translation
+inline __m128 compose_row(__m128 a, const __m128* b) {
+    __m128 x = _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 y = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2));
+    #ifdef __FMA__
+        __m128 row = _mm_fmadd_ps(x, b[0], _mm_and_ps(a, w_mask()));
+        row = _mm_fmadd_ps(y, b[1], row);
+        return _mm_fmadd_ps(z, b[2], row);
+    #else
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, b[0]), _mm_mul_ps(y, b[1])),
+                          _mm_add_ps(_mm_mul_ps(z, b[2]), _mm_and_ps(a, w_mask())));
+    #endif
+}
+
+} // namespace
+
+Affine3::Affine3() {
+    _rows[0] = _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f);
+    _rows[1] = _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f);
+    _rows[2] = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+}
+
+Affine3::Affine3(const float* data) {
+    _rows[0] = _mm_loadu_ps(&data[0]);
+    _rows[1] = _mm_loadu_ps(&data[4]);
+    _rows[2] = _mm_loadu_ps(&data[8]);
+}
+
+Affine3::Affine3(const __m128& row0, const __m128& row1, const __m128& row2) {
+    _rows[0] = row0;
+    _rows[1] = row1;
+    _rows[2] = row2;
+}
+
+Affine3::Affine3(const Matrix4& matrix) {
+    _rows[0] = matrix.rows()[0];
+    _rows[1] = matrix.rows()[1];
+    _rows[2] = matrix.rows()[2];
+}
+
+Affine3 Affine3::translation(const Vector3& translation) {
+    return Affine3(_mm_setr_ps(1.0f, 0.0f, 0.0f, translation.x()),
+                   _mm_setr_ps(0.0f, 1.0f, 0.0f, translation.y()),
+                   _mm_setr_ps(0.0f, 0.0f, 1.0f, translation.z()));
+}
+
+Affine3 Affine3::rotation_x(float angle) {
+    return Affine3(Matrix4::rotation_x(angle));
+}
+
+Affine3 Affine3::rotation_y(float angle) {
+    return Affine3(Matrix4::rotation_y(angle));
+}
+
+Affine3 Affine3::rotation_z(float angle) {
+    return Affine3(Matrix4::rotation_z(angle));
+}
+
+Affine3 Affine3::rotation(const Vector3& axis, float angle) {
+    return Affine3(Matrix4::rotation(axis, angle));
+}
+
+Affine3 Affine3::rotation(const Quaternion& rotation) {
+    return Affine3(rotation.to_matrix());
+}
+
+Affine3 Affine3::scale(const Vector3& scale) {
+    return Affine3(_mm_setr_ps(scale.x(), 0.0f, 0.0f, 0.0f),
+                   _mm_setr_ps(0.0f, scale.y(), 0.0f, 0.0f),
+                   _mm_setr_ps(0.0f, 0.0f, scale.z(), 0.0f));
+}
+
+Affine3 Affine3::scale(float uniform_scale) {
+    return scale(Vector3(uniform_scale, uniform_scale, uniform_scale));
+}
+
+Affine3 Affine3::trs(const Vector3& translation, const Quaternion& rotation, const Vector3& scale) {
+    // R * S scales the columns of R; the translation lands in column 3
+    Matrix4 r = rotation.to_matrix();
+    __m128 s = _mm_setr_ps(scale.x(), scale.y(), scale.z(), 0.0f);
+    __m128 t = translation.simd_data();
+    return Affine3(_mm_insert_ps(_mm_mul_ps(r.rows()[0], s), t, (0 << 6) | (3 << 4)),
+                   _mm_insert_ps(_mm_mul_ps(r.rows()[1], s), t, (1 << 6) | (3 << 4)),
+                   _mm_insert_ps(_mm_mul_ps(r.rows()[2], s), t, (2 << 6) | (3 << 4)));
+}
+
+Affine3 Affine3::operator*(const Affine3& other) const {
+    return Affine3(compose_row(_rows[0], other._rows), compose_row(_rows[1], other._rows),
+                   compose_row(_rows[2], other._rows));
+}
+
+Vector3 Affine3::transform_point(const Vector3& point) const {
+    __m128 p = _mm_set_ps(1.0f, point.z(), point.y(), point.x());
+
+    __m128 x = _mm_mul_ps(_rows[0], p);
+    __m128 y = _mm_mul_ps(_rows[1], p);
+    __m128 z = _mm_mul_ps(_rows[2], p);
+    __m128 w = _mm_setzero_ps();
+
+    // After the transpose, summing the rows yields the three row dot products
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    return Vector3(_mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w)));
+}
+
+Vector3 Affine3::transform_vector(const Vector3& vector) const {
+    __m128 v = _mm_set_ps(0.0f, vector.z(), vector.y(), vector.x());
+
+    __m128 x = _mm_mul_ps(_rows[0], v);
+    __m128 y = _mm_mul_ps(_rows[1], v);
+    __m128 z = _mm_mul_ps(_rows[2], v);
+    __m128 w = _mm_setzero_ps();
+
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    return Vector3(_mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w)));
+}
+
+// The kernels only read the top three rows of their matrix argument
+void Affine3::transform_points(const float* in, float* out, size_t count) const {
+    kernels::active().transform_points(_data, in, out, count);
+}
+
+void Affine3::transform_vectors(const float* in, float* out, size_t count) const {
+    kernels::active().transform_vectors(_data, in, out, count);
+}
+
+void Affine3::transform_normals(const float* in, float* out, size_t count) const {
+    kernels::active().transform_normals(_data, in, out, count);
+}
+
+Affine3 Affine3::inverse() const {
+    // For L with rows a, b, c: inv(L) has columns (b x c, c x a, a x b) / det
+    const __m128 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    __m128 a = _mm_and_ps(_rows[0], xyz_mask);
+    __m128 b = _mm_and_ps(_rows[1], xyz_mask);
+    __m128 c = _mm_and_ps(_rows[2], xyz_mask);
+
+    __m128 r0 = cross3(b, c);
+    __m128 r1 = cross3(c, a);
+    __m128 r2 = cross3(a, b);
+    float det = _mm_cvtss_f32(_mm_dp_ps(a, r0, 0x71));
+    if (std::abs(det) <= 1e-30f) {
+        return Affine3::identity();
+    }
+
+    __m128 r3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3); // Columns -> rows
+    __m128 inv_det = _mm_set1_ps(1.0f / det);
+    r0 = _mm_mul_ps(r0, inv_det);
+    r1 = _mm_mul_ps(r1, inv_det);
+    r2 = _mm_mul_ps(r2, inv_det);
+
+    // New translation = -inv(L) * t
+    __m128 t = _mm_setr_ps(_data[3], _data[7], _data[11], 0.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    return Affine3(_mm_insert_ps(r0, _mm_xor_ps(_mm_dp_ps(r0, t, 0x71), sign), (0 << 6) | (3 << 4)),
+                   _mm_insert_ps(r1, _mm_xor_ps(_mm_dp_ps(r1, t, 0x71), sign), (0 << 6) | (3 << 4)),
+                   _mm_insert_ps(r2, _mm_xor_ps(_mm_dp_ps(r2, t, 0x71), sign), (0 << 6) | (3 << 4)));
+}
+
+Matrix4 Affine3::to_matrix() const {
+    const float data[16] = {
+        _data[0], _data[1], _data[2],  _data[3],
+        _data[4], _data[5], _data[6],  _data[7],
+        _data[8], _data[9], _data[10], _data[11],
+        0.0f,     0.0f,     0.0f,      1.0f
+    };
+    return Matrix4(data);
+}
+
+void Affine3::multiply_batch(const Affine3& lhs, const Affine3* rhs, Affine3* out, size_t count) {
+    kernels::active().multiply_affines(lhs._data, 0, reinterpret_cast<const float*>(rhs),
+                                       reinterpret_cast<float*>(out), count);
+}
+
+void Affine3::multiply_batch(const Affine3* lhs, const Affine3* rhs, Affine3* out, size_t count) {
+    kernels::active().multiply_affines(reinterpret_cast<const float*>(lhs), 12, reinterpret_cast<const float*>(rhs),
+                                       reinterpret_cast<float*>(out), count);
+}
+
+void Affine3::compose_hierarchy(const Affine3* local, const int* parents, Affine3* world, size_t count) {
+    // Each node depends on its parent's result, so this stays a sequential walk
+    for (size_t i = 0; i < count; ++i) {
+        world[i] = parents[i] < 0 ? local[i] : world[parents[i]] * local[i];
+    }
+}
+
+void Affine3::print() const {
+    std::cout << std::fixed << std::setprecision(3);
+    for (int i = 0; i < 3; ++i) {
+        std::cout << "| ";
+        for (int j = 0; j < 4; ++j) {
+            std::cout << std::setw(8) << (*this)(i, j) << " ";
+        }
+        std::cout << "|" << std::endl;
+    }
+    std::cout << std::endl;
+}
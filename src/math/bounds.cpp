@@ -0,0 +1,91 @@
+#include "../../include/math/bounds.h"
+#include "../../include/math/kernels.h"
+#include <algorithm>
+#include <cmath>
+
+Aabb Aabb::transformed(const Affine3& transform) const {
+    // Arvo: the new half-extent along each axis is |row| . extent
+    const Vector3 c = transform.transform_point(center());
+    const Vector3 e = extent();
+    float out[3];
+    for (int row = 0; row < 3; ++row) {
+        out[row] = std::fabs(transform(row, 0)) * e.x() + std::fabs(transform(row, 1)) * e.y() +
+                   std::fabs(transform(row, 2)) * e.z();
+    }
+    const Vector3 half(out[0], out[1], out[2]);
+    return { c - half, c + half };
+}
+
+BoundingSphere BoundingSphere::transformed(const Affine3& transform) const {
+    float scale_sq = 0.0f;
+    for (int col = 0; col < 3; ++col) {
+        Vector3 axis(transform(0, col), transform(1, col), transform(2, col));
+        scale_sq = std::max(scale_sq, axis.length_squared());
+    }
+    return { transform.transform_point(center), radius * std::sqrt(scale_sq) };
+}
+
+void BoundingSphere::transformed(const Matrix4* transforms, size_t count, Vector3Stream& centers, float* radii) const {
+    const float sphere[4] = { center.x(), center.y(), center.z(), radius };
+    centers.resize(count);
+    if (count == 0) return;
+    kernels::active().transform_spheres(transforms[0].data(), count, sphere, { centers.x(), centers.y(), centers.z() },
+                                        radii);
+}
+
+Frustum::Frustum() {
+    for (int p = 0; p < 6; ++p) {
+        _planes[p * 4] = 0.0f;
+        _planes[p * 4 + 1] = 0.0f;
+        _planes[p * 4 + 2] = 0.0f;
+        _planes[p * 4 + 3] = 1.0f;
+    }
+}
+
+Frustum::Frustum(const Matrix4& view_projection) {
+    // Clip space is -w <= x, y, z <= w, so each plane is row 3 plus or minus row 0, 1 or 2
+    const float* m = view_projection.data();
+    for (int p = 0; p < 6; ++p) {
+        const float* row = m + (p / 2) * 4;
+        const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        float plane[4];
+        for (int k = 0; k < 4; ++k) {
+            plane[k] = m[12 + k] + sign * row[k];
+        }
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        float inv_length = length > 1e-12f ? 1.0f / length : 0.0f;
+        for (int k = 0; k < 4; ++k) {
+            _planes[p * 4 + k] = plane[k] * inv_length;
+        }
+    }
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    const Vector3& c = sphere.center;
+    for (int p = 0; p < 6; ++p) {
+        const float* plane = _planes + p * 4;
+        if (plane[0] * c.x() + plane[1] * c.y() + plane[2] * c.z() + plane[3] < -sphere.radius) return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const Aabb& box) const {
+    const Vector3 c = box.center();
+    const Vector3 e = box.extent();
+    for (int p = 0; p < 6; ++p) {
+        const float* plane = _planes + p * 4;
+        float distance = plane[0] * c.x() + plane[1] * c.y() + plane[2] * c.z() + plane[3];
+        float reach = std::fabs(plane[0]) * e.x() + std::fabs(plane[1]) * e.y() + std::fabs(plane[2]) * e.z();
+        if (distance + reach < 0.0f) return false;
+    }
+    return true;
+}
+
+void Frustum::cull(const Vector3Stream& centers, const float* radii, uint8_t* visible) const {
+    kernels::active().cull_spheres(_planes, { centers.x(), centers.y(), centers.z() }, radii, centers.size(), visible);
+}
+
+void Frustum::cull(const Vector3Stream& mins, const Vector3Stream& maxs, uint8_t* visible) const {
+    kernels::active().cull_aabbs(_planes, { mins.x(), mins.y(), mins.z() }, { maxs.x(), maxs.y(), maxs.z() },
+                                 mins.size(), visible);
+}
@@ -0,0 +1,63 @@
+#include "../../include/math/cpu_features.h"
+#include <cpuid.h>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+uint64_t read_xcr0() {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+} // namespace
+
+SimdLevel detect_simd_level() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+        return SimdLevel::Scalar;
+    }
+    
+    // AVX state must also be enabled by the OS, not just present in the CPU
+    bool avx = (ecx & bit_AVX) && (ecx & bit_OSXSAVE);
+    bool fma = ecx & bit_FMA;
+    if (!avx || !fma) {
+        return SimdLevel::SSE41;
+    }
+    
+    uint64_t xcr0 = read_xcr0();
+    bool ymm_state = (xcr0 & 0x06) == 0x06;  // SSE + AVX
+    bool zmm_state = (xcr0 & 0xE6) == 0xE6;  // + opmask, ZMM0-15 upper halves, ZMM16-31
+    if (!ymm_state || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2)) {
+        return SimdLevel::SSE41;
+    }
+    
+    const unsigned int avx512_bits = bit_AVX512F | bit_AVX512VL | bit_AVX512DQ | bit_AVX512BW;
+    if (zmm_state && (ebx & avx512_bits) == avx512_bits) {
+        return SimdLevel::AVX512;
+    }
+    
+    return SimdLevel::AVX2;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::SSE41:  return "sse4.1";
+    case SimdLevel::AVX2:   return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+bool parse_simd_level(const char* name, SimdLevel& level) {
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel candidate : levels) {
+        if (std::strcmp(name, simd_level_name(candidate)) == 0) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
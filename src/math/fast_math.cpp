@@ -0,0 +1,18 @@
+#include "../../include/math/fast_math.h"
+#include "../../include/math/kernels.h"
+
+void sincos_batch(const float* angles, float* sin_out, float* cos_out, size_t count) {
+    kernels::active().sincos(angles, sin_out, cos_out, count);
+}
+
+void tan_batch(const float* angles, float* out, size_t count) {
+    kernels::active().tan(angles, out, count);
+}
+
+void atan2_batch(const float* y, const float* x, float* out, size_t count) {
+    kernels::active().atan2(y, x, out, count);
+}
+
+void rsqrt_batch(const float* in, float* out, size_t count) {
+    kernels::active().rsqrt(in, out, count);
+}
@@ -0,0 +1,108 @@
+#include "../../include/math/kernels.h"
+#include "kernels/kernel_tables.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace kernels {
+
+namespace {
+
+// Highest level compiled into this build, whatever the host supports
+const SimdLevel BUILD_LEVEL =
+#ifdef ENGINE_HAVE_AVX512
+    SimdLevel::AVX512;
+#else
+    SimdLevel::AVX2;
+#endif
+
+const KernelTable& table_for(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return scalar::table();
+    case SimdLevel::SSE41:  return sse41::table();
+    case SimdLevel::AVX2:   return avx2::table();
+    case SimdLevel::AVX512:
+#ifdef ENGINE_HAVE_AVX512
+        return avx512::table();
+#else
+        break;
+#endif
+    }
+    return avx2::table();
+}
+
+SimdLevel initial_level() {
+    SimdLevel level = supported_level();
+    
+    // ENGINE_SIMD can only lower the level, never enable unsupported instructions
+    if (const char* requested = std::getenv("ENGINE_SIMD")) {
+        SimdLevel forced;
+        if (!parse_simd_level(requested, forced)) {
+            std::cerr << "Ignoring unknown ENGINE_SIMD value: " << requested << std::endl;
+        } else if (forced > level) {
+            std::cerr << "ENGINE_SIMD=" << requested << " not supported on this host, using "
+                      << simd_level_name(level) << std::endl;
+        } else {
+            level = forced;
+        }
+    }
+    
+    return level;
+}
+
+std::atomic<const KernelTable*> g_active{nullptr};
+
+} // namespace
+
+uint32_t quantize_bits(float value, float inverse_cell) {
+    uint32_t bits;
+    if (inverse_cell > 0.0f) {
+        value = std::fmin(std::fmax(value * inverse_cell, -QUANTIZE_LIMIT), QUANTIZE_LIMIT);
+        bits = static_cast<uint32_t>(static_cast<int32_t>(std::lrint(value)));
+    } else {
+        value += 0.0f;
+        std::memcpy(&bits, &value, sizeof(bits));
+    }
+    return bits;
+}
+
+uint32_t hash_words(const uint32_t* words, size_t count) {
+    uint32_t hash = HASH_BASIS;
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ words[i]) * 16777619u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85EBCA6Bu;
+    hash = (hash ^ (hash >> 13)) * 0xC2B2AE35u;
+    return hash ^ (hash >> 16);
+}
+
+SimdLevel supported_level() {
+    static const SimdLevel level = [] {
+        SimdLevel detected = detect_simd_level();
+        return detected > BUILD_LEVEL ? BUILD_LEVEL : detected;
+    }();
+    return level;
+}
+
+const KernelTable& active() {
+    const KernelTable* table = g_active.load(std::memory_order_acquire);
+    if (!table) {
+        static const KernelTable& initial = table_for(initial_level());
+        const KernelTable* expected = nullptr;
+        g_active.compare_exchange_strong(expected, &initial, std::memory_order_acq_rel);
+        table = g_active.load(std::memory_order_acquire);
+    }
+    return *table;
+}
+
+bool set_level(SimdLevel level) {
+    if (level > supported_level()) {
+        return false;
+    }
+    g_active.store(&table_for(level), std::memory_order_release);
+    return true;
+}
+
+} // namespace kernels
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../../../include/math/kernels.h"
+
+// Entry points of the per-tier translation units in this directory
+namespace kernels {
+namespace scalar { const KernelTable& table(); }
+namespace sse41 { const KernelTable& table(); }
+namespace avx2 { const KernelTable& table(); }
+#ifdef ENGINE_HAVE_AVX512
+namespace avx512 { const KernelTable& table(); }
+#endif
+} // namespace kernels
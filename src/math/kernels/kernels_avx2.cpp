@@ -0,0 +1,6 @@
+// Built with -mavx2 -mfma (see CMakeLists.txt)
+#include "kernel_tables.h"
+
+#define KERNEL_NAMESPACE avx2
+#define KERNEL_LEVEL SimdLevel::AVX2
+#include "kernels_impl.h"
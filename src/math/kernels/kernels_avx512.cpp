@@ -0,0 +1,12 @@
+// Built with -mavx512f -mavx512vl -mavx512dq -mavx512bw (see CMakeLists.txt)
+#include "kernel_tables.h"
+
+// GCC 12's avx512fintrin.h self-initialises its "undefined" registers, which
+// trips -Wmaybe-uninitialized once the masked intrinsics are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#define KERNEL_NAMESPACE avx512
+#define KERNEL_LEVEL SimdLevel::AVX512
+#include "kernels_impl.h"
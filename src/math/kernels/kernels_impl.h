@@ -0,0 +1,1162 @@
+// Kernel bodies shared by every instruction-set tier. Each kernels_<tier>.cpp
+// defines KERNEL_NAMESPACE and KERNEL_LEVEL and includes this file once, so
+// every definition here lands in a namespace of its own and inline helpers
+// compiled for different ISAs can never be merged by the linker.
+//
+// Only include headers here that do not emit inline functions (intrinsics,
+// C headers, kernels.h) or that keep them in an ISA-tagged namespace
+// (simd_pack.h, vec3xn.h, simd_math.h); no <algorithm>, <cmath> or <vector>.
+
+#include "../../../include/math/kernels.h"
+#include "../../../include/math/vec3xn.h"
+#include "../../../include/math/simd_math.h"
+#include <immintrin.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(KERNEL_NAMESPACE) || !defined(KERNEL_LEVEL)
+    #error "Define KERNEL_NAMESPACE and KERNEL_LEVEL before including kernels_impl.h"
+#endif
+
+#if defined(KERNELS_SCALAR)
+    #define KERNEL_WIDTH 1
+#elif defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512DQ__)
+    #define KERNEL_WIDTH 16
+#elif defined(__AVX2__) && defined(__FMA__)
+    #define KERNEL_WIDTH 8
+#elif defined(__SSE4_1__)
+    #define KERNEL_WIDTH 4
+#else
+    #define KERNEL_WIDTH 1
+#endif
+
+namespace kernels {
+namespace KERNEL_NAMESPACE {
+namespace {
+
+// Register-width abstraction so every kernel below is written once
+#if KERNEL_WIDTH == 16
+using Pack = simd::Pack16;
+#elif KERNEL_WIDTH == 8
+using Pack = simd::Pack8;
+#elif KERNEL_WIDTH == 4
+using Pack = simd::Pack4;
+#endif
+
+#if KERNEL_WIDTH > 1
+using Vec = simd::Vec3xN<Pack>;
+
+// End of the range the SIMD loop covers: everything for masked packs,
+// whole registers otherwise
+inline size_t simd_end(size_t count) {
+    return Pack::masked ? count : count - count % Pack::width;
+}
+
+// Valid lanes in the block starting at i
+inline size_t block_lanes(size_t i, size_t end) {
+    return end - i < Pack::width ? end - i : Pack::width;
+}
+#endif
+
+inline float clamp01(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+inline float max0(float v) {
+    return v > 0.0f ? v : 0.0f;
+}
+
+// Scalar reference for one element; also the tail of every SIMD loop
+template <bool Translate, bool Normalize>
+inline void transform_one(const float* m, float& x, float& y, float& z) {
+    float rx = m[0] * x + m[1] * y + m[2] * z;
+    float ry = m[4] * x + m[5] * y + m[6] * z;
+    float rz = m[8] * x + m[9] * y + m[10] * z;
+    if (Translate) {
+        rx += m[3];
+        ry += m[7];
+        rz += m[11];
+    }
+    if (Normalize) {
+        float len = sqrtf(rx * rx + ry * ry + rz * rz);
+        float inv_len = len > 1e-8f ? 1.0f / len : 0.0f;
+        rx *= inv_len;
+        ry *= inv_len;
+        rz *= inv_len;
+    }
+    x = rx;
+    y = ry;
+    z = rz;
+}
+
+#if KERNEL_WIDTH > 1
+
+// Upper 3x4 block of the matrix broadcast once for a whole batch
+template <bool Translate, bool Normalize>
+struct PackTransform {
+    using V = Pack::V;
+    V m00, m01, m02, m03;
+    V m10, m11, m12, m13;
+    V m20, m21, m22, m23;
+
+    explicit PackTransform(const float* m) {
+        m00 = Pack::set1(m[0]); m01 = Pack::set1(m[1]); m02 = Pack::set1(m[2]);  m03 = Pack::set1(Translate ? m[3] : 0.0f);
+        m10 = Pack::set1(m[4]); m11 = Pack::set1(m[5]); m12 = Pack::set1(m[6]);  m13 = Pack::set1(Translate ? m[7] : 0.0f);
+        m20 = Pack::set1(m[8]); m21 = Pack::set1(m[9]); m22 = Pack::set1(m[10]); m23 = Pack::set1(Translate ? m[11] : 0.0f);
+    }
+
+    Vec apply(const Vec& v) const {
+        Vec r(Pack::madd(m00, v.x, Pack::madd(m01, v.y, Pack::madd(m02, v.z, m03))),
+              Pack::madd(m10, v.x, Pack::madd(m11, v.y, Pack::madd(m12, v.z, m13))),
+              Pack::madd(m20, v.x, Pack::madd(m21, v.y, Pack::madd(m22, v.z, m23))));
+        return Normalize ? r.normalized() : r;
+    }
+};
+
+#endif
+
+template <bool Translate, bool Normalize>
+void transform_packed(const float* m, const float* in, float* out, size_t count) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    const PackTransform<Translate, Normalize> transform(m);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        transform.apply(Vec::load_packed(in + 3 * i, n)).store_packed(out + 3 * i, n);
+    }
+#endif
+    for (; i < count; ++i) {
+        float x = in[3 * i], y = in[3 * i + 1], z = in[3 * i + 2];
+        transform_one<Translate, Normalize>(m, x, y, z);
+        out[3 * i] = x;
+        out[3 * i + 1] = y;
+        out[3 * i + 2] = z;
+    }
+}
+
+template <bool Translate, bool Normalize>
+void transform_soa(const float* m, Streams in, MutableStreams out, size_t count) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    const PackTransform<Translate, Normalize> transform(m);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        transform.apply(Vec::load(in.x + i, in.y + i, in.z + i, n)).store(out.x + i, out.y + i, out.z + i, n);
+    }
+#endif
+    for (; i < count; ++i) {
+        float x = in.x[i], y = in.y[i], z = in.z[i];
+        transform_one<Translate, Normalize>(m, x, y, z);
+        out.x[i] = x;
+        out.y[i] = y;
+        out.z[i] = z;
+    }
+}
+
+void transform_points(const float* m, const float* in, float* out, size_t count) {
+    transform_packed<true, false>(m, in, out, count);
+}
+
+void transform_vectors(const float* m, const float* in, float* out, size_t count) {
+    transform_packed<false, false>(m, in, out, count);
+}
+
+void transform_normals(const float* m, const float* in, float* out, size_t count) {
+    transform_packed<false, true>(m, in, out, count);
+}
+
+void transform_points_soa(const float* m, Streams in, MutableStreams out, size_t count) {
+    transform_soa<true, false>(m, in, out, count);
+}
+
+void transform_vectors_soa(const float* m, Streams in, MutableStreams out, size_t count) {
+    transform_soa<false, false>(m, in, out, count);
+}
+
+void transform_normals_soa(const float* m, Streams in, MutableStreams out, size_t count) {
+    transform_soa<false, true>(m, in, out, count);
+}
+
+#if KERNEL_WIDTH > 1
+// Lights the n vertices of the block starting at i
+inline void light_block(Streams positions, Streams normals, Streams colors, size_t i, size_t n, const LightArray& lights,
+                        float ambient, MutableStreams out) {
+    using V = Pack::V;
+    Vec position = Vec::load(positions.x + i, positions.y + i, positions.z + i, n);
+    Vec normal = Vec::load(normals.x + i, normals.y + i, normals.z + i, n);
+
+    // Light sum per channel; the vertex color is applied once at the end
+    Vec sum = Vec::broadcast(ambient, ambient, ambient);
+    for (size_t l = 0; l < lights.count; ++l) {
+        Vec to_light = Vec::broadcast(lights.x[l], lights.y[l], lights.z[l]) - position;
+        V distance_sq = to_light.length_squared();
+        V falloff = Pack::nmadd(distance_sq, Pack::set1(lights.inv_range_sq[l]), Pack::set1(1.0f));
+        auto in_range = Pack::greater(falloff, Pack::zero());
+        if (!Pack::any(in_range)) {
+            continue;
+        }
+        V inv_distance = Pack::mask(Pack::greater(distance_sq, Pack::set1(1e-16f)), simd::rsqrt<Pack>(distance_sq));
+        V n_dot_l = Pack::mul(normal.dot(to_light), inv_distance);
+        V weight = Pack::mul(Pack::mask(in_range, Pack::mul(falloff, falloff)), Pack::set1(lights.intensity[l]));
+        V diffuse = Pack::mul(Pack::max(n_dot_l, Pack::zero()), weight);
+        sum = Vec::madd(Vec::broadcast(lights.r[l], lights.g[l], lights.b[l]), diffuse, sum);
+    }
+
+    Vec color = Vec::load(colors.x + i, colors.y + i, colors.z + i, n) * sum;
+    color.clamped(0.0f, 1.0f).store(out.x + i, out.y + i, out.z + i, n);
+}
+#endif
+
+void light_vertices(Streams positions, Streams normals, Streams colors, size_t count,
+                    const LightArray& lights, float ambient, MutableStreams out) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        light_block(positions, normals, colors, i, block_lanes(i, end), lights, ambient, out);
+    }
+
+    // A partial last block is lit through a zero-padded copy rather than the
+    // scalar loop, so a vertex comes out the same wherever it falls in a
+    // batch; clustered lighting relies on that
+    if (i < count) {
+        alignas(64) float in[9][Pack::width] = {};
+        alignas(64) float lit[3][Pack::width];
+        const float* sources[9] = { positions.x, positions.y, positions.z, normals.x, normals.y, normals.z,
+                                    colors.x, colors.y, colors.z };
+        float* targets[3] = { out.x, out.y, out.z };
+        const size_t n = count - i;
+        for (int c = 0; c < 9; ++c) {
+            memcpy(in[c], sources[c] + i, n * sizeof(float));
+        }
+        light_block({ in[0], in[1], in[2] }, { in[3], in[4], in[5] }, { in[6], in[7], in[8] }, 0, Pack::width, lights,
+                    ambient, { lit[0], lit[1], lit[2] });
+        for (int c = 0; c < 3; ++c) {
+            memcpy(targets[c] + i, lit[c], n * sizeof(float));
+        }
+        i = count;
+    }
+#endif
+    for (; i < count; ++i) {
+        float sum_r = ambient, sum_g = ambient, sum_b = ambient;
+        for (size_t l = 0; l < lights.count; ++l) {
+            float dx = lights.x[l] - positions.x[i];
+            float dy = lights.y[l] - positions.y[i];
+            float dz = lights.z[l] - positions.z[i];
+            float distance_sq = dx * dx + dy * dy + dz * dz;
+            float falloff = 1.0f - distance_sq * lights.inv_range_sq[l];
+            if (falloff <= 0.0f) {
+                continue;
+            }
+            float inv_len = distance_sq > 1e-16f ? 1.0f / sqrtf(distance_sq) : 0.0f;
+            float n_dot_l = (normals.x[i] * dx + normals.y[i] * dy + normals.z[i] * dz) * inv_len;
+            float diffuse = max0(n_dot_l) * lights.intensity[l] * falloff * falloff;
+            sum_r += diffuse * lights.r[l];
+            sum_g += diffuse * lights.g[l];
+            sum_b += diffuse * lights.b[l];
+        }
+        out.x[i] = clamp01(colors.x[i] * sum_r);
+        out.y[i] = clamp01(colors.y[i] * sum_g);
+        out.z[i] = clamp01(colors.z[i] * sum_b);
+    }
+}
+
+const float PI = 3.14159265358979f;
+
+void face_normals(Streams positions, const int* indices, size_t triangle_count, bool normalize, MutableStreams faces,
+                  float* corner_angles) {
+    size_t t = 0;
+#if KERNEL_WIDTH > 1
+    using V = Pack::V;
+    constexpr size_t W = Pack::width;
+    // Transpose W triangles' corner indices so each corner can be gathered at once
+    int i0[W], i1[W], i2[W];
+    alignas(64) float angles[3][W];
+    const V pi = Pack::set1(PI);
+    const size_t end = simd_end(triangle_count);
+    for (; t < end; t += W) {
+        const size_t n = block_lanes(t, end);
+        for (size_t k = 0; k < n; ++k) {
+            i0[k] = indices[3 * (t + k)];
+            i1[k] = indices[3 * (t + k) + 1];
+            i2[k] = indices[3 * (t + k) + 2];
+        }
+        Vec p0 = Vec::gather(positions.x, positions.y, positions.z, i0, n);
+        Vec p1 = Vec::gather(positions.x, positions.y, positions.z, i1, n);
+        Vec e1 = p1 - p0;
+        Vec e2 = Vec::gather(positions.x, positions.y, positions.z, i2, n) - p0;
+        Vec face = e1.cross(e2);
+        const V cross_length = face.length();
+        (normalize ? face.normalized() : face).store(faces.x + t, faces.y + t, faces.z + t, n);
+        if (!corner_angles) continue;
+
+        // Both corners share |e1 x e2|; the third closes the sum to pi
+        V a0 = simd::atan2<Pack>(cross_length, e1.dot(e2));
+        V a1 = simd::atan2<Pack>(cross_length, (e2 - e1).dot(Vec::zero() - e1));
+        Pack::store(angles[0], a0, W);
+        Pack::store(angles[1], a1, W);
+        Pack::store(angles[2], Pack::max(Pack::sub(Pack::sub(pi, a0), a1), Pack::zero()), W);
+        for (size_t k = 0; k < n; ++k) {
+            corner_angles[3 * (t + k)] = angles[0][k];
+            corner_angles[3 * (t + k) + 1] = angles[1][k];
+            corner_angles[3 * (t + k) + 2] = angles[2][k];
+        }
+    }
+#endif
+    for (; t < triangle_count; ++t) {
+        const int* tri = indices + 3 * t;
+        float e1x = positions.x[tri[1]] - positions.x[tri[0]];
+        float e1y = positions.y[tri[1]] - positions.y[tri[0]];
+        float e1z = positions.z[tri[1]] - positions.z[tri[0]];
+        float e2x = positions.x[tri[2]] - positions.x[tri[0]];
+        float e2y = positions.y[tri[2]] - positions.y[tri[0]];
+        float e2z = positions.z[tri[2]] - positions.z[tri[0]];
+        float cx = e1y * e2z - e1z * e2y;
+        float cy = e1z * e2x - e1x * e2z;
+        float cz = e1x * e2y - e1y * e2x;
+        float len = sqrtf(cx * cx + cy * cy + cz * cz);
+        float scale = !normalize ? 1.0f : (len > 1e-8f ? 1.0f / len : 0.0f);
+        faces.x[t] = cx * scale;
+        faces.y[t] = cy * scale;
+        faces.z[t] = cz * scale;
+        if (corner_angles) {
+            float a0 = atan2f(len, e1x * e2x + e1y * e2y + e1z * e2z);
+            float a1 = atan2f(len, (e2x - e1x) * -e1x + (e2y - e1y) * -e1y + (e2z - e1z) * -e1z);
+            corner_angles[3 * t] = a0;
+            corner_angles[3 * t + 1] = a1;
+            corner_angles[3 * t + 2] = max0(PI - a0 - a1);
+        }
+    }
+}
+
+void gather_vertex_normals(Streams faces, const float* corner_weights, const uint32_t* offsets, const uint32_t* corners,
+                           size_t count, MutableStreams normals) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    // Corner lists differ in length from vertex to vertex, so the sums run
+    // per lane (in the same order as the scalar loop) and only the
+    // normalization is vectorized
+    constexpr size_t W = Pack::width;
+    alignas(64) float sum[3][W];
+    const size_t end = simd_end(count);
+    for (; i < end; i += W) {
+        const size_t n = block_lanes(i, end);
+        for (size_t k = 0; k < n; ++k) {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            for (uint32_t slot = offsets[i + k]; slot < offsets[i + k + 1]; ++slot) {
+                const uint32_t corner = corners[slot];
+                const float w = corner_weights ? corner_weights[corner] : 1.0f;
+                x += faces.x[corner / 3] * w;
+                y += faces.y[corner / 3] * w;
+                z += faces.z[corner / 3] * w;
+            }
+            sum[0][k] = x;
+            sum[1][k] = y;
+            sum[2][k] = z;
+        }
+        Vec::load(sum[0], sum[1], sum[2], n).normalized().store(normals.x + i, normals.y + i, normals.z + i, n);
+    }
+#endif
+    for (; i < count; ++i) {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        for (uint32_t slot = offsets[i]; slot < offsets[i + 1]; ++slot) {
+            const uint32_t corner = corners[slot];
+            const float w = corner_weights ? corner_weights[corner] : 1.0f;
+            x += faces.x[corner / 3] * w;
+            y += faces.y[corner / 3] * w;
+            z += faces.z[corner / 3] * w;
+        }
+        float len = sqrtf(x * x + y * y + z * z);
+        float inv_len = len > 1e-8f ? 1.0f / len : 0.0f;
+        normals.x[i] = x * inv_len;
+        normals.y[i] = y * inv_len;
+        normals.z[i] = z * inv_len;
+    }
+}
+
+void normalize(MutableStreams v, size_t count) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        Vec::load(v.x + i, v.y + i, v.z + i, n).normalized().store(v.x + i, v.y + i, v.z + i, n);
+    }
+#endif
+    for (; i < count; ++i) {
+        float len = sqrtf(v.x[i] * v.x[i] + v.y[i] * v.y[i] + v.z[i] * v.z[i]);
+        float inv_len = len > 1e-8f ? 1.0f / len : 0.0f;
+        v.x[i] *= inv_len;
+        v.y[i] *= inv_len;
+        v.z[i] *= inv_len;
+    }
+}
+
+// out[i] = lhs * rhs[i] for row-major 4x4 matrices (16 floats each); out may alias rhs
+void multiply_matrices(const float* lhs, const float* rhs, float* out, size_t count) {
+    size_t i = 0;
+#if KERNEL_WIDTH == 16
+    // One whole matrix per register: 128-bit lane group r accumulates output
+    // row r as sum_k lhs[r][k] * rhs row k, with rhs row k in all four groups
+    __m512 coeff[4];
+    for (int k = 0; k < 4; ++k) {
+        coeff[k] = _mm512_setr_ps(lhs[k], lhs[k], lhs[k], lhs[k],
+                                  lhs[4 + k], lhs[4 + k], lhs[4 + k], lhs[4 + k],
+                                  lhs[8 + k], lhs[8 + k], lhs[8 + k], lhs[8 + k],
+                                  lhs[12 + k], lhs[12 + k], lhs[12 + k], lhs[12 + k]);
+    }
+    // Broadcasting from memory keeps the shuffle port free
+    for (; i < count; ++i) {
+        const float* m = rhs + 16 * i;
+        __m512 r = _mm512_mul_ps(coeff[0], _mm512_broadcast_f32x4(_mm_loadu_ps(m)));
+        r = _mm512_fmadd_ps(coeff[1], _mm512_broadcast_f32x4(_mm_loadu_ps(m + 4)), r);
+        r = _mm512_fmadd_ps(coeff[2], _mm512_broadcast_f32x4(_mm_loadu_ps(m + 8)), r);
+        r = _mm512_fmadd_ps(coeff[3], _mm512_broadcast_f32x4(_mm_loadu_ps(m + 12)), r);
+        _mm512_storeu_ps(out + 16 * i, r);
+    }
+#elif KERNEL_WIDTH == 8
+    // Two output rows per register, rhs rows broadcast to both halves
+    __m256 coeff_01[4], coeff_23[4];
+    for (int k = 0; k < 4; ++k) {
+        coeff_01[k] = _mm256_setr_ps(lhs[k], lhs[k], lhs[k], lhs[k], lhs[4 + k], lhs[4 + k], lhs[4 + k], lhs[4 + k]);
+        coeff_23[k] = _mm256_setr_ps(lhs[8 + k], lhs[8 + k], lhs[8 + k], lhs[8 + k], lhs[12 + k], lhs[12 + k], lhs[12 + k], lhs[12 + k]);
+    }
+    for (; i < count; ++i) {
+        const float* m = rhs + 16 * i;
+        __m256 row0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m));
+        __m256 row1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 4));
+        __m256 row2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 8));
+        __m256 row3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 12));
+        __m256 r01 = _mm256_fmadd_ps(coeff_01[3], row3, _mm256_fmadd_ps(coeff_01[2], row2,
+                     _mm256_fmadd_ps(coeff_01[1], row1, _mm256_mul_ps(coeff_01[0], row0))));
+        __m256 r23 = _mm256_fmadd_ps(coeff_23[3], row3, _mm256_fmadd_ps(coeff_23[2], row2,
+                     _mm256_fmadd_ps(coeff_23[1], row1, _mm256_mul_ps(coeff_23[0], row0))));
+        _mm256_storeu_ps(out + 16 * i, r01);
+        _mm256_storeu_ps(out + 16 * i + 8, r23);
+    }
+#elif KERNEL_WIDTH == 4
+    __m128 coeff[16];
+    for (int e = 0; e < 16; ++e) {
+        coeff[e] = _mm_set1_ps(lhs[e]);
+    }
+    for (; i < count; ++i) {
+        const float* m = rhs + 16 * i;
+        __m128 row0 = _mm_loadu_ps(m), row1 = _mm_loadu_ps(m + 4), row2 = _mm_loadu_ps(m + 8), row3 = _mm_loadu_ps(m + 12);
+        for (int r = 0; r < 4; ++r) {
+            __m128 acc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(coeff[4 * r], row0), _mm_mul_ps(coeff[4 * r + 1], row1)),
+                                    _mm_add_ps(_mm_mul_ps(coeff[4 * r + 2], row2), _mm_mul_ps(coeff[4 * r + 3], row3)));
+            _mm_storeu_ps(out + 16 * i + 4 * r, acc);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        float m[16];
+        for (int e = 0; e < 16; ++e) {
+            m[e] = rhs[16 * i + e];
+        }
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                out[16 * i + 4 * r + c] = lhs[4 * r] * m[c] + lhs[4 * r + 1] * m[4 + c] +
+                                          lhs[4 * r + 2] * m[8 + c] + lhs[4 * r + 3] * m[12 + c];
+            }
+        }
+    }
+}
+
+void multiply_affines(const float* lhs, size_t lhs_stride, const float* rhs, float* out, size_t count) {
+    size_t i = 0;
+    // Output row r = sum_k lhs[r][k] * rhs row k + (0, 0, 0, lhs[r][3]); the
+    // per-row coefficients are broadcast in-lane, the rhs rows across lanes
+#if KERNEL_WIDTH == 16
+    const __mmask16 rows = 0x0FFF;
+    for (; i < count; ++i) {
+        const float* m = rhs + 12 * i;
+        __m512 l = _mm512_maskz_loadu_ps(rows, lhs + lhs_stride * i);
+        __m512 r = _mm512_maskz_mov_ps(0x8888, l);
+        r = _mm512_fmadd_ps(_mm512_permute_ps(l, 0x00), _mm512_broadcast_f32x4(_mm_loadu_ps(m)), r);
+        r = _mm512_fmadd_ps(_mm512_permute_ps(l, 0x55), _mm512_broadcast_f32x4(_mm_loadu_ps(m + 4)), r);
+        r = _mm512_fmadd_ps(_mm512_permute_ps(l, 0xAA), _mm512_broadcast_f32x4(_mm_loadu_ps(m + 8)), r);
+        _mm512_mask_storeu_ps(out + 12 * i, rows, r);
+    }
+#elif KERNEL_WIDTH == 8
+    const __m256 w_mask = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+    for (; i < count; ++i) {
+        const float* a = lhs + lhs_stride * i;
+        const float* m = rhs + 12 * i;
+        __m128 m0 = _mm_loadu_ps(m), m1 = _mm_loadu_ps(m + 4), m2 = _mm_loadu_ps(m + 8);
+        __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m));
+        __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 4));
+        __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 8));
+        __m256 l01 = _mm256_loadu_ps(a);
+        __m128 l2 = _mm_loadu_ps(a + 8);
+
+        __m256 r01 = _mm256_and_ps(l01, w_mask);
+        r01 = _mm256_fmadd_ps(_mm256_permute_ps(l01, 0x00), b0, r01);
+        r01 = _mm256_fmadd_ps(_mm256_permute_ps(l01, 0x55), b1, r01);
+        r01 = _mm256_fmadd_ps(_mm256_permute_ps(l01, 0xAA), b2, r01);
+        __m128 r2 = _mm_and_ps(l2, _mm256_castps256_ps128(w_mask));
+        r2 = _mm_fmadd_ps(_mm_permute_ps(l2, 0x00), m0, r2);
+        r2 = _mm_fmadd_ps(_mm_permute_ps(l2, 0x55), m1, r2);
+        r2 = _mm_fmadd_ps(_mm_permute_ps(l2, 0xAA), m2, r2);
+        _mm256_storeu_ps(out + 12 * i, r01);
+        _mm_storeu_ps(out + 12 * i + 8, r2);
+    }
+#elif KERNEL_WIDTH == 4
+    const __m128 w_mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    for (; i < count; ++i) {
+        const float* a = lhs + lhs_stride * i;
+        const float* m = rhs + 12 * i;
+        __m128 m0 = _mm_loadu_ps(m), m1 = _mm_loadu_ps(m + 4), m2 = _mm_loadu_ps(m + 8);
+        __m128 r[3];
+        for (int row = 0; row < 3; ++row) {
+            __m128 l = _mm_loadu_ps(a + 4 * row);
+            r[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(l, l, 0x00), m0),
+                                           _mm_mul_ps(_mm_shuffle_ps(l, l, 0x55), m1)),
+                                _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(l, l, 0xAA), m2), _mm_and_ps(l, w_mask)));
+        }
+        _mm_storeu_ps(out + 12 * i, r[0]);
+        _mm_storeu_ps(out + 12 * i + 4, r[1]);
+        _mm_storeu_ps(out + 12 * i + 8, r[2]);
+    }
+#endif
+    for (; i < count; ++i) {
+        float a[12], m[12];
+        for (int e = 0; e < 12; ++e) {
+            a[e] = lhs[lhs_stride * i + e];
+            m[e] = rhs[12 * i + e];
+        }
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                out[12 * i + 4 * r + c] = a[4 * r] * m[c] + a[4 * r + 1] * m[4 + c] + a[4 * r + 2] * m[8 + c] +
+                                          (c == 3 ? a[4 * r + 3] : 0.0f);
+            }
+        }
+    }
+}
+
+// Scalar references for one quaternion (xyzw); also the tails of the SIMD loops
+inline void multiply_quaternion(const float* a, const float* b, float* out) {
+    float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+    float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+    float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+    float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+    out[0] = x;
+    out[1] = y;
+    out[2] = z;
+    out[3] = w;
+}
+
+// Interpolation weights for a and the sign-corrected b; near-parallel pairs
+// fall back to linear weights (the result is normalized either way)
+inline void slerp_weights(float cos_theta, float t, bool spherical, float& wa, float& wb) {
+    if (!spherical || cos_theta > 0.9995f) {
+        wa = 1.0f - t;
+        wb = t;
+        return;
+    }
+    float theta = acosf(cos_theta);
+    float inv_sin = 1.0f / sinf(theta);
+    wa = sinf((1.0f - t) * theta) * inv_sin;
+    wb = sinf(t * theta) * inv_sin;
+}
+
+inline void interpolate_quaternion(const float* a, const float* b, float t, bool spherical, float* out) {
+    float d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    float sign = d < 0.0f ? -1.0f : 1.0f;
+    float wa, wb;
+    slerp_weights(d * sign, t, spherical, wa, wb);
+    wb *= sign;
+    float r[4];
+    for (int k = 0; k < 4; ++k) {
+        r[k] = a[k] * wa + b[k] * wb;
+    }
+    float len = sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+    float inv_len = len > 1e-8f ? 1.0f / len : 0.0f;
+    for (int k = 0; k < 4; ++k) {
+        out[k] = r[k] * inv_len;
+    }
+}
+
+#if KERNEL_WIDTH > 1
+
+// Pack::width quaternions as one register per component
+struct QuatPack {
+    using V = Pack::V;
+    V x, y, z, w;
+
+    static QuatPack load(const float* p, size_t n) {
+        QuatPack q;
+        Pack::load_xyzw(p, n, q.x, q.y, q.z, q.w);
+        return q;
+    }
+    void store(float* p, size_t n) const { Pack::store_xyzw(p, n, x, y, z, w); }
+
+    V dot(const QuatPack& o) const { return Pack::madd(x, o.x, Pack::madd(y, o.y, Pack::madd(z, o.z, Pack::mul(w, o.w)))); }
+};
+
+#endif
+
+void multiply_quaternions(const float* a, const float* b, float* out, size_t count) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        QuatPack p = QuatPack::load(a + 4 * i, n);
+        QuatPack q = QuatPack::load(b + 4 * i, n);
+        QuatPack r;
+        r.x = Pack::nmadd(p.z, q.y, Pack::madd(p.y, q.z, Pack::madd(p.x, q.w, Pack::mul(p.w, q.x))));
+        r.y = Pack::madd(p.z, q.x, Pack::madd(p.y, q.w, Pack::nmadd(p.x, q.z, Pack::mul(p.w, q.y))));
+        r.z = Pack::madd(p.z, q.w, Pack::nmadd(p.y, q.x, Pack::madd(p.x, q.y, Pack::mul(p.w, q.z))));
+        r.w = Pack::nmadd(p.z, q.z, Pack::nmadd(p.y, q.y, Pack::nmadd(p.x, q.x, Pack::mul(p.w, q.w))));
+        r.store(out + 4 * i, n);
+    }
+#endif
+    for (; i < count; ++i) {
+        multiply_quaternion(a + 4 * i, b + 4 * i, out + 4 * i);
+    }
+}
+
+template <bool Spherical>
+void interpolate_quaternions(const float* a, const float* b, const float* t, float* out, size_t count) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    using V = Pack::V;
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        QuatPack p = QuatPack::load(a + 4 * i, n);
+        QuatPack q = QuatPack::load(b + 4 * i, n);
+        V d = p.dot(q);
+        // Flip b where the pair is more than 90 degrees apart (shortest path)
+        V sign = Pack::select(Pack::greater(Pack::zero(), d), Pack::set1(-1.0f), Pack::set1(1.0f));
+        V weight_b = Pack::load(t + i, n);
+        V weight_a = Pack::sub(Pack::set1(1.0f), weight_b);
+        if (Spherical) {
+            // theta = acos(c) = atan2(sin_theta, c), and with one sincos of t * theta:
+            // sin((1 - t) theta) / sin_theta = cos(t theta) - c * sin(t theta) / sin_theta
+            V c = Pack::mul(d, sign);
+            V sin_theta = Pack::sqrt(Pack::max(Pack::nmadd(c, c, Pack::set1(1.0f)), Pack::zero()));
+            V theta = simd::atan2<Pack>(sin_theta, c);
+            V sin_t, cos_t;
+            simd::sincos<Pack>(Pack::mul(weight_b, theta), sin_t, cos_t);
+            V ratio = Pack::div(sin_t, sin_theta);
+            // Nearly parallel lanes keep the linear weights (sin_theta -> 0)
+            auto spherical = Pack::greater(Pack::set1(0.9995f), c);
+            weight_a = Pack::select(spherical, Pack::nmadd(c, ratio, cos_t), weight_a);
+            weight_b = Pack::select(spherical, ratio, weight_b);
+        }
+        weight_b = Pack::mul(weight_b, sign);
+
+        QuatPack r;
+        r.x = Pack::madd(q.x, weight_b, Pack::mul(p.x, weight_a));
+        r.y = Pack::madd(q.y, weight_b, Pack::mul(p.y, weight_a));
+        r.z = Pack::madd(q.z, weight_b, Pack::mul(p.z, weight_a));
+        r.w = Pack::madd(q.w, weight_b, Pack::mul(p.w, weight_a));
+        V inv_len = Pack::inv_length(r.dot(r));
+        r.x = Pack::mul(r.x, inv_len);
+        r.y = Pack::mul(r.y, inv_len);
+        r.z = Pack::mul(r.z, inv_len);
+        r.w = Pack::mul(r.w, inv_len);
+        r.store(out + 4 * i, n);
+    }
+#endif
+    for (; i < count; ++i) {
+        interpolate_quaternion(a + 4 * i, b + 4 * i, t[i], Spherical, out + 4 * i);
+    }
+}
+
+void nlerp_quaternions(const float* a, const float* b, const float* t, float* out, size_t count) {
+    interpolate_quaternions<false>(a, b, t, out, count);
+}
+
+void slerp_quaternions(const float* a, const float* b, const float* t, float* out, size_t count) {
+    interpolate_quaternions<true>(a, b, t, out, count);
+}
+
+// The element-wise math kernels finish narrow packs through a zero-padded
+// block, so every element of a call goes through the same approximation
+#if KERNEL_WIDTH > 1
+template <class Fn>
+void map_blocks(size_t count, Fn&& fn) {
+    const size_t end = simd_end(count);
+    size_t i = 0;
+    for (; i < end; i += Pack::width) {
+        fn(i, block_lanes(i, end));
+    }
+    if (i < count) {
+        fn(i, count - i);
+    }
+}
+
+// Load / store n lanes from p, padding partial non-masked blocks with zeros
+inline Pack::V load_lanes(const float* p, size_t n) {
+    if (Pack::masked || n == Pack::width) {
+        return Pack::load(p, n);
+    }
+    alignas(64) float padded[Pack::width] = {};
+    for (size_t k = 0; k < n; ++k) {
+        padded[k] = p[k];
+    }
+    return Pack::load(padded, Pack::width);
+}
+
+inline void store_lanes(float* p, Pack::V v, size_t n) {
+    if (Pack::masked || n == Pack::width) {
+        Pack::store(p, v, n);
+        return;
+    }
+    alignas(64) float padded[Pack::width];
+    Pack::store(padded, v, Pack::width);
+    for (size_t k = 0; k < n; ++k) {
+        p[k] = padded[k];
+    }
+}
+#endif
+
+void sincos(const float* angles, float* sin_out, float* cos_out, size_t count) {
+#if KERNEL_WIDTH > 1
+    map_blocks(count, [&](size_t i, size_t n) {
+        Pack::V s, c;
+        simd::sincos<Pack>(load_lanes(angles + i, n), s, c);
+        store_lanes(sin_out + i, s, n);
+        store_lanes(cos_out + i, c, n);
+    });
+#else
+    for (size_t i = 0; i < count; ++i) {
+        float a = angles[i];
+        sin_out[i] = sinf(a);
+        cos_out[i] = cosf(a);
+    }
+#endif
+}
+
+void tan(const float* angles, float* out, size_t count) {
+#if KERNEL_WIDTH > 1
+    map_blocks(count, [&](size_t i, size_t n) {
+        store_lanes(out + i, simd::tan<Pack>(load_lanes(angles + i, n)), n);
+    });
+#else
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = tanf(angles[i]);
+    }
+#endif
+}
+
+void atan2(const float* y, const float* x, float* out, size_t count) {
+#if KERNEL_WIDTH > 1
+    map_blocks(count, [&](size_t i, size_t n) {
+        store_lanes(out + i, simd::atan2<Pack>(load_lanes(y + i, n), load_lanes(x + i, n)), n);
+    });
+#else
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = atan2f(y[i], x[i]);
+    }
+#endif
+}
+
+void rsqrt(const float* in, float* out, size_t count) {
+#if KERNEL_WIDTH > 1
+    map_blocks(count, [&](size_t i, size_t n) {
+        store_lanes(out + i, simd::rsqrt<Pack>(load_lanes(in + i, n)), n);
+    });
+#else
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = 1.0f / sqrtf(in[i]);
+    }
+#endif
+}
+
+void transform_spheres(const float* matrices, size_t count, const float* sphere, MutableStreams centers, float* radii) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    // Matrix element k of W consecutive instances is one strided gather
+    using V = Pack::V;
+    alignas(64) int stride[Pack::width];
+    for (size_t k = 0; k < Pack::width; ++k) {
+        stride[k] = static_cast<int>(k * 16);
+    }
+    const V cx = Pack::set1(sphere[0]), cy = Pack::set1(sphere[1]), cz = Pack::set1(sphere[2]);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        const float* m = matrices + i * 16;
+        V out[3];
+        for (int row = 0; row < 3; ++row) {
+            V m0 = Pack::gather(m + row * 4, stride, n), m1 = Pack::gather(m + row * 4 + 1, stride, n);
+            V m2 = Pack::gather(m + row * 4 + 2, stride, n), m3 = Pack::gather(m + row * 4 + 3, stride, n);
+            out[row] = Pack::madd(m0, cx, Pack::madd(m1, cy, Pack::madd(m2, cz, m3)));
+        }
+        // Largest column length: gather the columns again rather than keep nine registers live
+        V scale_sq = Pack::zero();
+        for (int col = 0; col < 3; ++col) {
+            V a = Pack::gather(m + col, stride, n), b = Pack::gather(m + 4 + col, stride, n);
+            V c = Pack::gather(m + 8 + col, stride, n);
+            scale_sq = Pack::max(scale_sq, Pack::madd(a, a, Pack::madd(b, b, Pack::mul(c, c))));
+        }
+        Pack::store(centers.x + i, out[0], n);
+        Pack::store(centers.y + i, out[1], n);
+        Pack::store(centers.z + i, out[2], n);
+        Pack::store(radii + i, Pack::mul(Pack::set1(sphere[3]), Pack::sqrt(scale_sq)), n);
+    }
+#endif
+    for (; i < count; ++i) {
+        const float* m = matrices + i * 16;
+        float* out[3] = {centers.x + i, centers.y + i, centers.z + i};
+        float scale_sq = 0.0f;
+        for (int row = 0; row < 3; ++row) {
+            *out[row] = m[row * 4] * sphere[0] + m[row * 4 + 1] * sphere[1] + m[row * 4 + 2] * sphere[2] + m[row * 4 + 3];
+        }
+        for (int col = 0; col < 3; ++col) {
+            float length_sq = m[col] * m[col] + m[4 + col] * m[4 + col] + m[8 + col] * m[8 + col];
+            scale_sq = length_sq > scale_sq ? length_sq : scale_sq;
+        }
+        radii[i] = sphere[3] * sqrtf(scale_sq);
+    }
+}
+
+// Signed distance of a point to a plane plus the object's reach along its normal
+inline bool outside_plane(const float* plane, float x, float y, float z, float reach) {
+    return plane[0] * x + plane[1] * y + plane[2] * z + plane[3] + reach < 0.0f;
+}
+
+void cull_spheres(const float* planes, Streams centers, const float* radii, size_t count, uint8_t* visible) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    using V = Pack::V;
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        V x = Pack::load(centers.x + i, n), y = Pack::load(centers.y + i, n), z = Pack::load(centers.z + i, n);
+        V radius = Pack::load(radii + i, n);
+        auto inside = Pack::greater_equal(Pack::zero(), Pack::zero()); // All lanes
+        for (int p = 0; p < 6 && Pack::any(inside); ++p) {
+            const float* plane = planes + p * 4;
+            V distance = Pack::madd(Pack::set1(plane[0]), x, Pack::madd(Pack::set1(plane[1]), y,
+                                    Pack::madd(Pack::set1(plane[2]), z, Pack::set1(plane[3]))));
+            inside = Pack::mask_and(inside, Pack::greater_equal(Pack::add(distance, radius), Pack::zero()));
+        }
+        unsigned bits = Pack::bits(inside);
+        for (size_t k = 0; k < n; ++k) {
+            visible[i + k] = static_cast<uint8_t>((bits >> k) & 1u);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        uint8_t inside = 1;
+        for (int p = 0; p < 6 && inside; ++p) {
+            inside = !outside_plane(planes + p * 4, centers.x[i], centers.y[i], centers.z[i], radii[i]);
+        }
+        visible[i] = inside;
+    }
+}
+
+void cull_meshlets(const float* planes, Streams centers, const float* radii, Streams axes, const float* cutoffs,
+                   const float* front_apexes, const float* back_apexes, size_t count, const float* eye, uint8_t* passes) {
+    // With d = c - e, k = d . axis and apex = c - axis * t, the cone test
+    // (apex - e) . axis > cutoff * |apex - e| is k - t > cutoff * sqrt(d . d - 2tk + t^2)
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    const float* at = eye ? eye : origin;
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    using V = Pack::V;
+    const V ex = Pack::set1(at[0]), ey = Pack::set1(at[1]), ez = Pack::set1(at[2]);
+    const V two = Pack::set1(2.0f);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        V x = Pack::load(centers.x + i, n), y = Pack::load(centers.y + i, n), z = Pack::load(centers.z + i, n);
+        V radius = Pack::load(radii + i, n);
+        auto inside = Pack::greater_equal(Pack::zero(), Pack::zero());
+        for (int p = 0; p < 6 && Pack::any(inside); ++p) {
+            const float* plane = planes + p * 4;
+            V distance = Pack::madd(Pack::set1(plane[0]), x, Pack::madd(Pack::set1(plane[1]), y,
+                                    Pack::madd(Pack::set1(plane[2]), z, Pack::set1(plane[3]))));
+            inside = Pack::mask_and(inside, Pack::greater_equal(Pack::add(distance, radius), Pack::zero()));
+        }
+        const unsigned visible = Pack::bits(inside);
+        unsigned front = visible, back = visible;
+        if (eye && visible) {
+            V dx = Pack::sub(x, ex), dy = Pack::sub(y, ey), dz = Pack::sub(z, ez);
+            V k = Pack::madd(dx, Pack::load(axes.x + i, n), Pack::madd(dy, Pack::load(axes.y + i, n),
+                             Pack::mul(dz, Pack::load(axes.z + i, n))));
+            V length_sq = Pack::madd(dx, dx, Pack::madd(dy, dy, Pack::mul(dz, dz)));
+            V cutoff = Pack::load(cutoffs + i, n);
+            auto turned = [&](V t, V sign) {
+                V along = Pack::mul(sign, Pack::sub(k, t));
+                V apex_sq = Pack::max(Pack::madd(t, Pack::sub(t, Pack::mul(two, k)), length_sq), Pack::zero());
+                return Pack::bits(Pack::greater(along, Pack::mul(cutoff, Pack::sqrt(apex_sq))));
+            };
+            front &= ~turned(Pack::load(front_apexes + i, n), Pack::set1(1.0f));
+            back &= ~turned(Pack::load(back_apexes + i, n), Pack::set1(-1.0f));
+        }
+        for (size_t k = 0; k < n; ++k) {
+            passes[i + k] = static_cast<uint8_t>(((front >> k) & 1u) | (((back >> k) & 1u) << 1));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        uint8_t inside = 1;
+        for (int p = 0; p < 6 && inside; ++p) {
+            inside = !outside_plane(planes + p * 4, centers.x[i], centers.y[i], centers.z[i], radii[i]);
+        }
+        if (!inside || !eye) {
+            passes[i] = inside ? 3 : 0;
+            continue;
+        }
+        const float dx = centers.x[i] - at[0], dy = centers.y[i] - at[1], dz = centers.z[i] - at[2];
+        const float k = dx * axes.x[i] + dy * axes.y[i] + dz * axes.z[i];
+        const float length_sq = dx * dx + dy * dy + dz * dz;
+        auto turned = [&](float t, float sign) {
+            const float apex_sq = fmaxf(t * (t - 2.0f * k) + length_sq, 0.0f);
+            return sign * (k - t) > cutoffs[i] * sqrtf(apex_sq);
+        };
+        passes[i] = static_cast<uint8_t>((turned(front_apexes[i], 1.0f) ? 0 : 1) | (turned(back_apexes[i], -1.0f) ? 0 : 2));
+    }
+}
+
+void face_orientation(Streams normals, const float* offsets, size_t count, const float* eye, uint8_t* facing) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    using V = Pack::V;
+    const V ex = Pack::set1(eye[0]), ey = Pack::set1(eye[1]), ez = Pack::set1(eye[2]);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        V distance = Pack::madd(Pack::load(normals.x + i, n), ex, Pack::madd(Pack::load(normals.y + i, n), ey,
+                                Pack::madd(Pack::load(normals.z + i, n), ez, Pack::load(offsets + i, n))));
+        unsigned bits = Pack::bits(Pack::greater(distance, Pack::zero()));
+        for (size_t k = 0; k < n; ++k) {
+            facing[i + k] = static_cast<uint8_t>((bits >> k) & 1u);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        facing[i] = normals.x[i] * eye[0] + normals.y[i] * eye[1] + normals.z[i] * eye[2] + offsets[i] > 0.0f;
+    }
+}
+
+void hash_vertices(Streams positions, Streams normals, Streams colors, size_t count, const float* inverse_cells,
+                   uint32_t* hashes) {
+    const float* components[9] = { positions.x, positions.y, positions.z, normals.x, normals.y, normals.z,
+                                   colors.x, colors.y, colors.z };
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    using V = Pack::V;
+    float basis;
+    memcpy(&basis, &HASH_BASIS, sizeof(basis));
+    const V lo = Pack::set1(-QUANTIZE_LIMIT), hi = Pack::set1(QUANTIZE_LIMIT);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        V hash = Pack::set1(basis);
+        for (int c = 0; c < 9; ++c) {
+            if (!components[c]) continue;
+            const float inverse_cell = inverse_cells[c / 3];
+            V v = Pack::load(components[c] + i, n);
+            v = inverse_cell > 0.0f ? Pack::round_bits(Pack::min(Pack::max(Pack::mul(v, Pack::set1(inverse_cell)), lo), hi))
+                                    : Pack::add(v, Pack::zero());
+            hash = Pack::hash_combine(hash, v);
+        }
+        Pack::store(reinterpret_cast<float*>(hashes + i), Pack::hash_finish(hash), n);
+    }
+#endif
+    for (; i < count; ++i) {
+        uint32_t words[9];
+        size_t word_count = 0;
+        for (int c = 0; c < 9; ++c) {
+            if (components[c]) words[word_count++] = quantize_bits(components[c][i], inverse_cells[c / 3]);
+        }
+        hashes[i] = hash_words(words, word_count);
+    }
+}
+
+void cull_aabbs(const float* planes, Streams mins, Streams maxs, size_t count, uint8_t* visible) {
+    size_t i = 0;
+#if KERNEL_WIDTH > 1
+    // Centre / half-extent form: the box reaches |n| . extent along each plane normal
+    using V = Pack::V;
+    const V half = Pack::set1(0.5f);
+    const size_t end = simd_end(count);
+    for (; i < end; i += Pack::width) {
+        const size_t n = block_lanes(i, end);
+        V lo_x = Pack::load(mins.x + i, n), lo_y = Pack::load(mins.y + i, n), lo_z = Pack::load(mins.z + i, n);
+        V hi_x = Pack::load(maxs.x + i, n), hi_y = Pack::load(maxs.y + i, n), hi_z = Pack::load(maxs.z + i, n);
+        V cx = Pack::mul(Pack::add(lo_x, hi_x), half), ex = Pack::mul(Pack::sub(hi_x, lo_x), half);
+        V cy = Pack::mul(Pack::add(lo_y, hi_y), half), ey = Pack::mul(Pack::sub(hi_y, lo_y), half);
+        V cz = Pack::mul(Pack::add(lo_z, hi_z), half), ez = Pack::mul(Pack::sub(hi_z, lo_z), half);
+        auto inside = Pack::greater_equal(Pack::zero(), Pack::zero());
+        for (int p = 0; p < 6 && Pack::any(inside); ++p) {
+            const float* plane = planes + p * 4;
+            V distance = Pack::madd(Pack::set1(plane[0]), cx, Pack::madd(Pack::set1(plane[1]), cy,
+                                    Pack::madd(Pack::set1(plane[2]), cz, Pack::set1(plane[3]))));
+            V reach = Pack::madd(Pack::set1(fabsf(plane[0])), ex, Pack::madd(Pack::set1(fabsf(plane[1])), ey,
+                                 Pack::mul(Pack::set1(fabsf(plane[2])), ez)));
+            inside = Pack::mask_and(inside, Pack::greater_equal(Pack::add(distance, reach), Pack::zero()));
+        }
+        unsigned bits = Pack::bits(inside);
+        for (size_t k = 0; k < n; ++k) {
+            visible[i + k] = static_cast<uint8_t>((bits >> k) & 1u);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        float cx = (mins.x[i] + maxs.x[i]) * 0.5f, ex = (maxs.x[i] - mins.x[i]) * 0.5f;
+        float cy = (mins.y[i] + maxs.y[i]) * 0.5f, ey = (maxs.y[i] - mins.y[i]) * 0.5f;
+        float cz = (mins.z[i] + maxs.z[i]) * 0.5f, ez = (maxs.z[i] - mins.z[i]) * 0.5f;
+        uint8_t inside = 1;
+        for (int p = 0; p < 6 && inside; ++p) {
+            const float* plane = planes + p * 4;
+            float reach = fabsf(plane[0]) * ex + fabsf(plane[1]) * ey + fabsf(plane[2]) * ez;
+            inside = !outside_plane(plane, cx, cy, cz, reach);
+        }
+        visible[i] = inside;
+    }
+}
+
+inline void raster_row_range(const RasterTriangle& t, const RasterTile& tile, int& x0, int& x1, int& y0, int& y1) {
+    x0 = t.min_x > tile.x0 ? t.min_x : tile.x0;
+    x1 = t.max_x < tile.x1 - 1 ? t.max_x : tile.x1 - 1;
+    y0 = t.min_y > tile.y0 ? t.min_y : tile.y0;
+    y1 = t.max_y < tile.y1 - 1 ? t.max_y : tile.y1 - 1;
+}
+
+void rasterize_triangles(const RasterTriangle* triangles, const uint32_t* ids, size_t count, const RasterTile& tile) {
+#if KERNEL_WIDTH > 1
+    // Pack::width pixels of a row per step: edge, depth, 1 / w and color planes
+    // are one multiply-add each against the lane x coordinates
+    using V = Pack::V;
+    using M = Pack::M;
+    alignas(64) float lane_centres[Pack::width];
+    for (size_t k = 0; k < Pack::width; ++k) {
+        lane_centres[k] = static_cast<float>(k) + 0.5f;
+    }
+    const V lanes = Pack::load(lane_centres, Pack::width);
+    const V step = Pack::set1(static_cast<float>(Pack::width));
+    const int width = static_cast<int>(Pack::width);
+
+    for (size_t i = 0; i < count; ++i) {
+        const RasterTriangle& t = triangles[ids[i]];
+        int x0, x1, y0, y1;
+        raster_row_range(t, tile, x0, x1, y0, y1);
+        if (x0 > x1 || y0 > y1) {
+            continue;
+        }
+        x0 -= (x0 - tile.x0) % width; // Runs start register-aligned within the tile
+
+        const V ea0 = Pack::set1(t.edge[0][0]), ea1 = Pack::set1(t.edge[1][0]), ea2 = Pack::set1(t.edge[2][0]);
+        const V bias0 = Pack::set1(t.edge_bias[0]), bias1 = Pack::set1(t.edge_bias[1]), bias2 = Pack::set1(t.edge_bias[2]);
+        const V za = Pack::set1(t.depth[0]), wa = Pack::set1(t.inv_w[0]);
+        const V ra = Pack::set1(t.color[0][0]), ga = Pack::set1(t.color[1][0]), ba = Pack::set1(t.color[2][0]);
+        const V one = Pack::set1(1.0f);
+
+        for (int y = y0; y <= y1; ++y) {
+            const float py = static_cast<float>(y) + 0.5f - t.origin_y;
+            auto row = [&](const float* plane) { return Pack::set1(plane[1] * py + plane[2]); };
+            const V e0_row = row(t.edge[0]), e1_row = row(t.edge[1]), e2_row = row(t.edge[2]);
+            const V z_row = row(t.depth), w_row = row(t.inv_w);
+            const V r_row = row(t.color[0]), g_row = row(t.color[1]), b_row = row(t.color[2]);
+
+            float* depth = tile.depth + static_cast<size_t>(y) * tile.stride;
+            float* color = reinterpret_cast<float*>(tile.color + static_cast<size_t>(y) * tile.stride);
+            V px = Pack::add(Pack::set1(static_cast<float>(x0) - t.origin_x), lanes);
+            for (int x = x0; x <= x1; x += width, px = Pack::add(px, step)) {
+                M inside = Pack::mask_and(Pack::greater_equal(Pack::madd(ea0, px, e0_row), bias0),
+                                          Pack::greater_equal(Pack::madd(ea1, px, e1_row), bias1));
+                inside = Pack::mask_and(inside, Pack::greater_equal(Pack::madd(ea2, px, e2_row), bias2));
+                if (!Pack::any(inside)) {
+                    continue;
+                }
+                V z = Pack::madd(za, px, z_row);
+                V old_depth = Pack::load(depth + x, Pack::width);
+                M pass = Pack::mask_and(inside, Pack::greater(old_depth, z));
+                if (!Pack::any(pass)) {
+                    continue;
+                }
+                Pack::store(depth + x, Pack::select(pass, z, old_depth), Pack::width);
+
+                V w = Pack::div(one, Pack::madd(wa, px, w_row));
+                V rgba = Pack::pack_rgba8(Pack::mul(Pack::madd(ra, px, r_row), w), Pack::mul(Pack::madd(ga, px, g_row), w),
+                                          Pack::mul(Pack::madd(ba, px, b_row), w));
+                Pack::store(color + x, Pack::select(pass, rgba, Pack::load(color + x, Pack::width)), Pack::width);
+            }
+        }
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        const RasterTriangle& t = triangles[ids[i]];
+        int x0, x1, y0, y1;
+        raster_row_range(t, tile, x0, x1, y0, y1);
+        for (int y = y0; y <= y1; ++y) {
+            const float py = static_cast<float>(y) + 0.5f - t.origin_y;
+            for (int x = x0; x <= x1; ++x) {
+                const float px = static_cast<float>(x) + 0.5f - t.origin_x;
+                auto plane = [&](const float* p) { return p[0] * px + p[1] * py + p[2]; };
+                if (plane(t.edge[0]) < t.edge_bias[0] || plane(t.edge[1]) < t.edge_bias[1] ||
+                    plane(t.edge[2]) < t.edge_bias[2]) {
+                    continue;
+                }
+                const size_t offset = static_cast<size_t>(y) * tile.stride + x;
+                float z = plane(t.depth);
+                if (!(z < tile.depth[offset])) {
+                    continue;
+                }
+                tile.depth[offset] = z;
+                float w = 1.0f / plane(t.inv_w);
+                uint32_t rgba = 0xFF000000u;
+                for (int c = 0; c < 3; ++c) {
+                    float v = plane(t.color[c]) * w * 255.0f;
+                    v = v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+                    rgba |= static_cast<uint32_t>(lrintf(v)) << (8 * c);
+                }
+                tile.color[offset] = rgba;
+            }
+        }
+    }
+#endif
+}
+
+KernelTable make_table() {
+    KernelTable table{};
+    table.level = KERNEL_LEVEL;
+    table.transform_points = transform_points;
+    table.transform_vectors = transform_vectors;
+    table.transform_normals = transform_normals;
+    table.transform_points_soa = transform_points_soa;
+    table.transform_vectors_soa = transform_vectors_soa;
+    table.transform_normals_soa = transform_normals_soa;
+    table.light_vertices = light_vertices;
+    table.face_normals = face_normals;
+    table.gather_vertex_normals = gather_vertex_normals;
+    table.normalize = normalize;
+    table.multiply_matrices = multiply_matrices;
+    table.multiply_affines = multiply_affines;
+    table.multiply_quaternions = multiply_quaternions;
+    table.nlerp_quaternions = nlerp_quaternions;
+    table.slerp_quaternions = slerp_quaternions;
+    table.sincos = sincos;
+    table.tan = tan;
+    table.atan2 = atan2;
+    table.rsqrt = rsqrt;
+    table.transform_spheres = transform_spheres;
+    table.cull_spheres = cull_spheres;
+    table.cull_aabbs = cull_aabbs;
+    table.cull_meshlets = cull_meshlets;
+    table.face_orientation = face_orientation;
+    table.hash_vertices = hash_vertices;
+    table.rasterize_triangles = rasterize_triangles;
+    return table;
+}
+
+} // namespace
+
+const KernelTable& table() {
+    static const KernelTable kernel_table = make_table();
+    return kernel_table;
+}
+
+} // namespace KERNEL_NAMESPACE
+} // namespace kernels
@@ -0,0 +1,7 @@
+// Reference path for validation: no SIMD paths, built with -fno-tree-vectorize
+#include "kernel_tables.h"
+
+#define KERNEL_NAMESPACE scalar
+#define KERNEL_LEVEL SimdLevel::Scalar
+#define KERNELS_SCALAR
+#include "kernels_impl.h"
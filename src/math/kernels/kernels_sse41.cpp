@@ -0,0 +1,6 @@
+// Built with -msse4.1 (see CMakeLists.txt)
+#include "kernel_tables.h"
+
+#define KERNEL_NAMESPACE sse41
+#define KERNEL_LEVEL SimdLevel::SSE41
+#include "kernels_impl.h"
@@ -1,4 +1,7 @@
 #include "../../include/math/matrix4.h"
+#include "../../include/math/kernels.h"
+#include "../../include/math/fast_math.h"
+#include "../../include/math/quaternion.h"
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -24,6 +27,13 @@ Matrix4::Matrix4(const float* data) {
     _rows[3] = _mm_loadu_ps(&data[12]);
 }
 
+Matrix4::Matrix4(const __m128& row0, const __m128& row1, const __m128& row2, const __m128& row3) {
+    _rows[0] = row0;
+    _rows[1] = row1;
+    _rows[2] = row2;
+    _rows[3] = row3;
+}
+
 Matrix4::Matrix4(const Matrix4& other) {
     _rows[0] = other._rows[0];
     _rows[1] = other._rows[1];
@@ -47,13 +57,8 @@ Matrix4 Matrix4::identity() {
 }
 
 Matrix4 Matrix4::zero() {
-    Matrix4 result;
     __m128 zero_vec = _mm_setzero_ps();
-    result._rows[0] = zero_vec;
-    result._rows[1] = zero_vec;
-    result._rows[2] = zero_vec;
-    result._rows[3] = zero_vec;
-    return result;
+    return Matrix4(zero_vec, zero_vec, zero_vec, zero_vec);
 }
 
 Matrix4 Matrix4::translation(const Vector3& translation) {
@@ -103,19 +108,18 @@ Matrix4 Matrix4::rotation_z(float angle) {
     return result;
 }
 
-Matrix4 Matrix4::rotation(const Vector3& axis, float angle) {
-    Vector3 normalized_axis = axis.normalized();
-    float cos_a = std::cos(angle);
-    float sin_a = std::sin(angle);
+namespace {
+
+// Rodrigues' rotation formula about a unit axis
+Matrix4 axis_rotation(const Vector3& axis, float sin_a, float cos_a) {
     float one_minus_cos = 1.0f - cos_a;
     
-    float x = normalized_axis.x();
-    float y = normalized_axis.y();
-    float z = normalized_axis.z();
+    float x = axis.x();
+    float y = axis.y();
+    float z = axis.z();
     
     Matrix4 result;
     
-    // Rodrigues' rotation formula
     result(0, 0) = cos_a + x * x * one_minus_cos;
     result(0, 1) = x * y * one_minus_cos - z * sin_a;
     result(0, 2) = x * z * one_minus_cos + y * sin_a;
@@ -131,6 +135,26 @@ Matrix4 Matrix4::rotation(const Vector3& axis, float angle) {
     return result;
 }
 
+} // namespace
+
+Matrix4 Matrix4::rotation(const Vector3& axis, float angle) {
+    return axis_rotation(axis.normalized(), std::sin(angle), std::cos(angle));
+}
+
+void Matrix4::rotation_batch(const Vector3& axis, const float* angles, Matrix4* out, size_t count) {
+    Vector3 normalized_axis = axis.normalized();
+    // Angles go through the batched sincos in chunks that stay on the stack
+    constexpr size_t chunk = 256;
+    float sin_a[chunk], cos_a[chunk];
+    for (size_t i = 0; i < count; i += chunk) {
+        size_t n = count - i < chunk ? count - i : chunk;
+        sincos_batch(angles + i, sin_a, cos_a, n);
+        for (size_t k = 0; k < n; ++k) {
+            out[i + k] = axis_rotation(normalized_axis, sin_a[k], cos_a[k]);
+        }
+    }
+}
+
 Matrix4 Matrix4::scale(const Vector3& scale) {
     Matrix4 result;
     result(0, 0) = scale.x();
@@ -201,7 +225,8 @@ Matrix4 Matrix4::look_at(const Vector3& eye, const Vector3& center, const Vector
 
 // AVX-optimized operations
 Matrix4 Matrix4::operator*(const Matrix4& other) const {
-    Matrix4 result;
+    // Rows are built in registers; no identity-initialized temporary
+    __m128 result[4];
     
     // AVX-optimized matrix multiplication
     for (int i = 0; i < 4; ++i) {
@@ -233,95 +258,101 @@ Matrix4 Matrix4::operator*(const Matrix4& other) const {
             );
         #endif
         
-        result._rows[i] = result_row;
+        result[i] = result_row;
     }
     
-    return result;
+    return Matrix4(result[0], result[1], result[2], result[3]);
 }
 
 Matrix4 Matrix4::operator+(const Matrix4& other) const {
-    Matrix4 result;
-    result._rows[0] = _mm_add_ps(_rows[0], other._rows[0]);
-    result._rows[1] = _mm_add_ps(_rows[1], other._rows[1]);
-    result._rows[2] = _mm_add_ps(_rows[2], other._rows[2]);
-    result._rows[3] = _mm_add_ps(_rows[3], other._rows[3]);
-    return result;
+    return Matrix4(_mm_add_ps(_rows[0], other._rows[0]), _mm_add_ps(_rows[1], other._rows[1]),
+                   _mm_add_ps(_rows[2], other._rows[2]), _mm_add_ps(_rows[3], other._rows[3]));
 }
 
 Matrix4 Matrix4::operator-(const Matrix4& other) const {
-    Matrix4 result;
-    result._rows[0] = _mm_sub_ps(_rows[0], other._rows[0]);
-    result._rows[1] = _mm_sub_ps(_rows[1], other._rows[1]);
-    result._rows[2] = _mm_sub_ps(_rows[2], other._rows[2]);
-    result._rows[3] = _mm_sub_ps(_rows[3], other._rows[3]);
-    return result;
+    return Matrix4(_mm_sub_ps(_rows[0], other._rows[0]), _mm_sub_ps(_rows[1], other._rows[1]),
+                   _mm_sub_ps(_rows[2], other._rows[2]), _mm_sub_ps(_rows[3], other._rows[3]));
 }
 
 Matrix4 Matrix4::operator*(float scalar) const {
-    Matrix4 result;
     __m128 scalar_vec = _mm_set1_ps(scalar);
-    result._rows[0] = _mm_mul_ps(_rows[0], scalar_vec);
-    result._rows[1] = _mm_mul_ps(_rows[1], scalar_vec);
-    result._rows[2] = _mm_mul_ps(_rows[2], scalar_vec);
-    result._rows[3] = _mm_mul_ps(_rows[3], scalar_vec);
-    return result;
+    return Matrix4(_mm_mul_ps(_rows[0], scalar_vec), _mm_mul_ps(_rows[1], scalar_vec),
+                   _mm_mul_ps(_rows[2], scalar_vec), _mm_mul_ps(_rows[3], scalar_vec));
 }
 
 Vector3 Matrix4::transform_point(const Vector3& point) const {
+    // Column-vector convention (M * p), matching translation() and look_at()
     __m128 p = _mm_set_ps(1.0f, point.z(), point.y(), point.x());
     
-    // Multiply each row with the point using AVX
-    __m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0));
-    __m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
-    __m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
-    __m128 w = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3));
-    
-    #ifdef __FMA__
-        __m128 result = _mm_mul_ps(x, _rows[0]);
-        result = _mm_fmadd_ps(y, _rows[1], result);
-        result = _mm_fmadd_ps(z, _rows[2], result);
-        result = _mm_fmadd_ps(w, _rows[3], result);
-    #else
-        __m128 result = _mm_add_ps(
-            _mm_add_ps(
-                _mm_mul_ps(x, _rows[0]),
-                _mm_mul_ps(y, _rows[1])
-            ),
-            _mm_add_ps(
-                _mm_mul_ps(z, _rows[2]),
-                _mm_mul_ps(w, _rows[3])
-            )
-        );
-    #endif
+    __m128 x = _mm_mul_ps(_rows[0], p);
+    __m128 y = _mm_mul_ps(_rows[1], p);
+    __m128 z = _mm_mul_ps(_rows[2], p);
+    __m128 w = _mm_setzero_ps();
+    
+    // After the transpose, summing the rows yields the three row dot products
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    __m128 result = _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w));
     
     return Vector3(result);
 }
 
 Vector3 Matrix4::transform_vector(const Vector3& vector) const {
+    // Same as transform_point but with w = 0
     __m128 v = _mm_set_ps(0.0f, vector.z(), vector.y(), vector.x());
     
-    // Same as transform_point but with w = 0
-    __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
-    __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
-    __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
-    
-    #ifdef __FMA__
-        __m128 result = _mm_mul_ps(x, _rows[0]);
-        result = _mm_fmadd_ps(y, _rows[1], result);
-        result = _mm_fmadd_ps(z, _rows[2], result);
-    #else
-        __m128 result = _mm_add_ps(
-            _mm_add_ps(
-                _mm_mul_ps(x, _rows[0]),
-                _mm_mul_ps(y, _rows[1])
-            ),
-            _mm_mul_ps(z, _rows[2])
-        );
-    #endif
+    __m128 x = _mm_mul_ps(_rows[0], v);
+    __m128 y = _mm_mul_ps(_rows[1], v);
+    __m128 z = _mm_mul_ps(_rows[2], v);
+    __m128 w = _mm_setzero_ps();
+    
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    __m128 result = _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w));
     
     return Vector3(result);
 }
 
+void Matrix4::transform_points(const float* in, float* out, size_t count) const {
+    kernels::active().transform_points(_data, in, out, count);
+}
+
+void Matrix4::transform_vectors(const float* in, float* out, size_t count) const {
+    kernels::active().transform_vectors(_data, in, out, count);
+}
+
+void Matrix4::transform_normals(const float* in, float* out, size_t count) const {
+    kernels::active().transform_normals(_data, in, out, count);
+}
+
+namespace {
+
+kernels::Streams stream_view(const Vector3Stream& stream) {
+    return { stream.x(), stream.y(), stream.z() };
+}
+
+kernels::MutableStreams stream_view(Vector3Stream& stream, size_t count) {
+    if (stream.size() != count) {
+        stream.resize(count);
+    }
+    return { stream.x(), stream.y(), stream.z() };
+}
+
+} // namespace
+
+void Matrix4::transform_points(const Vector3Stream& in, Vector3Stream& out) const {
+    size_t count = in.size();
+    kernels::active().transform_points_soa(_data, stream_view(in), stream_view(out, count), count);
+}
+
+void Matrix4::transform_vectors(const Vector3Stream& in, Vector3Stream& out) const {
+    size_t count = in.size();
+    kernels::active().transform_vectors_soa(_data, stream_view(in), stream_view(out, count), count);
+}
+
+void Matrix4::transform_normals(const Vector3Stream& in, Vector3Stream& out) const {
+    size_t count = in.size();
+    kernels::active().transform_normals_soa(_data, stream_view(in), stream_view(out, count), count);
+}
+
 Matrix4 Matrix4::transpose() const {
     // Use the well-tested intrinsic macro to avoid subtle shuffle mistakes
     __m128 row0 = _rows[0];
@@ -340,140 +371,214 @@ Matrix4 Matrix4::transpose() const {
     return result;
 }
 
-// Matrix inverse using Gauss-Jordan elimination
-Matrix4 Matrix4::inverse() const {
-    // Create augmented matrix [A | I]
-    alignas(16) float augmented[4][8];
-    
-    // Copy matrix to left half and identity to right half
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            augmented[i][j] = (*this)(i, j);
-            augmented[i][j + 4] = (i == j) ? 1.0f : 0.0f;
-        }
-    }
-    
-    // Gauss-Jordan elimination
-    for (int i = 0; i < 4; ++i) {
-        // Find pivot
-        int pivot_row = i;
-        float max_val = std::abs(augmented[i][i]);
-        for (int k = i + 1; k < 4; ++k) {
-            float val = std::abs(augmented[k][i]);
-            if (val > max_val) {
-                max_val = val;
-                pivot_row = k;
-            }
-        }
-        
-        // Check for singular matrix
-        if (max_val < 1e-10f) {
-            return identity();
-        }
+namespace {
+
+// Row-major 2x2 blocks packed in one register as (m00, m01, m10, m11)
+
+// A * B
+inline __m128 mat2_mul(__m128 a, __m128 b) {
+    return _mm_add_ps(
+        _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+        _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2)))
+    );
+}
+
+// adj(A) * B
+inline __m128 mat2_adj_mul(__m128 a, __m128 b) {
+    return _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+        _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)))
+    );
+}
+
+// A * adj(B)
+inline __m128 mat2_mul_adj(__m128 a, __m128 b) {
+    return _mm_sub_ps(
+        _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+        _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2)))
+    );
+}
+
+// Sum of the four lanes, broadcast to every lane
+inline __m128 horizontal_sum(__m128 v) {
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// Intermediate terms of the block-wise adjugate shared by inverse() and determinant()
+struct BlockAdjugate {
+    __m128 a, b, c, d;          // 2x2 blocks: | A B |
+                                //             | C D |
+    __m128 det_a, det_b, det_c, det_d;
+    __m128 a_b, d_c;            // adj(A) * B, adj(D) * C
+    __m128 det;                 // |M| broadcast
+    
+    explicit BlockAdjugate(const __m128* rows) {
+        a = _mm_movelh_ps(rows[0], rows[1]);
+        b = _mm_movehl_ps(rows[1], rows[0]);
+        c = _mm_movelh_ps(rows[2], rows[3]);
+        d = _mm_movehl_ps(rows[3], rows[2]);
         
-        // Swap rows if needed
-        if (pivot_row != i) {
-            for (int j = 0; j < 8; ++j) {
-                std::swap(augmented[i][j], augmented[pivot_row][j]);
-            }
-        }
+        // (|A|, |B|, |C|, |D|) in one go
+        __m128 det_sub = _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(rows[0], rows[2], _MM_SHUFFLE(2, 0, 2, 0)),
+                       _mm_shuffle_ps(rows[1], rows[3], _MM_SHUFFLE(3, 1, 3, 1))),
+            _mm_mul_ps(_mm_shuffle_ps(rows[0], rows[2], _MM_SHUFFLE(3, 1, 3, 1)),
+                       _mm_shuffle_ps(rows[1], rows[3], _MM_SHUFFLE(2, 0, 2, 0)))
+        );
+        det_a = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(0, 0, 0, 0));
+        det_b = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(1, 1, 1, 1));
+        det_c = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(2, 2, 2, 2));
+        det_d = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(3, 3, 3, 3));
         
-        // Scale pivot row
-        float pivot = augmented[i][i];
-        __m128 pivot_vec = _mm_set1_ps(1.0f / pivot);
-        __m128 left_half = _mm_loadu_ps(&augmented[i][0]);
-        __m128 right_half = _mm_loadu_ps(&augmented[i][4]);
-        _mm_storeu_ps(&augmented[i][0], _mm_mul_ps(left_half, pivot_vec));
-        _mm_storeu_ps(&augmented[i][4], _mm_mul_ps(right_half, pivot_vec));
+        d_c = mat2_adj_mul(d, c);
+        a_b = mat2_adj_mul(a, b);
         
-        // Eliminate column
-        for (int k = 0; k < 4; ++k) {
-            if (k != i) {
-                float factor = augmented[k][i];
-                __m128 factor_vec = _mm_set1_ps(factor);
-                
-                __m128 row_left = _mm_loadu_ps(&augmented[k][0]);
-                __m128 pivot_left = _mm_loadu_ps(&augmented[i][0]);
-                #ifdef __FMA__
-                    row_left = _mm_fnmadd_ps(factor_vec, pivot_left, row_left);
-                #else
-                    row_left = _mm_sub_ps(row_left, _mm_mul_ps(factor_vec, pivot_left));
-                #endif
-                _mm_storeu_ps(&augmented[k][0], row_left);
-                
-                __m128 row_right = _mm_loadu_ps(&augmented[k][4]);
-                __m128 pivot_right = _mm_loadu_ps(&augmented[i][4]);
-                #ifdef __FMA__
-                    row_right = _mm_fnmadd_ps(factor_vec, pivot_right, row_right);
-                #else
-                    row_right = _mm_sub_ps(row_right, _mm_mul_ps(factor_vec, pivot_right));
-                #endif
-                _mm_storeu_ps(&augmented[k][4], row_right);
-            }
-        }
+        // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+        __m128 trace = horizontal_sum(_mm_mul_ps(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0))));
+        det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), trace);
     }
-    
-    // Extract inverse matrix from right half
+};
+
+// Branch-free closed-form inverse; singular matrices yield identity
+inline void inverse_rows(const __m128* rows, __m128* out) {
+    BlockAdjugate m(rows);
+    
+    // inverse = 1/|M| * | X Y |, each block built as its adjugate first
+    //                   | Z W |
+    __m128 x = _mm_sub_ps(_mm_mul_ps(m.det_d, m.a), mat2_mul(m.b, m.d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(m.det_a, m.d), mat2_mul(m.c, m.a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(m.det_b, m.c), mat2_mul_adj(m.d, m.a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(m.det_c, m.b), mat2_mul_adj(m.a, m.d_c));
+    
+    // Adjugate signs folded into the reciprocal: (1, -1, -1, 1) / |M|
+    __m128 rcp_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), m.det);
+    x = _mm_mul_ps(x, rcp_det);
+    y = _mm_mul_ps(y, rcp_det);
+    z = _mm_mul_ps(z, rcp_det);
+    w = _mm_mul_ps(w, rcp_det);
+    
+    // The final adjugate swizzle and the block-to-row scatter in one shuffle each
+    __m128 r0 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3));
+    __m128 r1 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2));
+    __m128 r2 = _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3));
+    __m128 r3 = _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2));
+    
+    // Select identity where |M| is too small for 1/|M| to be meaningful
+    __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), m.det);
+    __m128 invertible = _mm_cmpgt_ps(abs_det, _mm_set1_ps(1e-30f));
+    out[0] = _mm_or_ps(_mm_and_ps(invertible, r0), _mm_andnot_ps(invertible, _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f)));
+    out[1] = _mm_or_ps(_mm_and_ps(invertible, r1), _mm_andnot_ps(invertible, _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f)));
+    out[2] = _mm_or_ps(_mm_and_ps(invertible, r2), _mm_andnot_ps(invertible, _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f)));
+    out[3] = _mm_or_ps(_mm_and_ps(invertible, r3), _mm_andnot_ps(invertible, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+// Inverse of [L t; 0 1] where L = rotation * scale: inv(L) is transpose(L)
+// with each row divided by the squared length of the matching column of L
+inline void inverse_affine_rows(const __m128* rows, __m128* out) {
+    __m128 c0 = rows[0];
+    __m128 c1 = rows[1];
+    __m128 c2 = rows[2];
+    __m128 t = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, t); // c0..c2 are now the columns of L (w = 0), t = (tx, ty, tz, 1)
+    
+    __m128 len_sq0 = horizontal_sum(_mm_mul_ps(c0, c0));
+    __m128 len_sq1 = horizontal_sum(_mm_mul_ps(c1, c1));
+    __m128 len_sq2 = horizontal_sum(_mm_mul_ps(c2, c2));
+    
+    // Guard zero scale the same way inverse() guards a zero determinant
+    const __m128 tiny = _mm_set1_ps(1e-30f);
+    __m128 r0 = _mm_and_ps(_mm_cmpgt_ps(len_sq0, tiny), _mm_div_ps(c0, len_sq0));
+    __m128 r1 = _mm_and_ps(_mm_cmpgt_ps(len_sq1, tiny), _mm_div_ps(c1, len_sq1));
+    __m128 r2 = _mm_and_ps(_mm_cmpgt_ps(len_sq2, tiny), _mm_div_ps(c2, len_sq2));
+    
+    // New translation = -inv(L) * t, gathered as the row dot products
+    __m128 d0 = _mm_mul_ps(r0, t);
+    __m128 d1 = _mm_mul_ps(r1, t);
+    __m128 d2 = _mm_mul_ps(r2, t);
+    __m128 d3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+    __m128 neg_t = _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(d0, d1), _mm_add_ps(d2, d3)));
+    
+    out[0] = _mm_insert_ps(r0, neg_t, (0 << 6) | (3 << 4));
+    out[1] = _mm_insert_ps(r1, neg_t, (1 << 6) | (3 << 4));
+    out[2] = _mm_insert_ps(r2, neg_t, (2 << 6) | (3 << 4));
+    out[3] = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+} // namespace
+
+Matrix4 Matrix4::inverse() const {
     Matrix4 result;
-    for (int i = 0; i < 4; ++i) {
-        result._rows[i] = _mm_loadu_ps(&augmented[i][4]);
-    }
-    
+    inverse_rows(_rows, result._rows);
     return result;
 }
 
-float Matrix4::determinant() const {
-    // Calculate determinant using cofactor expansion along first row
-    float det = 0.0f;
-    
-    for (int col = 0; col < 4; ++col) {
-        // Calculate 3x3 minor
-        float minor[9];
-        int minor_idx = 0;
-        
-        for (int i = 1; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                if (j != col) {
-                    minor[minor_idx++] = (*this)(i, j);
-                }
-            }
-        }
-        
-        // Calculate 3x3 determinant
-        float det3x3 = minor[0] * (minor[4] * minor[8] - minor[5] * minor[7]) -
-                       minor[1] * (minor[3] * minor[8] - minor[5] * minor[6]) +
-                       minor[2] * (minor[3] * minor[7] - minor[4] * minor[6]);
-        
-        // Add to total determinant with appropriate sign
-        float cofactor = ((col % 2) == 0 ? 1.0f : -1.0f) * det3x3;
-        det += (*this)(0, col) * cofactor;
+Matrix4 Matrix4::inverse_affine() const {
+    Matrix4 result;
+    inverse_affine_rows(_rows, result._rows);
+    return result;
+}
+
+void Matrix4::inverse_batch(const Matrix4* in, Matrix4* out, size_t count) {
+    // No branches and no cross-iteration dependencies, so consecutive
+    // inverses overlap in the pipeline
+    for (size_t i = 0; i < count; ++i) {
+        __m128 rows[4];
+        inverse_rows(in[i]._rows, rows);
+        out[i]._rows[0] = rows[0];
+        out[i]._rows[1] = rows[1];
+        out[i]._rows[2] = rows[2];
+        out[i]._rows[3] = rows[3];
+    }
+}
+
+void Matrix4::inverse_affine_batch(const Matrix4* in, Matrix4* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        __m128 rows[4];
+        inverse_affine_rows(in[i]._rows, rows);
+        out[i]._rows[0] = rows[0];
+        out[i]._rows[1] = rows[1];
+        out[i]._rows[2] = rows[2];
+        out[i]._rows[3] = rows[3];
     }
-    
-    return det;
+}
+
+void Matrix4::multiply_batch(const Matrix4& lhs, const Matrix4* rhs, Matrix4* out, size_t count) {
+    static_assert(sizeof(Matrix4) == 16 * sizeof(float), "Matrix4 arrays must be tightly packed");
+    kernels::active().multiply_matrices(lhs._data, reinterpret_cast<const float*>(rhs),
+                                        reinterpret_cast<float*>(out), count);
+}
+
+float Matrix4::determinant() const {
+    return _mm_cvtss_f32(BlockAdjugate(_rows).det);
 }
 
 bool Matrix4::is_invertible(float epsilon) const {
     return std::abs(determinant()) > epsilon;
 }
 
-bool Matrix4::decompose(Vector3& translation, Vector3& rotation, Vector3& scale) const {
+namespace {
+
+// Translation and per-axis scale of m; returns m with the scale divided out of the upper 3x3
+Matrix4 remove_scale(const Matrix4& m, Vector3& translation, Vector3& scale) {
     // Extract translation (last column)
-    translation = Vector3((*this)(0, 3), (*this)(1, 3), (*this)(2, 3));
+    translation = Vector3(m(0, 3), m(1, 3), m(2, 3));
     
     // Extract scale
-    Vector3 col0((*this)(0, 0), (*this)(1, 0), (*this)(2, 0));
-    Vector3 col1((*this)(0, 1), (*this)(1, 1), (*this)(2, 1));
-    Vector3 col2((*this)(0, 2), (*this)(1, 2), (*this)(2, 2));
+    Vector3 col0(m(0, 0), m(1, 0), m(2, 0));
+    Vector3 col1(m(0, 1), m(1, 1), m(2, 1));
+    Vector3 col2(m(0, 2), m(1, 2), m(2, 2));
     
     scale = Vector3(col0.length(), col1.length(), col2.length());
     
     // Check for negative scale (flip)
-    if (determinant() < 0) {
+    if (m.determinant() < 0) {
         scale = scale * -1.0f;
     }
     
     // Extract rotation by removing scale
-    Matrix4 rotation_matrix = *this;
+    Matrix4 rotation_matrix = m;
     if (scale.x() != 0) {
         rotation_matrix(0, 0) /= scale.x();
         rotation_matrix(1, 0) /= scale.x();
@@ -489,6 +594,13 @@ bool Matrix4::decompose(Vector3& translation, Vector3& rotation, Vector3& scale)
         rotation_matrix(1, 2) /= scale.z();
         rotation_matrix(2, 2) /= scale.z();
     }
+    return rotation_matrix;
+}
+
+} // namespace
+
+bool Matrix4::decompose(Vector3& translation, Vector3& rotation, Vector3& scale) const {
+    Matrix4 rotation_matrix = remove_scale(*this, translation, scale);
     
     // Convert rotation matrix to Euler angles (simplified)
     rotation.set_x(std::atan2(rotation_matrix(2, 1), rotation_matrix(2, 2)));
@@ -500,6 +612,11 @@ bool Matrix4::decompose(Vector3& translation, Vector3& rotation, Vector3& scale)
     return true;
 }
 
+bool Matrix4::decompose(Vector3& translation, Quaternion& rotation, Vector3& scale) const {
+    rotation = Quaternion::from_matrix(remove_scale(*this, translation, scale));
+    return true;
+}
+
 void Matrix4::print() const {
     std::cout << std::fixed << std::setprecision(3);
     for (int i = 0; i < 4; ++i) {
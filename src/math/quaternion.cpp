@@ -0,0 +1,224 @@
+#include "../../include/math/quaternion.h"
+#include "../../include/math/kernels.h"
+#include "../../include/math/fast_math.h"
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+static_assert(sizeof(Quaternion) == 4 * sizeof(float), "Quaternion arrays must be packed xyzw");
+
+Quaternion::Quaternion() {
+    _simd = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+}
+
+Quaternion::Quaternion(float x, float y, float z, float w) {
+    _simd = _mm_set_ps(w, z, y, x);
+}
+
+Quaternion::Quaternion(const __m128& simd_data) : _simd(simd_data) {}
+
+Quaternion Quaternion::from_axis_angle(const Vector3& axis, float angle) {
+    Vector3 n = axis.normalized();
+    float half = angle * 0.5f;
+    float s = std::sin(half);
+    return Quaternion(n.x() * s, n.y() * s, n.z() * s, std::cos(half));
+}
+
+void Quaternion::from_axis_angle_batch(const Vector3& axis, const float* angles, Quaternion* out, size_t count) {
+    Vector3 n = axis.normalized();
+    constexpr size_t chunk = 256;
+    float half[chunk], s[chunk], c[chunk];
+    for (size_t i = 0; i < count; i += chunk) {
+        size_t m = count - i < chunk ? count - i : chunk;
+        for (size_t k = 0; k < m; ++k) {
+            half[k] = angles[i + k] * 0.5f;
+        }
+        sincos_batch(half, s, c, m);
+        for (size_t k = 0; k < m; ++k) {
+            out[i + k] = Quaternion(n.x() * s[k], n.y() * s[k], n.z() * s[k], c[k]);
+        }
+    }
+}
+
+Quaternion Quaternion::from_matrix(const Matrix4& m) {
+    // Shepperd's method: branch on the largest diagonal term to keep the
+    // square root well away from zero
+    float trace = m(0, 0) + m(1, 1) + m(2, 2);
+    Quaternion q;
+    if (trace > 0.0f) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f; // 4w
+        q = Quaternion((m(2, 1) - m(1, 2)) / s, (m(0, 2) - m(2, 0)) / s, (m(1, 0) - m(0, 1)) / s, 0.25f * s);
+    } else if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2)) {
+        float s = std::sqrt(1.0f + m(0, 0) - m(1, 1) - m(2, 2)) * 2.0f; // 4x
+        q = Quaternion(0.25f * s, (m(0, 1) + m(1, 0)) / s, (m(0, 2) + m(2, 0)) / s, (m(2, 1) - m(1, 2)) / s);
+    } else if (m(1, 1) > m(2, 2)) {
+        float s = std::sqrt(1.0f + m(1, 1) - m(0, 0) - m(2, 2)) * 2.0f; // 4y
+        q = Quaternion((m(0, 1) + m(1, 0)) / s, 0.25f * s, (m(1, 2) + m(2, 1)) / s, (m(0, 2) - m(2, 0)) / s);
+    } else {
+        float s = std::sqrt(1.0f + m(2, 2) - m(0, 0) - m(1, 1)) * 2.0f; // 4z
+        q = Quaternion((m(0, 2) + m(2, 0)) / s, (m(1, 2) + m(2, 1)) / s, 0.25f * s, (m(1, 0) - m(0, 1)) / s);
+    }
+    return q.normalized();
+}
+
+Quaternion Quaternion::operator*(const Quaternion& other) const {
+    // a * b = a.w * b + a.x * (b.w, -b.z, b.y, -b.x)
+    //                 + a.y * (b.z, b.w, -b.x, -b.y)
+    //                 + a.z * (-b.y, b.x, b.w, -b.z)
+    const __m128 b = other._simd;
+    const __m128 b_wzyx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3));
+    const __m128 b_zwxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2));
+    const __m128 b_yxwz = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1));
+
+    const __m128 sign_x = _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f);
+    const __m128 sign_y = _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f);
+    const __m128 sign_z = _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f);
+
+    __m128 ax = _mm_shuffle_ps(_simd, _simd, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 ay = _mm_shuffle_ps(_simd, _simd, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 az = _mm_shuffle_ps(_simd, _simd, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 aw = _mm_shuffle_ps(_simd, _simd, _MM_SHUFFLE(3, 3, 3, 3));
+
+    #ifdef __FMA__
+        __m128 result = _mm_mul_ps(aw, b);
+        result = _mm_fmadd_ps(ax, _mm_xor_ps(b_wzyx, sign_x), result);
+        result = _mm_fmadd_ps(ay, _mm_xor_ps(b_zwxy, sign_y), result);
+        result = _mm_fmadd_ps(az, _mm_xor_ps(b_yxwz, sign_z), result);
+    #else
+        __m128 result = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(aw, b), _mm_mul_ps(ax, _mm_xor_ps(b_wzyx, sign_x))),
+            _mm_add_ps(_mm_mul_ps(ay, _mm_xor_ps(b_zwxy, sign_y)), _mm_mul_ps(az, _mm_xor_ps(b_yxwz, sign_z)))
+        );
+    #endif
+
+    return Quaternion(result);
+}
+
+Quaternion Quaternion::operator*(float scalar) const {
+    return Quaternion(_mm_mul_ps(_simd, _mm_set1_ps(scalar)));
+}
+
+Quaternion Quaternion::operator+(const Quaternion& other) const {
+    return Quaternion(_mm_add_ps(_simd, other._simd));
+}
+
+Quaternion Quaternion::operator-(const Quaternion& other) const {
+    return Quaternion(_mm_sub_ps(_simd, other._simd));
+}
+
+float Quaternion::dot(const Quaternion& other) const {
+    // Mask 0xF1: multiply all four elements, store the sum in the lowest element
+    return _mm_cvtss_f32(_mm_dp_ps(_simd, other._simd, 0xF1));
+}
+
+float Quaternion::length() const {
+    return _mm_cvtss_f32(_mm_sqrt_ss(_mm_dp_ps(_simd, _simd, 0xF1)));
+}
+
+Quaternion Quaternion::normalized() const {
+    float len = length();
+    if (len > 1e-8f) {
+        return *this * (1.0f / len);
+    }
+    return Quaternion::identity();
+}
+
+void Quaternion::normalize() {
+    *this = normalized();
+}
+
+Quaternion Quaternion::conjugate() const {
+    return Quaternion(_mm_xor_ps(_simd, _mm_set_ps(0.0f, -0.0f, -0.0f, -0.0f)));
+}
+
+Quaternion Quaternion::inverse() const {
+    float len_sq = dot(*this);
+    if (len_sq > 1e-16f) {
+        return conjugate() * (1.0f / len_sq);
+    }
+    return Quaternion::identity();
+}
+
+Vector3 Quaternion::rotate(const Vector3& v) const {
+    // v' = v + w * t + u x t with t = 2 (u x v); cheaper than q * v * q^-1
+    Vector3 u(x(), y(), z());
+    Vector3 t = u.cross(v) * 2.0f;
+    return v + t * w() + u.cross(t);
+}
+
+Matrix4 Quaternion::to_matrix() const {
+    float x2 = x() + x(), y2 = y() + y(), z2 = z() + z();
+    float xx = x() * x2, yy = y() * y2, zz = z() * z2;
+    float xy = x() * y2, xz = x() * z2, yz = y() * z2;
+    float wx = w() * x2, wy = w() * y2, wz = w() * z2;
+
+    const float data[16] = {
+        1.0f - (yy + zz), xy - wz,          xz + wy,          0.0f,
+        xy + wz,          1.0f - (xx + zz), yz - wx,          0.0f,
+        xz - wy,          yz + wx,          1.0f - (xx + yy), 0.0f,
+        0.0f,             0.0f,             0.0f,             1.0f
+    };
+    return Matrix4(data);
+}
+
+Quaternion Quaternion::slerp(const Quaternion& a, const Quaternion& b, float t) {
+    float cos_theta = a.dot(b);
+    Quaternion end = b;
+    if (cos_theta < 0.0f) { // Take the shorter arc
+        end = b * -1.0f;
+        cos_theta = -cos_theta;
+    }
+    if (cos_theta > 0.9995f) { // Nearly parallel: sin(theta) -> 0, fall back to nlerp
+        return (a * (1.0f - t) + end * t).normalized();
+    }
+    float theta = std::acos(cos_theta);
+    float inv_sin = 1.0f / std::sin(theta);
+    float wa = std::sin((1.0f - t) * theta) * inv_sin;
+    float wb = std::sin(t * theta) * inv_sin;
+    return (a * wa + end * wb).normalized();
+}
+
+Quaternion Quaternion::nlerp(const Quaternion& a, const Quaternion& b, float t) {
+    Quaternion end = a.dot(b) < 0.0f ? b * -1.0f : b;
+    return (a * (1.0f - t) + end * t).normalized();
+}
+
+namespace {
+
+const float* packed(const Quaternion* q) {
+    return reinterpret_cast<const float*>(q);
+}
+
+float* packed(Quaternion* q) {
+    return reinterpret_cast<float*>(q);
+}
+
+} // namespace
+
+void Quaternion::multiply_batch(const Quaternion* a, const Quaternion* b, Quaternion* out, size_t count) {
+    kernels::active().multiply_quaternions(packed(a), packed(b), packed(out), count);
+}
+
+void Quaternion::slerp_batch(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count) {
+    kernels::active().slerp_quaternions(packed(a), packed(b), t, packed(out), count);
+}
+
+void Quaternion::nlerp_batch(const Quaternion* a, const Quaternion* b, const float* t, Quaternion* out, size_t count) {
+    kernels::active().nlerp_quaternions(packed(a), packed(b), t, packed(out), count);
+}
+
+void Quaternion::to_matrix_batch(const Quaternion* in, Matrix4* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = in[i].to_matrix();
+    }
+}
+
+void Quaternion::print() const {
+    std::cout << std::fixed << std::setprecision(3)
+              << "(" << x() << ", " << y() << ", " << z() << ", " << w() << ")" << std::endl;
+}
+
+std::ostream& operator<<(std::ostream& os, const Quaternion& q) {
+    os << "(" << q.x() << ", " << q.y() << ", " << q.z() << ", " << q.w() << ")";
+    return os;
+}
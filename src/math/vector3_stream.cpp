@@ -0,0 +1,29 @@
+#include "../../include/math/vector3_stream.h"
+
+Vector3Stream::Vector3Stream(size_t count, const Vector3& value) {
+    resize(count, value);
+}
+
+void Vector3Stream::push_back(const Vector3& value) {
+    _x.push_back(value.x());
+    _y.push_back(value.y());
+    _z.push_back(value.z());
+}
+
+void Vector3Stream::resize(size_t count, const Vector3& value) {
+    _x.resize(count, value.x());
+    _y.resize(count, value.y());
+    _z.resize(count, value.z());
+}
+
+void Vector3Stream::reserve(size_t count) {
+    _x.reserve(count);
+    _y.reserve(count);
+    _z.reserve(count);
+}
+
+void Vector3Stream::clear() {
+    _x.clear();
+    _y.clear();
+    _z.clear();
+}
@@ -0,0 +1,103 @@
+#include "../include/graphics/light_clusters.h"
+#include "../include/math/kernels.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Checks that clustered vertex lighting equals lighting against the full
+// light list bit for bit on every kernel tier, which lets the renderer keep
+// cached lighting when it switches clustering on or rebuilds the clusters
+
+namespace {
+
+const float AMBIENT = 0.1f;
+
+struct Streams3 {
+    std::vector<float> x, y, z;
+
+    explicit Streams3(size_t count) : x(count), y(count), z(count) {}
+    kernels::Streams view() const { return { x.data(), y.data(), z.data() }; }
+    kernels::MutableStreams mutable_view() { return { x.data(), y.data(), z.data() }; }
+};
+
+} // namespace
+
+int main() {
+    // Ranged lights of every size around the view plus a few unlimited ones,
+    // and vertices both inside and outside the frustum. The vertex count is
+    // no multiple of any register width, so every tier ends in a partial block
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> spread(-20.0f, 20.0f), unit(0.0f, 1.0f), range(0.5f, 4.0f);
+    std::vector<Light> lights;
+    for (int i = 0; i < 3000; ++i) {
+        const Vector3 position(spread(random), spread(random) * 0.2f, spread(random));
+        lights.push_back(Light(position, Vector3(unit(random), unit(random), unit(random)), 0.5f,
+                               i % 750 == 0 ? 0.0f : range(random)));
+    }
+    const size_t count = 60001;
+    Streams3 positions(count), normals(count), colors(count);
+    for (size_t i = 0; i < count; ++i) {
+        positions.x[i] = spread(random);
+        positions.y[i] = spread(random) * 0.2f;
+        positions.z[i] = spread(random);
+        const Vector3 normal = Vector3(spread(random), spread(random), spread(random)).normalized();
+        normals.x[i] = normal.x();
+        normals.y[i] = normal.y();
+        normals.z[i] = normal.z();
+        colors.x[i] = unit(random);
+        colors.y[i] = unit(random);
+        colors.z[i] = unit(random);
+    }
+
+    // The full list as the renderer passes it without clustering
+    const size_t light_count = lights.size();
+    std::vector<float> soa(light_count * 8);
+    for (size_t i = 0; i < light_count; ++i) {
+        const Light& light = lights[i];
+        const float values[8] = { light.position.x(), light.position.y(), light.position.z(), light.color.x(),
+                                  light.color.y(), light.color.z(), light.intensity,
+                                  light.range > 0.0f ? 1.0f / (light.range * light.range) : 0.0f };
+        for (int k = 0; k < 8; ++k) {
+            soa[k * light_count + i] = values[k];
+        }
+    }
+    const float* s = soa.data();
+    const kernels::LightArray all = { s, s + light_count, s + 2 * light_count, s + 3 * light_count,
+                                      s + 4 * light_count, s + 5 * light_count, s + 6 * light_count,
+                                      s + 7 * light_count, light_count };
+
+    Camera camera;
+    camera.set_perspective(1.0f, 16.0f / 9.0f, 0.5f, 40.0f);
+    camera.set_position(Vector3(0.0f, 2.0f, 5.0f));
+    camera.look_at(Vector3());
+    LightClusters clusters;
+    clusters.build(camera, lights);
+
+    int failures = 0;
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel level : levels) {
+        if (!kernels::set_level(level)) continue;
+        Streams3 full(count), clustered(count);
+        kernels::active().light_vertices(positions.view(), normals.view(), colors.view(), count, all, AMBIENT,
+                                         full.mutable_view());
+        clusters.light_vertices(positions.view(), normals.view(), colors.view(), count, AMBIENT,
+                                clustered.mutable_view());
+        size_t differing = 0;
+        for (size_t i = 0; i < count; ++i) {
+            differing += full.x[i] != clustered.x[i] || full.y[i] != clustered.y[i] || full.z[i] != clustered.z[i];
+        }
+        if (differing) {
+            std::cerr << "FAILED: " << simd_level_name(level) << ": " << differing
+                      << " vertices lit differently with clustering" << std::endl;
+            ++failures;
+        }
+    }
+    kernels::set_level(kernels::supported_level());
+
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "light_clusters_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "../include/graphics/mesh_optimizer.h"
+#include "../include/math/kernels.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Checks that weld_remap merges near-duplicates lying either side of a hash
+// cell boundary, keeps apart vertices just beyond tolerance, and gives the
+// same remap on every kernel tier and thread count
+
+namespace {
+
+const float TOLERANCE = 1e-3f;
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+size_t weld(const Vector3Stream& positions, std::vector<int>& remap, unsigned threads = 1) {
+    const Vector3Stream attributes(positions.size());
+    WeldTolerance tolerance;
+    tolerance.position = TOLERANCE;
+    remap.assign(positions.size(), -1);
+    return weld_remap(positions, attributes, attributes, tolerance, remap.data(), threads);
+}
+
+// Pairs 0.9 tolerances apart, straddling cell boundaries along one, two and
+// three axes in both directions. Pair members are consecutive; pairs lie
+// cells apart from each other
+void boundary_pairs() {
+    const float cell = WELD_CELL_SCALE * TOLERANCE;
+    Vector3Stream positions;
+    for (int axes = 1; axes < 8; ++axes) {
+        for (float side : { -0.45f, 0.45f }) {
+            for (int k = -4; k <= 4; ++k) {
+                const int offset = 20 * axes + (side > 0.0f ? 10 : 0);
+                const float boundary = (static_cast<float>(k + offset) + 0.5f) * cell;
+                const Vector3 centre((axes & 1) ? boundary : 1.0f, (axes & 2) ? boundary : 2.0f,
+                                     (axes & 4) ? boundary : 3.0f);
+                const Vector3 step((axes & 1) ? side * TOLERANCE : 0.0f, (axes & 2) ? side * TOLERANCE : 0.0f,
+                                   (axes & 4) ? side * TOLERANCE : 0.0f);
+                positions.push_back(centre + step);
+                positions.push_back(centre - step);
+            }
+        }
+    }
+
+    std::vector<int> remap;
+    const size_t unique = weld(positions, remap);
+    bool merged = true;
+    for (size_t i = 0; i < positions.size(); i += 2) merged = merged && remap[i] == remap[i + 1];
+    check(merged, "duplicates across a cell boundary weld");
+    check(unique == positions.size() / 2, "boundary pairs weld to one vertex each");
+}
+
+// Pairs straddling cell boundaries but 1.5 tolerances apart
+void distant_pairs() {
+    const float cell = WELD_CELL_SCALE * TOLERANCE;
+    Vector3Stream positions;
+    for (int k = -4; k <= 4; ++k) {
+        const float boundary = (static_cast<float>(k) + 0.5f) * cell;
+        positions.push_back(Vector3(boundary - 0.75f * TOLERANCE, 0.0f, 0.0f));
+        positions.push_back(Vector3(boundary + 0.75f * TOLERANCE, 0.0f, 0.0f));
+    }
+
+    std::vector<int> remap;
+    check(weld(positions, remap) == positions.size(), "vertices beyond tolerance stay apart");
+}
+
+// A triangle soup of a jittered grid: every grid point appears up to six
+// times, each copy moved by less than half a tolerance per axis
+void jittered_soup() {
+    const int size = 120;
+    const float spacing = 0.01f;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> jitter(-0.45f * TOLERANCE, 0.45f * TOLERANCE);
+    auto point = [&](int x, int y) {
+        return Vector3(x * spacing + jitter(random), y * spacing + jitter(random), jitter(random));
+    };
+    Vector3Stream positions;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            const Vector3 quad[6] = { point(x, y), point(x + 1, y), point(x, y + 1),
+                                      point(x + 1, y), point(x + 1, y + 1), point(x, y + 1) };
+            for (const Vector3& p : quad) positions.push_back(p);
+        }
+    }
+    check(positions.size() >= WELD_PARALLEL_MIN, "soup is large enough to weld on threads");
+
+    std::vector<int> reference, remap;
+    const size_t expected = static_cast<size_t>((size + 1) * (size + 1));
+    kernels::set_level(SimdLevel::Scalar);
+    check(weld(positions, reference) == expected, "jittered soup welds to its grid points");
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel level : levels) {
+        if (!kernels::set_level(level)) continue;
+        for (unsigned threads : { 1u, 4u }) {
+            weld(positions, remap, threads);
+            check(remap == reference, "weld is the same on every tier and thread count");
+        }
+    }
+    kernels::set_level(kernels::supported_level());
+}
+
+} // namespace
+
+int main() {
+    boundary_pairs();
+    distant_pairs();
+    jittered_soup();
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "weld_test passed" << std::endl;
+    return 0;
+}